@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+#include "Convex.hpp"
+#include <cmath>
+#include <vector>
+
+namespace {
+  geometry::polygon2 regular(size_t n, const glm::vec2& center, float phase)
+  {
+    geometry::polygon2 polygon;
+    for (size_t i = 0; i < n; ++i) {
+      const float angle = phase + 6.2831853f * i / n;
+      polygon.push_back(center + 0.5f * glm::vec2(std::cos(angle), std::sin(angle)));
+    }
+    return polygon;
+  }
+
+  // two overlapping n-gons, the case that tests every axis
+  void BM_collide_convex(benchmark::State& state)
+  {
+    const geometry::polygon2 a = regular(state.range(0), glm::vec2(0.0f, 0.0f), 0.0f);
+    const geometry::polygon2 b = regular(state.range(0), glm::vec2(0.6f, 0.2f), 0.3f);
+    for (auto _ : state) {
+      glm::vec2 mtv;
+      int axis = -1;
+      benchmark::DoNotOptimize(geometry::collide_convex(a.data(), a.size(), b.data(), b.size(), mtv, axis));
+    }
+  }
+
+  // the same pair as every edge against every edge, which callers did
+  // before, without a penetration depth
+  void BM_collide_edges(benchmark::State& state)
+  {
+    const geometry::polygon2 a = regular(state.range(0), glm::vec2(0.0f, 0.0f), 0.0f);
+    const geometry::polygon2 b = regular(state.range(0), glm::vec2(0.6f, 0.2f), 0.3f);
+    std::vector<geometry::segment2> segments;
+    for (size_t j = 0; j < b.size(); ++j) segments.push_back({ b[j], b[(j + 1) % b.size()] });
+    for (auto _ : state) {
+      bool hit = false;
+      for (size_t i = 0; i < a.size(); ++i) {
+        glm::vec2 p = a[i];
+        geometry::segment2 s;
+        hit |= geometry::intersect_seg_seg(a[i], a[(i + 1) % a.size()], segments, p, s);
+      }
+      benchmark::DoNotOptimize(hit);
+    }
+  }
+
+  // a star with n spikes
+  void BM_decompose_convex(benchmark::State& state)
+  {
+    geometry::polygon2 star;
+    for (int i = 0; i < 2 * state.range(0); ++i) {
+      const float angle = 3.14159265f * i / state.range(0), radius = (i % 2 ? 0.4f : 1.0f);
+      star.push_back(radius * glm::vec2(std::cos(angle), std::sin(angle)));
+    }
+    std::vector<geometry::polygon2> pieces;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(geometry::decompose_convex(star, pieces));
+    }
+    state.SetItemsProcessed(state.iterations() * star.size());
+  }
+}
+
+BENCHMARK(BM_collide_convex)->Arg(4)->Arg(8)->Arg(64);
+BENCHMARK(BM_collide_edges)->Arg(4)->Arg(8)->Arg(64);
+BENCHMARK(BM_decompose_convex)->Arg(8)->Arg(64);
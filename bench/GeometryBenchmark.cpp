@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+#include "Geometry.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+  enum Distribution { RANDOM, NEAR_COLLINEAR, AXIS_ALIGNED };
+
+  const size_t NB_QUERIES = 64;
+
+  float snap(float x)
+  {
+    return std::round(8.0f * x) / 8.0f;
+  }
+
+  // n short segments in [-1, 1]^2: scattered at random, lying within a few
+  // ulps of the diagonal the queries follow, or on a coarse grid of
+  // horizontal and vertical walls the axis-aligned queries run along
+  std::vector<geometry::segment2> make_segments(size_t n, Distribution distribution)
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+    std::vector<geometry::segment2> segments;
+    segments.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      glm::vec2 a(coord(rng), coord(rng));
+      glm::vec2 b = a + glm::vec2(offset(rng), offset(rng));
+      if (distribution == NEAR_COLLINEAR) {
+        a = glm::vec2(a.x, std::nextafter(a.x, (i % 2 ? 1.0f : -1.0f)));
+        b = a + glm::vec2(0.01f, 0.01f);
+      } else if (distribution == AXIS_ALIGNED) {
+        a = glm::vec2(snap(a.x), snap(a.y));
+        b = (i % 2 ? glm::vec2(a.x + 0.25f, a.y) : glm::vec2(a.x, a.y + 0.25f));
+      }
+      segments.push_back({ a, b });
+    }
+    return segments;
+  }
+
+  // query segments across the box, and rays from their first end
+  std::vector<geometry::segment2> make_queries(Distribution distribution)
+  {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::vector<geometry::segment2> queries;
+    for (size_t i = 0; i < NB_QUERIES; ++i) {
+      if (distribution == RANDOM) {
+        queries.push_back({ glm::vec2(coord(rng), coord(rng)), glm::vec2(coord(rng), coord(rng)) });
+      } else if (distribution == NEAR_COLLINEAR) {
+        const float t = coord(rng);
+        queries.push_back({ glm::vec2(-1.0f, -1.0f), glm::vec2(t, t) });
+      } else {
+        const float y = snap(coord(rng));
+        queries.push_back(i % 2 ? geometry::segment2(glm::vec2(-1.0f, y), glm::vec2(1.0f, y))
+                                : geometry::segment2(glm::vec2(y, -1.0f), glm::vec2(y, 1.0f)));
+      }
+    }
+    return queries;
+  }
+
+  void BM_intersect_ray_seg(benchmark::State& state)
+  {
+    const auto segments = make_segments(state.range(1), (Distribution)state.range(0));
+    const auto queries = make_queries((Distribution)state.range(0));
+    for (auto _ : state) {
+      for (const auto& q : queries) {
+        glm::vec2 p;
+        geometry::segment2 s;
+        benchmark::DoNotOptimize(geometry::intersect_ray_seg(q.first, q.second - q.first, segments, p, s));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size() * segments.size());
+  }
+
+  void BM_intersect_seg_seg(benchmark::State& state)
+  {
+    const auto segments = make_segments(state.range(1), (Distribution)state.range(0));
+    const auto queries = make_queries((Distribution)state.range(0));
+    for (auto _ : state) {
+      for (const auto& q : queries) {
+        glm::vec2 p = q.first;
+        geometry::segment2 s;
+        benchmark::DoNotOptimize(geometry::intersect_seg_seg(q.first, q.second, segments, p, s));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size() * segments.size());
+  }
+
+  // n points around the origin: at random, on a few rays so that many
+  // angles tie, or on a grid
+  void BM_sort_by_angle(benchmark::State& state)
+  {
+    const Distribution distribution = (Distribution)state.range(0);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::vector<glm::vec2> points(state.range(1));
+    for (size_t i = 0; i < points.size(); ++i) {
+      if (distribution == RANDOM) {
+        points[i] = glm::vec2(coord(rng), coord(rng));
+      } else if (distribution == NEAR_COLLINEAR) {
+        const float angle = (float)(i % 16) * 0.392699f;
+        points[i] = std::fabs(coord(rng)) * glm::vec2(std::cos(angle), std::sin(angle));
+      } else {
+        points[i] = glm::vec2(snap(coord(rng)), snap(coord(rng)));
+      }
+    }
+
+    std::vector<glm::vec2> sorted;
+    for (auto _ : state) {
+      sorted = points;
+      geometry::sort_by_angle(glm::vec2(0.0f, 0.0f), sorted);
+      benchmark::DoNotOptimize(sorted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+  }
+}
+
+BENCHMARK(BM_intersect_ray_seg)->ArgsProduct({ { RANDOM, NEAR_COLLINEAR, AXIS_ALIGNED }, { 64, 4096 } });
+BENCHMARK(BM_intersect_seg_seg)->ArgsProduct({ { RANDOM, NEAR_COLLINEAR, AXIS_ALIGNED }, { 64, 4096 } });
+BENCHMARK(BM_sort_by_angle)->ArgsProduct({ { RANDOM, NEAR_COLLINEAR, AXIS_ALIGNED }, { 64, 4096 } });
@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+#include "ParticleSystem.hpp"
+#include "Scenes.hpp"
+#include <deque>
+#include <vector>
+
+namespace {
+  const int UNORDERED = -1;
+
+  void BM_step_cloth(benchmark::State& state)
+  {
+    const int n = state.range(1);
+    ParticleSystem ps({ -1.0f, -0.1f * n }, { 0.1f * n + 1.0f, 0.1f * n });
+    ps.set_sleep_threshold(0.0f, 1);
+    scenes::make_shuffled_cloth(ps, n);
+    if (state.range(0) != UNORDERED) ps.reorder((ParticleSystem::Ordering)state.range(0));
+    ps.step();
+    for (auto _ : state) {
+      ps.step();
+    }
+    state.SetItemsProcessed(state.iterations() * ps.constraints().size());
+  }
+
+  // one step of an n x n cloth stretched by 1% and let go, iterated until
+  // the residual reaches 1e-3: the time per step is the time to converge
+  void BM_converge_cloth(benchmark::State& state)
+  {
+    const int n = state.range(1);
+    ParticleSystem cloth({ -1.0f, -1.0f }, { 0.11f * n + 1.0f, 0.1f * n + 1.0f });
+    cloth.set_gravity({ 0, 0 });
+    cloth.set_sleep_threshold(0.0f, 1);
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) cloth.add_particle({ 0.101f * x, 0.1f * y }, x == 0 ? 0.0f : 1.0f);
+    }
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        if (x + 1 < n) cloth.add_constraint(Constraint(y * n + x, y * n + x + 1, 0.1f));
+        if (y + 1 < n) cloth.add_constraint(Constraint(y * n + x, (y + 1) * n + x, 0.1f));
+      }
+    }
+    if (state.range(0) == 0) cloth.set_solver(ParticleSystem::GAUSS_SEIDEL);
+    if (state.range(0) == 1) cloth.set_solver(ParticleSystem::JACOBI);
+    if (state.range(0) == 2) cloth.set_solver(ParticleSystem::JACOBI, 0.99f);
+    cloth.set_solver_iterations(1, 20000, 1e-3f);
+
+    SolverMetrics metrics = SolverMetrics();
+    for (auto _ : state) {
+      state.PauseTiming();
+      ParticleSystem ps = cloth;
+      state.ResumeTiming();
+      ps.step();
+      metrics = ps.metrics();
+    }
+    state.counters["iterations"] = metrics.iterations;
+    state.counters["residual"] = metrics.max_residual;
+  }
+
+  // one frame of the emitter of main, 64 particles in and 64 out, next to a
+  // sleeping n x n cloth: the frame should cost the same whatever n is
+  void BM_emit_next_to_cloth(benchmark::State& state)
+  {
+    const int n = state.range(0);
+    ParticleSystem ps({ -1.0f, -0.1f * n }, { 0.1f * n + 1.0f, 0.1f * n });
+    scenes::make_shuffled_cloth(ps, n);
+    ps.set_sleep_threshold(1e9f, 1);
+    ps.step();
+    ps.step();
+    ps.set_sleep_threshold(1e-6f, 60);
+
+    const size_t EMIT_RATE = 64;
+    const size_t EMIT_FRAMES = 240;
+    std::deque<std::vector<ParticleHandle>> emitted;
+    const std::vector<glm::vec2> spawns(EMIT_RATE, glm::vec2(0.0f, 0.0f));
+    ps.reserve(ps.nb_particles() + EMIT_RATE * (EMIT_FRAMES + 1));
+    for (auto _ : state) {
+      emitted.push_back(std::vector<ParticleHandle>());
+      ps.add_particles(spawns, 1.0f, emitted.back());
+      if (emitted.size() > EMIT_FRAMES) {
+        ps.remove_particles(emitted.front());
+        emitted.pop_front();
+      }
+      ps.step();
+    }
+    state.counters["active"] = ps.nb_active_particles();
+  }
+}
+
+BENCHMARK(BM_step_cloth)
+  ->ArgsProduct({ { UNORDERED, ParticleSystem::MORTON, ParticleSystem::HILBERT, ParticleSystem::CUTHILL_MCKEE }, { 64, 1024 } })
+  ->Unit(benchmark::kMillisecond);
+
+// 0: Gauss-Seidel, 1: Jacobi, 2: Jacobi with Chebyshev acceleration
+BENCHMARK(BM_converge_cloth)
+  ->ArgsProduct({ { 0, 1, 2 }, { 32, 64 } })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_emit_next_to_cloth)->Arg(64)->Arg(512)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include "ParticleSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+  // n free particles spread over the box, as a large emitter scene
+  void make_particles(ParticleSystem& ps, int n)
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> x(-1.33f, 1.33f), y(-1.0f, 1.0f);
+    std::vector<glm::vec2> positions(n);
+    for (auto& p : positions) p = glm::vec2(x(rng), y(rng));
+    std::vector<ParticleHandle> handles;
+    ps.add_particles(positions, 1.0f, handles);
+  }
+
+  // the mouse moves over particles that stay put
+  void BM_pick(benchmark::State& state)
+  {
+    ParticleSystem ps({ -1.33f, -1.0f }, { 1.33f, 1.0f });
+    make_particles(ps, state.range(0));
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> x(-1.33f, 1.33f), y(-1.0f, 1.0f);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(ps.pick({ x(rng), y(rng) }, 0.05f));
+    }
+  }
+
+  // a click right after a step, in a crowd drifting at range(1) mm/s in
+  // random directions
+  void BM_pick_after_step(benchmark::State& state)
+  {
+    ParticleSystem ps({ -1.33f, -1.0f }, { 1.33f, 1.0f });
+    make_particles(ps, state.range(0));
+    ps.set_gravity({ 0, 0 });
+    ps.set_sleep_threshold(-1.0f, 1);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    const float dt = ps.timestep();
+    const float speed = 1e-3f * state.range(1);
+    for (size_t i = 0; i < ps.nb_particles(); ++i) {
+      const float a = angle(rng);
+      ps.add_force((int)i, speed / dt * glm::vec2(std::cos(a), std::sin(a)));
+    }
+    std::uniform_real_distribution<float> x(-1.33f, 1.33f), y(-1.0f, 1.0f);
+    double worst = 0;
+    for (auto _ : state) {
+      state.PauseTiming();
+      ps.step();
+      state.ResumeTiming();
+      const auto start = std::chrono::steady_clock::now();
+      benchmark::DoNotOptimize(ps.pick({ x(rng), y(rng) }, 0.05f));
+      worst = std::max(worst, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    // the latency a click sees, not the mean
+    state.counters["worst_us"] = worst;
+  }
+}
+
+BENCHMARK(BM_pick)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_pick_after_step)
+  ->ArgsProduct({ { 1 << 16, 1 << 20 }, { 0, 100, 1000, 10000 } })
+  ->Iterations(200)
+  ->Unit(benchmark::kMicrosecond);
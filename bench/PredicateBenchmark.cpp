@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+#include "Geometry.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+  enum Distribution { RANDOM, NEAR_COLLINEAR, AXIS_ALIGNED };
+
+  // n point triples, uniform in [-1, 1]^2, within a few ulps of a line, or
+  // on a coarse grid where many are exactly collinear
+  std::vector<glm::vec2> make_triples(size_t n, Distribution distribution)
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::vector<glm::vec2> points;
+    points.reserve(3 * n);
+    for (size_t i = 0; i < n; ++i) {
+      glm::vec2 a(coord(rng), coord(rng));
+      glm::vec2 b(coord(rng), coord(rng));
+      glm::vec2 c(coord(rng), coord(rng));
+      if (distribution == NEAR_COLLINEAR) {
+        const float t = coord(rng);
+        c = a + t * (b - a);
+        c.x = std::nextafter(c.x, (i % 2 ? 1.0f : -1.0f));
+      } else if (distribution == AXIS_ALIGNED) {
+        // a horizontal ab, with c on it every other time
+        a = glm::vec2(std::round(4.0f * a.x), std::round(4.0f * a.y)) / 4.0f;
+        b = glm::vec2(std::round(4.0f * b.x) / 4.0f, a.y);
+        c = glm::vec2(std::round(4.0f * c.x), (i % 2 ? 4.0f * a.y : std::round(4.0f * c.y))) / 4.0f;
+      }
+      points.push_back(a);
+      points.push_back(b);
+      points.push_back(c);
+    }
+    return points;
+  }
+
+  void BM_orient2D(benchmark::State& state)
+  {
+    const auto points = make_triples(4096, (Distribution)state.range(0));
+    for (auto _ : state) {
+      for (size_t i = 0; i < points.size(); i += 3) {
+        benchmark::DoNotOptimize(geometry::orient2D(points[i], points[i + 1], points[i + 2]));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * (points.size() / 3));
+  }
+
+  void BM_orient2D_sign(benchmark::State& state)
+  {
+    const auto points = make_triples(4096, (Distribution)state.range(0));
+    for (auto _ : state) {
+      for (size_t i = 0; i < points.size(); i += 3) {
+        benchmark::DoNotOptimize(geometry::orient2D_sign(points[i], points[i + 1], points[i + 2]));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * (points.size() / 3));
+  }
+
+  // a query segment against walls that are nearly collinear with it
+  void BM_intersect_seg_seg_walls(benchmark::State& state)
+  {
+    const auto points = make_triples(state.range(0), NEAR_COLLINEAR);
+    std::vector<geometry::segment2> walls;
+    for (size_t i = 0; i < points.size(); i += 3) {
+      walls.push_back({ points[i + 2], points[i + 2] + glm::vec2(0.001f, 0.0f) });
+    }
+    const glm::vec2 a(-1.0f, -1.0f), b(1.0f, 1.0f);
+    for (auto _ : state) {
+      glm::vec2 p = a;
+      geometry::segment2 s;
+      benchmark::DoNotOptimize(geometry::intersect_seg_seg(a, b, walls, p, s));
+    }
+    state.SetItemsProcessed(state.iterations() * walls.size());
+  }
+}
+
+BENCHMARK(BM_orient2D)->Arg(RANDOM)->Arg(NEAR_COLLINEAR)->Arg(AXIS_ALIGNED);
+BENCHMARK(BM_orient2D_sign)->Arg(RANDOM)->Arg(NEAR_COLLINEAR)->Arg(AXIS_ALIGNED);
+BENCHMARK(BM_intersect_seg_seg_walls)->Range(64, 16384);
@@ -0,0 +1,29 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+  // Work that no code of the project changes, as a unit for the timings of
+  // the regression gate: sorting and square roots, the branches and the
+  // floating point the geometry kernels are made of, over a few kB
+  void BM_reference(benchmark::State& state)
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(-1.0, 1.0);
+    std::vector<double> values(4096);
+    for (auto& v : values) v = coord(rng);
+    std::vector<double> sorted(values.size());
+    for (auto _ : state) {
+      std::copy(values.begin(), values.end(), sorted.begin());
+      std::sort(sorted.begin(), sorted.end());
+      double sum = 0;
+      for (const double v : sorted) sum += std::sqrt(std::abs(v));
+      benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+  }
+}
+
+BENCHMARK(BM_reference);
@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+#include "EglContext.hpp"
+#include "Shape.hpp"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+  // shapes need a GL context for their buffers, made once for all runs
+  bool has_context()
+  {
+    static std::unique_ptr<EglContext> gl(new EglContext());
+    return gl->has_context();
+  }
+
+  // the outline of an n-gon rebuilt after each move, as collisions see it
+  void BM_get_segments(benchmark::State& state)
+  {
+    if (!has_context()) {
+      state.SkipWithError("no GL 3.3 context through EGL");
+      return;
+    }
+
+    std::vector<glm::vec2> vertices(state.range(0));
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      const float angle = 6.2831853f * i / vertices.size();
+      vertices[i] = glm::vec2(std::cos(angle), std::sin(angle));
+    }
+    Shape shape(GL_LINE_LOOP, vertices);
+    for (auto _ : state) {
+      shape.rotate(0.001f);
+      benchmark::DoNotOptimize(shape.get_segments().data());
+    }
+    state.SetItemsProcessed(state.iterations() * vertices.size());
+  }
+
+  // n concave obstacles drifting in [-1, 1]^2, every pair tested each
+  // frame, with or without the separating axis cache
+  void BM_collide_shapes(benchmark::State& state)
+  {
+    if (!has_context()) {
+      state.SkipWithError("no GL 3.3 context through EGL");
+      return;
+    }
+
+    const std::vector<glm::vec2> l_shape = {
+      { 0.0f, 0.0f }, { 0.1f, 0.0f }, { 0.1f, 0.05f }, { 0.05f, 0.05f }, { 0.05f, 0.1f }, { 0.0f, 0.1f }
+    };
+    std::vector<std::unique_ptr<Shape>> shapes;
+    for (int i = 0; i < state.range(0); ++i) {
+      shapes.emplace_back(new Shape(GL_LINE_LOOP, l_shape));
+      shapes.back()->set_position(std::cos(7.0f * i), std::sin(11.0f * i));
+    }
+    geometry::SatCache cache;
+    geometry::SatCache* use_cache = (state.range(1) ? &cache : nullptr);
+
+    for (auto _ : state) {
+      int hits = 0;
+      for (size_t i = 0; i < shapes.size(); ++i) {
+        shapes[i]->translate(0.001f * std::cos((float)i), 0.001f * std::sin((float)i));
+        shapes[i]->rotate(0.01f);
+      }
+      for (size_t i = 0; i < shapes.size(); ++i) {
+        for (size_t j = i + 1; j < shapes.size(); ++j) {
+          glm::vec2 mtv;
+          hits += shapes[i]->collide_shape(*shapes[j], mtv, use_cache);
+        }
+      }
+      benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * shapes.size() * (shapes.size() - 1) / 2);
+  }
+}
+
+BENCHMARK(BM_get_segments)->Range(4, 4096);
+BENCHMARK(BM_collide_shapes)->ArgsProduct({ { 64, 256 }, { 0, 1 } });
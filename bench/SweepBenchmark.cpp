@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+#include "Sweep.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+  // n short segments scattered over a square, about 0.1 crossings per segment
+  std::vector<geometry::segment2> make_segments(size_t n)
+  {
+    std::mt19937 rng(42);
+    const float side = std::sqrt((float)n);
+    std::uniform_real_distribution<float> coord(0.0f, side);
+    std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+    std::vector<geometry::segment2> segments;
+    segments.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      const glm::vec2 a(coord(rng), coord(rng));
+      segments.push_back({ a, a + glm::vec2(offset(rng), offset(rng)) });
+    }
+    return segments;
+  }
+
+  void BM_intersect_all_brute_force(benchmark::State& state)
+  {
+    const auto segments = make_segments(state.range(0));
+    for (auto _ : state) {
+      size_t k = 0;
+      glm::vec2 p;
+      for (size_t i = 0; i < segments.size(); ++i) {
+        for (size_t j = i + 1; j < segments.size(); ++j) {
+          k += geometry::intersect_seg_seg(segments[i].first, segments[i].second,
+                                           segments[j].first, segments[j].second, p);
+        }
+      }
+      benchmark::DoNotOptimize(k);
+    }
+    state.SetItemsProcessed(state.iterations() * segments.size());
+  }
+
+  void BM_intersect_all_sweep(benchmark::State& state)
+  {
+    const auto segments = make_segments(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(geometry::intersect_all(segments));
+    }
+    state.SetItemsProcessed(state.iterations() * segments.size());
+  }
+
+  void BM_intersect_all_slabs(benchmark::State& state)
+  {
+    const auto segments = make_segments(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(geometry::intersect_all(segments, ThreadPool::global()));
+    }
+    state.SetItemsProcessed(state.iterations() * segments.size());
+  }
+}
+
+BENCHMARK(BM_intersect_all_brute_force)->Range(256, 4096);
+BENCHMARK(BM_intersect_all_sweep)->Range(256, 131072);
+BENCHMARK(BM_intersect_all_slabs)->Range(256, 131072);
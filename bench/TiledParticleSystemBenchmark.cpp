@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include "Scenes.hpp"
+#include "TiledParticleSystem.hpp"
+
+namespace {
+  void BM_step_flat_cloth(benchmark::State& state)
+  {
+    const int n = state.range(0);
+    ParticleSystem ps({ -1.0f, -0.1f * n }, { 0.1f * n + 1.0f, 0.1f * n });
+    ps.set_sleep_threshold(0.0f, 1);
+    scenes::make_shuffled_cloth(ps, n);
+    ps.step();
+    for (auto _ : state) {
+      ps.step();
+    }
+    state.SetItemsProcessed(state.iterations() * ps.constraints().size());
+  }
+
+  // tiles of range(1) x range(1) cloth particles
+  void BM_step_tiled_cloth(benchmark::State& state)
+  {
+    const int n = state.range(0);
+    const float tile_size = 0.1f * state.range(1);
+    TiledParticleSystem tps({ -1.0f, -0.1f * n }, { 0.1f * n + 1.0f, 0.1f * n }, { tile_size, tile_size });
+    scenes::make_shuffled_cloth(tps, n);
+    tps.step();
+    for (auto _ : state) {
+      tps.step();
+    }
+    state.SetItemsProcessed(state.iterations() * tps.nb_constraints());
+    state.counters["tiles"] = tps.nb_tiles();
+    state.counters["ghosts"] = tps.nb_ghosts();
+  }
+}
+
+BENCHMARK(BM_step_flat_cloth)->Arg(256)->Arg(1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_step_tiled_cloth)
+  ->ArgsProduct({ { 256, 1024 }, { 16, 64, 4096 } })
+  ->Unit(benchmark::kMillisecond);
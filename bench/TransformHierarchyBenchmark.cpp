@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+#include "TransformHierarchy.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+namespace {
+  const int NB_JOINTS = 8;
+
+  // n arms of NB_JOINTS joints, every joint bending each frame
+  void BM_update_hierarchy(benchmark::State& state)
+  {
+    TransformHierarchy h;
+    std::vector<int> nodes;
+    for (int i = 0; i < state.range(0); ++i) {
+      int parent = -1;
+      for (int j = 0; j < NB_JOINTS; ++j) {
+        parent = h.add(parent);
+        h.set_position(parent, glm::vec2(j == 0 ? 0.01f * i : 0.1f, 0.0f));
+        nodes.push_back(parent);
+      }
+    }
+    h.update();
+
+    float angle = 0;
+    for (auto _ : state) {
+      angle += 0.001f;
+      for (const int node : nodes) h.set_rotation(node, angle);
+      h.update();
+      benchmark::DoNotOptimize(h.world(nodes.back()).tx);
+    }
+    state.SetItemsProcessed(state.iterations() * nodes.size());
+  }
+
+  // the same arms as one mat4 per joint composed the way shapes did
+  void BM_update_mat4(benchmark::State& state)
+  {
+    struct Joint
+    {
+      int parent;
+      glm::vec2 position;
+      float rotation;
+      glm::mat4 world;
+    };
+    std::vector<Joint> joints;
+    for (int i = 0; i < state.range(0); ++i) {
+      for (int j = 0; j < NB_JOINTS; ++j) {
+        joints.push_back({ j == 0 ? -1 : (int)joints.size() - 1,
+                           glm::vec2(j == 0 ? 0.01f * i : 0.1f, 0.0f), 0.0f, glm::mat4() });
+      }
+    }
+
+    float angle = 0;
+    for (auto _ : state) {
+      angle += 0.001f;
+      for (auto& joint : joints) {
+        joint.rotation = angle;
+        glm::mat4 local;
+        local = glm::translate(local, glm::vec3(joint.position.x, joint.position.y, 0.0f));
+        local = glm::rotate(local, joint.rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+        local = glm::scale(local, glm::vec3(1.0f, 1.0f, 1.0f));
+        joint.world = (joint.parent < 0 ? local : joints[joint.parent].world * local);
+      }
+      benchmark::DoNotOptimize(joints.back().world[3][0]);
+    }
+    state.SetItemsProcessed(state.iterations() * joints.size());
+  }
+}
+
+BENCHMARK(BM_update_hierarchy)->Arg(128)->Arg(4096);
+BENCHMARK(BM_update_mat4)->Arg(128)->Arg(4096);
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+#include "WorldBatch.hpp"
+#include <vector>
+
+namespace {
+  // the scene of assets/particles.txt: two linked squares, 8 particles and 13 constraints
+  ParticleSystem make_squares(float gravity)
+  {
+    ParticleSystem ps({ -1.0f, -1.0f }, { 1.0f, 1.0f });
+    ps.set_sleep_threshold(-1.0f, 1);
+    ps.set_gravity({ 0.0f, gravity });
+    for (const auto& p : { glm::vec2(0.5f, 0.5f), glm::vec2(0.4f, 0.5f), glm::vec2(0.4f, 0.4f), glm::vec2(0.5f, 0.4f),
+                           glm::vec2(0.3f, 0.5f), glm::vec2(0.2f, 0.5f), glm::vec2(0.2f, 0.4f), glm::vec2(0.3f, 0.4f) }) {
+      ps.add_particle(p);
+    }
+    for (int k = 0; k < 8; k += 4) {
+      ps.add_constraint(Constraint(k + 0, k + 1, 0.1f));
+      ps.add_constraint(Constraint(k + 1, k + 2, 0.1f));
+      ps.add_constraint(Constraint(k + 2, k + 3, 0.1f));
+      ps.add_constraint(Constraint(k + 3, k + 0, 0.1f));
+      ps.add_constraint(Constraint(k + 0, k + 2, 0.14142f));
+      ps.add_constraint(Constraint(k + 1, k + 3, 0.14142f));
+    }
+    ps.add_constraint(Constraint(0, 4, 0.2f));
+    return ps;
+  }
+
+  // one ParticleSystem per world, stepped one after the other
+  void BM_particle_systems_step(benchmark::State& state)
+  {
+    std::vector<ParticleSystem> systems;
+    for (int i = 0; i < state.range(0); ++i) systems.push_back(make_squares(-4.81f - 0.001f * i));
+    for (auto _ : state) {
+      for (auto& ps : systems) ps.step();
+    }
+    state.SetItemsProcessed(state.iterations() * systems.size());
+  }
+
+  void BM_world_batch_step(benchmark::State& state)
+  {
+    WorldBatch batch;
+    for (int i = 0; i < state.range(0); ++i) batch.add_world(make_squares(-4.81f - 0.001f * i));
+    batch.step();
+    for (auto _ : state) {
+      batch.step();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.nb_worlds());
+  }
+}
+
+// items per second are worlds x steps per second
+BENCHMARK(BM_particle_systems_step)->Range(64, 16384);
+BENCHMARK(BM_world_batch_step)->Range(64, 16384);
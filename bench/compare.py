@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Compares Google Benchmark JSON output to a baseline and fails on regressions.
+
+    compare.py baseline.json current.json [--threshold 0.25]
+    compare.py --record baseline.json current.json
+
+Each benchmark is timed on its fastest repetition in CPU time: the rest of
+the machine can only slow a run down, so the minimum is the statistic that
+moves least between runs. Timings are then divided by the one of the
+REFERENCE benchmark of the same run, a kernel that no code of the project
+changes, so that the baseline stores how many references a benchmark takes
+rather than nanoseconds of one machine.
+
+The exit status is 1 when a benchmark got slower than (1 + threshold) times
+its baseline, or when the reference is missing, 0 otherwise; benchmarks
+found on one side only are listed but do not fail. --record writes the
+baseline from current.json instead.
+"""
+
+import argparse
+import json
+import sys
+
+UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+REFERENCE = "BM_reference"
+
+
+def load(filename):
+    """name -> fastest CPU time in nanoseconds"""
+    with open(filename) as f:
+        data = json.load(f)
+    times = {}
+    for b in data["benchmarks"]:
+        if b.get("error_occurred") or b.get("run_type") == "aggregate":
+            continue
+        name = b.get("run_name", b["name"])
+        t = b["cpu_time"] * UNITS[b.get("time_unit", "ns")]
+        times[name] = min(t, times.get(name, t))
+    return times
+
+
+def ratios(times):
+    """name -> time in references, None without a reference"""
+    if REFERENCE not in times:
+        return None
+    return {name: t / times[REFERENCE] for name, t in times.items() if name != REFERENCE}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.25,
+                        help="relative slowdown that fails (default 0.25)")
+    parser.add_argument("--record", action="store_true",
+                        help="write the baseline from the current run")
+    args = parser.parse_args()
+
+    current = ratios(load(args.current))
+    if current is None:
+        print("%s is missing from %s, nothing can be compared" % (REFERENCE, args.current))
+        return 1
+    if args.record:
+        with open(args.baseline, "w") as f:
+            json.dump({"reference": REFERENCE, "ratios": current}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("recorded %d benchmark(s) in %s" % (len(current), args.baseline))
+        return 0
+    with open(args.baseline) as f:
+        baseline = json.load(f)["ratios"]
+
+    regressions = []
+    width = max([len(name) for name in current] + [9])
+    print("%-*s %12s %12s %8s" % (width, "benchmark", "baseline", "current", "change"))
+    for name in sorted(current):
+        if name not in baseline:
+            print("%-*s %12s %12.4g %8s" % (width, name, "-", current[name], "new"))
+            continue
+        change = current[name] / baseline[name] - 1.0
+        flag = ""
+        if change > args.threshold:
+            regressions.append(name)
+            flag = "  REGRESSION"
+        print("%-*s %12.4g %12.4g %+7.1f%%%s" % (width, name, baseline[name], current[name], 100 * change, flag))
+    for name in sorted(set(baseline) - set(current)):
+        print("%-*s %12.4g %12s %8s" % (width, name, baseline[name], "-", "gone"))
+
+    if regressions:
+        print("\n%d benchmark(s) more than %.0f%% slower than the baseline (in %s):"
+              % (len(regressions), 100 * args.threshold, REFERENCE))
+        for name in regressions:
+            print("  " + name)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
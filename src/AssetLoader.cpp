@@ -0,0 +1,116 @@
+#include "AssetLoader.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+AssetLoader::AssetLoader()
+  : _stop(false), _busy(false), _pending(0)
+{
+  _thread = std::thread(&AssetLoader::worker, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+    _jobs.clear();
+  }
+  _wake.notify_all();
+  _thread.join();
+}
+
+std::string AssetLoader::read_text(const std::string& filename)
+{
+  std::ifstream ifs(filename);
+  if (!ifs) {
+    throw std::runtime_error("AssetLoader::read_text(): unable to open " + filename);
+  }
+  std::ostringstream oss;
+  oss << ifs.rdbuf();
+  return oss.str();
+}
+
+void AssetLoader::load_text(const std::string& filename, std::function<void(std::string&)> done)
+{
+  load([filename] () { return read_text(filename); }, done);
+}
+
+size_t AssetLoader::poll()
+{
+  std::deque<std::function<void()>> completions;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    completions.swap(_completions);
+  }
+
+  size_t n = 0;
+  while (!completions.empty()) {
+    std::function<void()> completion = std::move(completions.front());
+    completions.pop_front();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_pending;
+    }
+    ++n;
+    try {
+      completion();
+    } catch (...) {
+      // the ones after a failure still run on the next poll()
+      std::lock_guard<std::mutex> lock(_mutex);
+      _completions.insert(_completions.begin(), completions.begin(), completions.end());
+      throw;
+    }
+  }
+  return n;
+}
+
+void AssetLoader::wait()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this] { return _jobs.empty() && !_busy; });
+}
+
+size_t AssetLoader::nb_pending() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending;
+}
+
+void AssetLoader::submit(std::function<std::function<void()>()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push_back(std::move(job));
+    ++_pending;
+  }
+  _wake.notify_one();
+}
+
+void AssetLoader::worker()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    _wake.wait(lock, [this] { return _stop || !_jobs.empty(); });
+    if (_stop) return;
+
+    std::function<std::function<void()>()> job = std::move(_jobs.front());
+    _jobs.pop_front();
+    _busy = true;
+    lock.unlock();
+
+    std::function<void()> completion;
+    try {
+      completion = job();
+    } catch (...) {
+      const std::exception_ptr error = std::current_exception();
+      completion = [error] { std::rethrow_exception(error); };
+    }
+
+    lock.lock();
+    _completions.push_back(std::move(completion));
+    _busy = false;
+    if (_jobs.empty()) _idle.notify_all();
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs loading jobs (file reads, scene parsing) on a worker thread, one at a
+// time and in order, and hands their results back on the thread that calls
+// poll(), where the GL-side work belongs. A job that throws rethrows from
+// poll() in place of its completion.
+class AssetLoader
+{
+public:
+  AssetLoader();
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+  // drops the queued jobs, finishes the running one
+  ~AssetLoader();
+
+  // runs work() on the worker, then done(result) on the next poll() after it
+  template <typename Work, typename Done>
+  void load(Work work, Done done);
+
+  // the contents of a file, for jobs to use
+  static std::string read_text(const std::string& filename);
+  // the contents of a file, read on the worker
+  void load_text(const std::string& filename, std::function<void(std::string&)> done);
+
+  // runs the completions of the jobs finished so far, and returns how many
+  size_t poll();
+  // blocks until every job submitted so far is finished, without polling
+  void wait();
+  // jobs submitted and not completed by poll() yet
+  size_t nb_pending() const;
+
+private:
+  // a job returns its completion
+  void submit(std::function<std::function<void()>()> job);
+  void worker();
+
+private:
+  std::thread _thread;
+  mutable std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _idle;
+  bool _stop;
+  bool _busy;
+  std::deque<std::function<std::function<void()>()>> _jobs;
+  std::deque<std::function<void()>> _completions;
+  size_t _pending;
+};
+
+template <typename Work, typename Done>
+void AssetLoader::load(Work work, Done done)
+{
+  typedef decltype(work()) T;
+  submit([work, done] () -> std::function<void()> {
+    std::shared_ptr<T> result = std::make_shared<T>(work());
+    return [result, done] () { done(*result); };
+  });
+}
@@ -0,0 +1,299 @@
+#include "Convex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CONVEX_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+  using namespace geometry;
+
+  // without repeated vertices and counterclockwise, false if it has no area
+  bool normalize(const polygon2& polygon, polygon2& result)
+  {
+    result.clear();
+    for (const auto& p : polygon) {
+      if (result.empty() || p != result.back()) result.push_back(p);
+    }
+    while (result.size() > 1 && result.back() == result.front()) result.pop_back();
+    if (result.size() < 3) return false;
+
+    double area = 0;
+    for (size_t i = 0, j = result.size() - 1; i < result.size(); j = i++) {
+      area += (double)result[j].x * result[i].y - (double)result[i].x * result[j].y;
+    }
+    if (area == 0) return false;
+    if (area < 0) std::reverse(result.begin(), result.end());
+    return true;
+  }
+
+  // no two edges meet but at their shared vertex
+  bool is_simple(const polygon2& polygon)
+  {
+    const size_t n = polygon.size();
+    glm::vec2 p;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = i + 2; j < n; ++j) {
+        if (i == 0 && j == n - 1) continue;
+        if (intersect_seg_seg(polygon[i], polygon[(i + 1) % n], polygon[j], polygon[(j + 1) % n], p)) return false;
+      }
+    }
+    return true;
+  }
+
+  bool in_triangle(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, const glm::vec2& p)
+  {
+    return orient2D_sign(a, b, p) >= 0 && orient2D_sign(b, c, p) >= 0 && orient2D_sign(c, a, p) >= 0;
+  }
+
+  // triangles of a simple counterclockwise polygon, as vertex indices
+  bool ear_clip(const polygon2& polygon, std::vector<std::vector<int>>& triangles)
+  {
+    std::vector<int> remaining(polygon.size());
+    for (size_t i = 0; i < remaining.size(); ++i) remaining[i] = (int)i;
+
+    size_t k = 0;
+    while (remaining.size() > 3) {
+      const size_t m = remaining.size();
+      bool clipped = false;
+      for (size_t tries = 0; tries < m && !clipped; ++tries, k = (k + 1) % m) {
+        const int prev = remaining[(k + m - 1) % m], cur = remaining[k], next = remaining[(k + 1) % m];
+        const glm::vec2 &a = polygon[prev], &b = polygon[cur], &c = polygon[next];
+        const int sign = orient2D_sign(a, b, c);
+        if (sign == 0) {
+          // a vertex in the middle of a straight edge goes, a spike does not
+          if (glm::dot(b - a, c - b) <= 0) continue;
+        } else if (sign < 0) {
+          continue;
+        } else {
+          bool ear = true;
+          for (const int i : remaining) {
+            if (i == prev || i == cur || i == next || polygon[i] == a || polygon[i] == b || polygon[i] == c) continue;
+            if (in_triangle(a, b, c, polygon[i])) {
+              ear = false;
+              break;
+            }
+          }
+          if (!ear) continue;
+          triangles.push_back({ prev, cur, next });
+        }
+        remaining.erase(remaining.begin() + k);
+        clipped = true;
+      }
+      if (!clipped) return false;
+      k %= remaining.size();
+    }
+    if (orient2D_sign(polygon[remaining[0]], polygon[remaining[1]], polygon[remaining[2]]) > 0) {
+      triangles.push_back(remaining);
+    }
+    return true;
+  }
+
+  // Hertel-Mehlhorn: merges the pieces across each diagonal that keeps the
+  // union convex, until none does
+  void merge_pieces(const polygon2& polygon, std::vector<std::vector<int>>& pieces)
+  {
+    std::map<std::pair<int, int>, int> owners;
+    for (size_t p = 0; p < pieces.size(); ++p) {
+      for (size_t e = 0; e < pieces[p].size(); ++e) {
+        owners[std::make_pair(pieces[p][e], pieces[p][(e + 1) % pieces[p].size()])] = (int)p;
+      }
+    }
+
+    std::vector<int> merged;
+    // vertices of P, to keep pieces that touch elsewhere than across the
+    // edge from merging into a polygon that is not simple
+    std::vector<uint8_t> in_p(polygon.size(), 0);
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t p = 0; p < pieces.size(); ++p) {
+        for (size_t e = 0; e < pieces[p].size(); ++e) {
+          std::vector<int>& P = pieces[p];
+          const int u = P[e], v = P[(e + 1) % P.size()];
+          const auto it = owners.find(std::make_pair(v, u));
+          if (it == owners.end() || it->second == (int)p) continue;
+          const std::vector<int>& Q = pieces[it->second];
+
+          // P from v around to u, then Q strictly between u and v
+          merged.clear();
+          for (size_t i = 0; i < P.size(); ++i) merged.push_back(P[(e + 1 + i) % P.size()]);
+          for (const int i : P) in_p[i] = 1;
+          bool repeated = false;
+          const size_t start = std::find(Q.begin(), Q.end(), u) - Q.begin();
+          for (size_t i = 1; i + 1 < Q.size(); ++i) {
+            merged.push_back(Q[(start + i) % Q.size()]);
+            repeated = repeated || in_p[merged.back()];
+          }
+          for (const int i : P) in_p[i] = 0;
+          if (repeated) continue;
+
+          const size_t iu = P.size() - 1;
+          if (orient2D_sign(polygon[merged[iu - 1]], polygon[u], polygon[merged[iu + 1]]) < 0) continue;
+          if (orient2D_sign(polygon[merged.back()], polygon[v], polygon[merged[1]]) < 0) continue;
+
+          const int q = it->second;
+          owners.erase(std::make_pair(u, v));
+          owners.erase(std::make_pair(v, u));
+          for (size_t i = 0; i < merged.size(); ++i) {
+            owners[std::make_pair(merged[i], merged[(i + 1) % merged.size()])] = (int)p;
+          }
+          pieces[q].clear();
+          pieces[p] = merged;
+          changed = true;
+          break;
+        }
+      }
+    }
+    pieces.erase(std::remove_if(pieces.begin(), pieces.end(),
+                                [] (const std::vector<int>& piece) { return piece.empty(); }), pieces.end());
+  }
+
+  glm::vec2 edge_normal(const glm::vec2* polygon, size_t n, size_t i)
+  {
+    const glm::vec2 e = polygon[(i + 1) % n] - polygon[i];
+    return glm::vec2(e.y, -e.x) / std::sqrt(e.x * e.x + e.y * e.y);
+  }
+}
+
+namespace geometry {
+  bool decompose_convex(const polygon2& polygon, std::vector<polygon2>& pieces)
+  {
+    pieces.clear();
+    polygon2 ccw;
+    if (!normalize(polygon, ccw) || !is_simple(ccw)) return false;
+
+    std::vector<std::vector<int>> indices;
+    if (!ear_clip(ccw, indices)) return false;
+    merge_pieces(ccw, indices);
+
+    for (const auto& piece : indices) {
+      pieces.push_back(polygon2());
+      for (const int i : piece) pieces.back().push_back(ccw[i]);
+    }
+    return true;
+  }
+
+  void merge_convex(std::vector<polygon2>& pieces)
+  {
+    // the pieces as indices of their distinct vertices
+    polygon2 vertices;
+    std::map<std::pair<float, float>, int> index;
+    std::vector<std::vector<int>> indices(pieces.size());
+    for (size_t p = 0; p < pieces.size(); ++p) {
+      for (const auto& v : pieces[p]) {
+        const auto it = index.insert(std::make_pair(std::make_pair(v.x, v.y), (int)vertices.size())).first;
+        if (it->second == (int)vertices.size()) vertices.push_back(v);
+        indices[p].push_back(it->second);
+      }
+    }
+    merge_pieces(vertices, indices);
+
+    pieces.resize(indices.size());
+    for (size_t p = 0; p < indices.size(); ++p) {
+      pieces[p].clear();
+      for (const int i : indices[p]) pieces[p].push_back(vertices[i]);
+    }
+  }
+
+  void project(const glm::vec2* points, size_t n, const glm::vec2& axis, float& min, float& max)
+  {
+    min = std::numeric_limits<float>::infinity();
+    max = -std::numeric_limits<float>::infinity();
+    size_t i = 0;
+#ifdef CONVEX_SSE
+    static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "geometry::project(): vec2 is not packed");
+    if (n >= 4) {
+      const float* xy = &points[0].x;
+      const __m128 a = _mm_setr_ps(axis.x, axis.y, axis.x, axis.y);
+      __m128 lo = _mm_set1_ps(min), hi = _mm_set1_ps(max);
+      for (; i + 4 <= n; i += 4) {
+        const __m128 p01 = _mm_mul_ps(_mm_loadu_ps(xy + 2 * i), a);
+        const __m128 p23 = _mm_mul_ps(_mm_loadu_ps(xy + 2 * i + 4), a);
+        // x * axis.x + y * axis.y of the four points, as the scalar code does
+        const __m128 d = _mm_add_ps(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0)),
+                                    _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1)));
+        lo = _mm_min_ps(lo, d);
+        hi = _mm_max_ps(hi, d);
+      }
+      lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 0, 3, 2)));
+      lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1)));
+      hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 0, 3, 2)));
+      hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 3, 0, 1)));
+      _mm_store_ss(&min, lo);
+      _mm_store_ss(&max, hi);
+    }
+#endif
+    for (; i < n; ++i) {
+      const float d = points[i].x * axis.x + points[i].y * axis.y;
+      min = std::min(min, d);
+      max = std::max(max, d);
+    }
+  }
+
+  bool collide_convex(const glm::vec2* a, size_t na, const glm::vec2* b, size_t nb,
+                      glm::vec2& mtv, int& axis)
+  {
+    const int nb_axes = (int)(na + nb);
+    auto normal = [&] (int k) {
+      return (k < (int)na ? edge_normal(a, na, k) : edge_normal(b, nb, k - na));
+    };
+
+    float depth = std::numeric_limits<float>::infinity();
+    glm::vec2 direction;
+    // the hint first, then all of them in order
+    const int first = (axis >= 0 && axis < nb_axes ? axis : 0);
+    for (int i = 0; i < nb_axes; ++i) {
+      const int k = (i == 0 ? first : (i <= first ? i - 1 : i));
+      const glm::vec2 n = normal(k);
+      float amin, amax, bmin, bmax;
+      project(a, na, n, amin, amax);
+      project(b, nb, n, bmin, bmax);
+      const float out = amax - bmin, in = bmax - amin;
+      if (out <= 0 || in <= 0) {
+        axis = k;
+        return false;
+      }
+      if (std::min(out, in) < depth) {
+        depth = std::min(out, in);
+        direction = (out < in ? -n : n);
+      }
+    }
+    mtv = depth * direction;
+    return true;
+  }
+
+  int& SatCache::axis(const void* a, int piece_a, const void* b, int piece_b)
+  {
+    const Key key = { a, b, piece_a, piece_b };
+    return _axes.insert(std::make_pair(key, -1)).first->second;
+  }
+
+  size_t SatCache::size() const
+  {
+    return _axes.size();
+  }
+
+  void SatCache::clear()
+  {
+    _axes.clear();
+  }
+
+  bool SatCache::Key::operator==(const Key& other) const
+  {
+    return a == other.a && b == other.b && piece_a == other.piece_a && piece_b == other.piece_b;
+  }
+
+  size_t SatCache::KeyHash::operator()(const Key& key) const
+  {
+    size_t h = std::hash<const void*>()(key.a);
+    h = h * 31 + std::hash<const void*>()(key.b);
+    h = h * 31 + (size_t)key.piece_a;
+    return h * 31 + (size_t)key.piece_b;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Geometry.hpp"
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace geometry {
+  using polygon2 = std::vector<glm::vec2>;
+
+  // Splits a simple polygon, in either winding, into counterclockwise convex
+  // pieces: ear clipping into triangles, then Hertel-Mehlhorn removes every
+  // diagonal whose removal leaves a convex piece, which gives at most four
+  // times the optimal number of pieces. False if the polygon is not simple.
+  bool decompose_convex(const polygon2& polygon, std::vector<polygon2>& pieces);
+
+  // Merges counterclockwise convex pieces, such as the triangles of a mesh,
+  // with Hertel-Mehlhorn across the edges two of them share, end points
+  // equal and in opposite directions, while the union stays convex.
+  void merge_convex(std::vector<polygon2>& pieces);
+
+  // min and max of dot(points[i], axis), four points at a time with SSE
+  void project(const glm::vec2* points, size_t n, const glm::vec2& axis, float& min, float& max);
+
+  // Separating axis test between two counterclockwise convex polygons. On
+  // overlap, mtv is the smallest translation of a that separates it from b.
+  // axis is the index of the axis to try first, the edge normals of a then
+  // those of b; it becomes the separating axis found, so that the next test
+  // of a pair that stays apart usually takes a single projection.
+  bool collide_convex(const glm::vec2* a, size_t na, const glm::vec2* b, size_t nb,
+                      glm::vec2& mtv, int& axis);
+
+  // The last separating axis of each pair of convex pieces, by identity of
+  // their owners, for collide_convex() to try first.
+  class SatCache
+  {
+  public:
+    int& axis(const void* a, int piece_a, const void* b, int piece_b);
+
+    size_t size() const;
+    void clear();
+
+  private:
+    struct Key
+    {
+      const void* a;
+      const void* b;
+      int piece_a;
+      int piece_b;
+
+      bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash
+    {
+      size_t operator()(const Key& key) const;
+    };
+
+  private:
+    std::unordered_map<Key, int, KeyHash> _axes;
+  };
+}
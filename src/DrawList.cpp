@@ -0,0 +1,187 @@
+#include "DrawList.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+DrawList::DrawList(ThreadPool& pool)
+  : _pool(pool), _lod_threshold(1.0f), _width(0), _height(0), _tiles_x(0), _tiles_y(0)
+{}
+
+void DrawList::set_lod_threshold(float particles_per_pixel)
+{
+  _lod_threshold = particles_per_pixel;
+}
+
+const std::vector<glm::vec2>& DrawList::points() const
+{
+  return _points;
+}
+
+const std::vector<glm::vec2>& DrawList::lines() const
+{
+  return _lines;
+}
+
+glm::ivec2 DrawList::to_pixel(const glm::vec2& p) const
+{
+  // off the view every pixel is as good as the next one outside it; far
+  // enough, or NaN, the coordinate would not fit in an int
+  const glm::vec2 q = (p - _view_min) * _pixels_per_unit;
+  return glm::ivec2((int)std::floor(std::min((float)_width, std::max(-1.0f, q.x))),
+                    (int)std::floor(std::min((float)_height, std::max(-1.0f, q.y))));
+}
+
+glm::vec2 DrawList::to_world(int x, int y) const
+{
+  return glm::vec2(_view_min.x + (x + 0.5f) / _pixels_per_unit.x,
+                   _view_min.y + (y + 0.5f) / _pixels_per_unit.y);
+}
+
+void DrawList::build(const std::vector<glm::vec2>& particles,
+                     const std::vector<Constraint>& constraints,
+                     const glm::vec2& view_min, const glm::vec2& view_max,
+                     int width, int height)
+{
+  _view_min = view_min;
+  _view_max = view_max;
+  _width = width;
+  _height = height;
+  _pixels_per_unit = glm::vec2(width / (view_max.x - view_min.x), height / (view_max.y - view_min.y));
+  _tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  _tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+  bucket_particles(particles);
+  emit_points(particles);
+  emit_lines(particles, constraints);
+}
+
+void DrawList::bucket_particles(const std::vector<glm::vec2>& particles)
+{
+  const size_t n = particles.size();
+  const size_t nb_tiles = _tiles_x * _tiles_y;
+  const size_t nb_chunks = _pool.nb_chunks(n);
+  _tiles.resize(n);
+  _order.resize(n);
+  _chunk_counts.assign(nb_chunks * nb_tiles, 0);
+
+  // tile of each particle, counted per chunk
+  _pool.parallel_for(n, nb_chunks, [&] (size_t chunk, size_t begin, size_t end) {
+    int* counts = &_chunk_counts[chunk * nb_tiles];
+    for (size_t i = begin; i < end; ++i) {
+      const glm::ivec2 px = to_pixel(particles[i]);
+      if (px.x < 0 || px.y < 0 || px.x >= _width || px.y >= _height) {
+        _tiles[i] = -1;
+      } else {
+        _tiles[i] = (px.y / TILE_SIZE) * _tiles_x + px.x / TILE_SIZE;
+        ++counts[_tiles[i]];
+      }
+    }
+  });
+
+  // turn counts into scatter offsets, ordered by tile then by chunk
+  _tile_offsets.resize(nb_tiles + 1);
+  _tile_lod.resize(nb_tiles);
+  int offset = 0;
+  for (size_t t = 0; t < nb_tiles; ++t) {
+    _tile_offsets[t] = offset;
+    for (size_t c = 0; c < nb_chunks; ++c) {
+      const int count = _chunk_counts[c * nb_tiles + t];
+      _chunk_counts[c * nb_tiles + t] = offset;
+      offset += count;
+    }
+    const int tx = (int)t % _tiles_x;
+    const int ty = (int)t / _tiles_x;
+    const int area = (std::min(_width, (tx + 1) * TILE_SIZE) - tx * TILE_SIZE)
+                   * (std::min(_height, (ty + 1) * TILE_SIZE) - ty * TILE_SIZE);
+    _tile_lod[t] = (offset - _tile_offsets[t] > _lod_threshold * area);
+  }
+  _tile_offsets[nb_tiles] = offset;
+
+  _pool.parallel_for(n, nb_chunks, [&] (size_t chunk, size_t begin, size_t end) {
+    int* offsets = &_chunk_counts[chunk * nb_tiles];
+    for (size_t i = begin; i < end; ++i) {
+      if (_tiles[i] >= 0) _order[offsets[_tiles[i]]++] = (int)i;
+    }
+  });
+}
+
+void DrawList::emit_points(const std::vector<glm::vec2>& particles)
+{
+  const size_t nb_tiles = _tiles_x * _tiles_y;
+  const size_t nb_chunks = _pool.nb_chunks(nb_tiles, 16);
+  reset_chunks(nb_chunks);
+
+  _pool.parallel_for(nb_tiles, nb_chunks, [&] (size_t chunk, size_t begin, size_t end) {
+    std::vector<glm::vec2>& out = _chunk_vertices[chunk];
+    bool occupied[TILE_SIZE * TILE_SIZE];
+    for (size_t t = begin; t < end; ++t) {
+      const int* first = _order.data() + _tile_offsets[t];
+      const int* last = _order.data() + _tile_offsets[t + 1];
+      if (!_tile_lod[t]) {
+        for (const int* i = first; i != last; ++i) out.push_back(particles[*i]);
+        continue;
+      }
+
+      // one aggregate point per occupied pixel of the tile
+      const int x0 = ((int)t % _tiles_x) * TILE_SIZE;
+      const int y0 = ((int)t / _tiles_x) * TILE_SIZE;
+      std::memset(occupied, 0, sizeof(occupied));
+      for (const int* i = first; i != last; ++i) {
+        const glm::ivec2 px = to_pixel(particles[*i]);
+        occupied[(px.y - y0) * TILE_SIZE + (px.x - x0)] = true;
+      }
+      for (int k = 0; k < TILE_SIZE * TILE_SIZE; ++k) {
+        if (occupied[k]) out.push_back(to_world(x0 + k % TILE_SIZE, y0 + k / TILE_SIZE));
+      }
+    }
+  });
+
+  concatenate(_pool, _chunk_vertices, _points);
+}
+
+void DrawList::emit_lines(const std::vector<glm::vec2>& particles,
+                          const std::vector<Constraint>& constraints)
+{
+  const size_t nb_chunks = _pool.nb_chunks(constraints.size());
+  reset_chunks(nb_chunks);
+
+  _pool.parallel_for(constraints.size(), nb_chunks, [&] (size_t chunk, size_t begin, size_t end) {
+    std::vector<glm::vec2>& out = _chunk_vertices[chunk];
+    for (size_t k = begin; k < end; ++k) {
+      const glm::vec2& a = particles[constraints[k].first];
+      const glm::vec2& b = particles[constraints[k].second];
+      // cull on the bounding box of the line
+      if (std::max(a.x, b.x) < _view_min.x || std::min(a.x, b.x) > _view_max.x ||
+          std::max(a.y, b.y) < _view_min.y || std::min(a.y, b.y) > _view_max.y) continue;
+      // sub-pixel lines are covered by their end points
+      if (to_pixel(a) == to_pixel(b)) continue;
+      out.push_back(a);
+      out.push_back(b);
+    }
+  });
+
+  concatenate(_pool, _chunk_vertices, _lines);
+}
+
+void DrawList::reset_chunks(size_t nb_chunks)
+{
+  // keep the capacity of the per-chunk buffers from one frame to the next
+  _chunk_vertices.resize(nb_chunks);
+  for (auto& chunk : _chunk_vertices) chunk.clear();
+}
+
+void DrawList::concatenate(ThreadPool& pool,
+                           const std::vector<std::vector<glm::vec2>>& chunks,
+                           std::vector<glm::vec2>& out)
+{
+  std::vector<size_t> offsets(chunks.size() + 1, 0);
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    offsets[c + 1] = offsets[c] + chunks[c].size();
+  }
+  out.resize(offsets.back());
+  pool.parallel_for(chunks.size(), chunks.size(), [&] (size_t, size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      std::copy(chunks[c].begin(), chunks[c].end(), out.begin() + offsets[c]);
+    }
+  });
+}
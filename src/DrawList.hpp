@@ -0,0 +1,61 @@
+#pragma once
+#include "ParticleSystem.hpp"
+#include "ThreadPool.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Builds the compact vertex arrays that get uploaded for the particles and
+// constraints visible in a view rectangle. Particles are bucketed into tiles
+// of TILE_SIZE x TILE_SIZE pixels; tiles outside the view are culled and tiles
+// denser than the LOD threshold are drawn as one point per occupied pixel.
+class DrawList
+{
+public:
+  static const int TILE_SIZE = 32;
+
+public:
+  explicit DrawList(ThreadPool& pool = ThreadPool::global());
+
+  // particles per pixel above which a tile is aggregated
+  void set_lod_threshold(float particles_per_pixel);
+
+  void build(const std::vector<glm::vec2>& particles,
+             const std::vector<Constraint>& constraints,
+             const glm::vec2& view_min, const glm::vec2& view_max,
+             int width, int height);
+
+  const std::vector<glm::vec2>& points() const;
+  const std::vector<glm::vec2>& lines() const;
+
+private:
+  glm::ivec2 to_pixel(const glm::vec2& p) const;
+  glm::vec2 to_world(int x, int y) const;
+
+  void bucket_particles(const std::vector<glm::vec2>& particles);
+  void emit_points(const std::vector<glm::vec2>& particles);
+  void emit_lines(const std::vector<glm::vec2>& particles,
+                  const std::vector<Constraint>& constraints);
+  void reset_chunks(size_t nb_chunks);
+  static void concatenate(ThreadPool& pool,
+                          const std::vector<std::vector<glm::vec2>>& chunks,
+                          std::vector<glm::vec2>& out);
+
+private:
+  ThreadPool& _pool;
+  float _lod_threshold;
+
+  glm::vec2 _view_min, _view_max;
+  glm::vec2 _pixels_per_unit;
+  int _width, _height;
+  int _tiles_x, _tiles_y;
+
+  std::vector<int> _tiles;         // tile of each particle, -1 when culled
+  std::vector<int> _chunk_counts;  // [chunk][tile] particle counts, then offsets
+  std::vector<int> _tile_offsets;  // start of each tile in _order
+  std::vector<int> _order;         // particle indices sorted by tile
+  std::vector<char> _tile_lod;
+
+  std::vector<std::vector<glm::vec2>> _chunk_vertices;
+  std::vector<glm::vec2> _points;
+  std::vector<glm::vec2> _lines;
+};
@@ -0,0 +1,70 @@
+#include "FramePacer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  // ring buffer of the last FramePacer::HISTORY values
+  void push(std::vector<double>& history, size_t& next, double value)
+  {
+    if (history.size() < FramePacer::HISTORY) {
+      history.push_back(value);
+    } else {
+      history[next] = value;
+      next = (next + 1) % FramePacer::HISTORY;
+    }
+  }
+}
+
+FramePacer::FramePacer()
+  : _refresh_period(1.0 / 60), _margin(0.002), _next_render_time(0), _next_latency(0)
+{}
+
+void FramePacer::set_refresh_period(double period)
+{
+  _refresh_period = period;
+}
+
+double FramePacer::refresh_period() const
+{
+  return _refresh_period;
+}
+
+void FramePacer::set_margin(double margin)
+{
+  _margin = margin;
+}
+
+double FramePacer::wake_time(double last_present) const
+{
+  // presents land on vsyncs, the next one is a period after the last present
+  const double deadline = last_present + _refresh_period;
+  return deadline - std::min(_refresh_period, render_time() + _margin);
+}
+
+void FramePacer::add_render_time(double render_time)
+{
+  push(_render_times, _next_render_time, render_time);
+}
+
+// the 90th percentile
+double FramePacer::render_time() const
+{
+  if (_render_times.empty()) return _refresh_period;
+  std::vector<double> sorted(_render_times);
+  auto nth = sorted.begin() + (sorted.size() * 9) / 10;
+  std::nth_element(sorted.begin(), nth, sorted.end());
+  return *nth;
+}
+
+void FramePacer::add_latency(double latency)
+{
+  push(_latencies, _next_latency, latency);
+}
+
+double FramePacer::latency() const
+{
+  if (_latencies.empty()) return 0;
+  double sum = 0;
+  for (const double l : _latencies) sum += l;
+  return sum / _latencies.size();
+}
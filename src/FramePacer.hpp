@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Decides when to sample input so that it is as fresh as possible when the
+// frame is presented: the latched part of a frame (input, draw, swap) starts
+// one render time plus a margin before the next vsync. The render time is a
+// high percentile of the recent ones, so that an occasional slow frame does
+// not make the next ones miss their vsync. Times are in seconds.
+class FramePacer
+{
+public:
+  static const size_t HISTORY = 64;
+
+public:
+  FramePacer();
+
+  void set_refresh_period(double period);
+  double refresh_period() const;
+  void set_margin(double margin);
+
+  // when the latched part should start, given when the last present happened
+  double wake_time(double last_present) const;
+
+  void add_render_time(double render_time);
+  double render_time() const;
+
+  // from sampling the input to presenting the frame, averaged over HISTORY frames
+  void add_latency(double latency);
+  double latency() const;
+
+private:
+  double _refresh_period;
+  double _margin;
+  std::vector<double> _render_times;
+  size_t _next_render_time;
+  std::vector<double> _latencies;
+  size_t _next_latency;
+};
@@ -3,14 +3,60 @@
 #include <algorithm>
 #include <cmath>
 
+namespace {
+  // error bound of a float 2x2 determinant, see Shewchuk's "Adaptive
+  // Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates"
+  const float EPSILON = 1.0f / (1 << 24);
+  const float CCW_ERRBOUND = (3.0f + 16.0f * EPSILON) * EPSILON;
+
+  // x + y == a + b exactly
+  void two_sum(double a, double b, double& x, double& y)
+  {
+    x = a + b;
+    const double bv = x - a;
+    const double av = x - bv;
+    y = (a - av) + (b - bv);
+  }
+
+  // Products of two floats are exact in double precision, so summing them
+  // into a nonoverlapping expansion gives the exact sign of the sum.
+  int exact_sign(const double* terms, int n)
+  {
+    double e[8];
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+      double q = terms[i];
+      int k = 0;
+      for (int j = 0; j < m; ++j) {
+        double sum, err;
+        two_sum(q, e[j], sum, err);
+        if (err != 0) e[k++] = err;
+        q = sum;
+      }
+      if (q != 0) e[k++] = q;
+      m = k;
+    }
+    // the last component is the largest one
+    return (m == 0 ? 0 : (e[m - 1] > 0 ? 1 : -1));
+  }
+
+  // sign of left - right, or 0 when too close to call
+  int filtered_sign(float left, float right)
+  {
+    const float det = left - right;
+    const float errbound = CCW_ERRBOUND * (std::fabs(left) + std::fabs(right));
+    return (det > errbound) - (-det > errbound);
+  }
+}
+
 namespace geometry {
-  const float _PI = 3.14159265358979323846f;
-  const float _2PI = 2 * _PI;
+  const float PI = 3.14159265358979323846f;
+  const float TWO_PI = 2 * PI;
 
   float angle2D(const glm::vec2& u, const glm::vec2& v)
   {
     const float a = std::atan2f(v.y - u.y, v.x - u.x);
-    return (a < 0 ? a + _2PI : a);
+    return (a < 0 ? a + TWO_PI : a);
   }
 
   void sort_by_angle(const glm::vec2& origin, std::vector<glm::vec2>& vertices)
@@ -25,6 +71,47 @@ namespace geometry {
     return (a.x - c.x) * (b.y - c.y) - (a.y - c.y) * (b.x - c.x);
   }
 
+  int orient2D_sign(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+  {
+    const float left = (a.x - c.x) * (b.y - c.y);
+    const float right = (a.y - c.y) * (b.x - c.x);
+    const int s = filtered_sign(left, right);
+    if (s != 0 || (left == 0 && right == 0)) return s;
+
+    const double terms[6] = {
+      (double)a.x * b.y, -(double)a.x * c.y, -(double)c.x * b.y,
+      -(double)a.y * b.x, (double)a.y * c.x, (double)c.y * b.x
+    };
+    return exact_sign(terms, 6);
+  }
+
+  int cross2D_sign(const glm::vec2& r, const glm::vec2& o, const glm::vec2& p)
+  {
+    const float left = r.x * (p.y - o.y);
+    const float right = r.y * (p.x - o.x);
+    const int s = filtered_sign(left, right);
+    if (s != 0 || (left == 0 && right == 0)) return s;
+
+    const double terms[4] = {
+      (double)r.x * p.y, -(double)r.x * o.y, -(double)r.y * p.x, (double)r.y * o.x
+    };
+    return exact_sign(terms, 4);
+  }
+
+  int cross2D_sign(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, const glm::vec2& d)
+  {
+    const float left = (b.x - a.x) * (d.y - c.y);
+    const float right = (b.y - a.y) * (d.x - c.x);
+    const int s = filtered_sign(left, right);
+    if (s != 0 || (left == 0 && right == 0)) return s;
+
+    const double terms[8] = {
+      (double)b.x * d.y, -(double)b.x * c.y, -(double)a.x * d.y, (double)a.x * c.y,
+      -(double)b.y * d.x, (double)b.y * c.x, (double)a.y * d.x, -(double)a.y * c.x
+    };
+    return exact_sign(terms, 8);
+  }
+
   bool box_has_point(const glm::vec2& a, const glm::vec2& b, const glm::vec2& point)
   {
     const auto xx = std::minmax(a.x, b.x);
@@ -34,7 +121,7 @@ namespace geometry {
 
   bool segment_has_point(const glm::vec2& a, const glm::vec2& b, const glm::vec2& point)
   {
-    return box_has_point(a, b, point) && orient2D(a, b, point) == 0;
+    return box_has_point(a, b, point) && orient2D_sign(a, b, point) == 0;
   }
 
   bool intersect_ray_seg(const glm::vec2& o, const glm::vec2& r,
@@ -44,29 +131,27 @@ namespace geometry {
     const glm::vec2 u = a - o;
     const glm::vec2 v = b - o;
     const glm::vec2 w = v - u;
-    const float epsilon = 0.00001f;
 
     // Solve p = a + lambda * (b - a)
-    float l_n = r.x * u.y - r.y * u.x;
-    if (fabs(l_n) < epsilon) l_n = 0;
-    const float l_d = r.y * w.x - r.x * w.y;
-
-    // Must have 0 <= lambda <= 1
-    const bool lt0 = (l_d > 0 ? l_n < 0 : l_n > 0);
-    const bool gt1 = (l_d > 0 ? l_n > l_d : l_n < l_d);
-    if (lt0 || gt1) return false;
+    // with l_n = r x u, l_d = r x u - r x v, and l_n - l_d = r x v
+    // Must have 0 <= lambda <= 1, i.e. a and b not strictly on the same side of the ray
+    const int sa = cross2D_sign(r, o, a);
+    const int sb = cross2D_sign(r, o, b);
+    if (sa * sb > 0) return false;
 
     // Solve p = mu * r
     // Must have mu > 0
     float mu = 0;
-    if (l_d == 0) {
+    if (sa == 0 && sb == 0) {
       mu = (r.x == 0 ? u.y / r.y : u.x / r.x);
       if (mu <= 0) return false;
     } else {
+      // sign(l_d) == sign(r x u - r x v), sign(mu) == -orient2D(a, b, o)
+      const int sd = (sa != 0 ? sa : -sb);
+      if (orient2D_sign(a, b, o) != -sd) return false;
+      const float l_d = r.y * w.x - r.x * w.y;
       mu = (u.y * v.x - u.x * v.y);
-      const bool gt0 = (l_d > 0 ? mu > 0 : mu < 0);
-      if (!gt0) return false;
-      mu /= l_d;
+      mu = (l_d != 0 ? mu / l_d : (float)((double)mu / ((double)r.y * w.x - (double)r.x * w.y)));
     }
 
     point = o + mu * r;
@@ -98,8 +183,8 @@ namespace geometry {
                          const glm::vec2& c, const glm::vec2& d,
                          glm::vec2& point)
   {
-    const float a1 = orient2D(a, b, c);
-    const float a2 = orient2D(a, b, d);
+    const int a1 = orient2D_sign(a, b, c);
+    const int a2 = orient2D_sign(a, b, d);
     if (a1 == 0 && a2 == 0) {
       return false;
     }
@@ -112,8 +197,8 @@ namespace geometry {
       return true;
     }
 
-    const float a3 = orient2D(c, d, a);
-    const float a4 = orient2D(c, d, b);
+    const int a3 = orient2D_sign(c, d, a);
+    const int a4 = orient2D_sign(c, d, b);
     if (a3 == 0 && a4 == 0) {
       return false;
     }
@@ -126,11 +211,13 @@ namespace geometry {
       return true;
     }
 
-    if (a1 * a2 < 0.0f) {
+    if (a1 * a2 < 0) {
       // c and d are on different sides of ab
-      if (a3 * a4 < 0.0f) {
+      if (a3 * a4 < 0) {
         // a and b are on different sides of cd
-        const float t = a3 / (a3 - a4);
+        const float o3 = orient2D(c, d, a);
+        const float o4 = orient2D(c, d, b);
+        const float t = (o3 == o4 ? 0.5f : glm::clamp(o3 / (o3 - o4), 0.0f, 1.0f));
         point = a + t * (b - a);
         return true;
       }
@@ -16,6 +16,15 @@ namespace geometry {
   // = 0 if a, b, c are collinear
   float orient2D(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c);
 
+  // exact sign of orient2D: a float filter with an error bound settles most
+  // cases, exact expansion arithmetic the ones too close to call
+  int orient2D_sign(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c);
+
+  // exact sign of the cross product r x (p - o)
+  int cross2D_sign(const glm::vec2& r, const glm::vec2& o, const glm::vec2& p);
+  // exact sign of the cross product (b - a) x (d - c)
+  int cross2D_sign(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, const glm::vec2& d);
+
   bool box_has_point(const glm::vec2& a, const glm::vec2& b, const glm::vec2& point);
 
   bool segment_has_point(const glm::vec2& a, const glm::vec2& b, const glm::vec2& point);
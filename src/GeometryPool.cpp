@@ -0,0 +1,126 @@
+#include "GeometryPool.hpp"
+#include "Stats.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+GeometryPoolBase::GeometryPoolBase(GLenum mode, size_t vertex_size, void (*enable_attributes)(), size_t capacity)
+  : _mode(mode), _vertex_size(vertex_size), _enable_attributes(enable_attributes), _vao(0), _vbo(0),
+    _nb_shapes(0), _draw_dirty(false)
+{
+  glGenVertexArrays(1, &_vao);
+  create_buffer(std::max<size_t>(1, capacity));
+}
+
+GeometryPoolBase::~GeometryPoolBase()
+{
+  glDeleteBuffers(1, &_vbo);
+  glDeleteVertexArrays(1, &_vao);
+}
+
+// a new buffer of capacity vertices, with the contents of the old one
+void GeometryPoolBase::create_buffer(size_t capacity)
+{
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, capacity * _vertex_size, nullptr, GL_STATIC_DRAW);
+  if (_vbo) {
+    glBindBuffer(GL_COPY_READ_BUFFER, _vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, _allocator.size() * _vertex_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glDeleteBuffers(1, &_vbo);
+  }
+  _vbo = buffer;
+  _allocator.grow((int)capacity);
+
+  // the attribute pointers refer to the buffer bound when they are set
+  glBindVertexArray(_vao);
+  _enable_attributes();
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int GeometryPoolBase::add(const void* vertices, size_t count)
+{
+  if (count == 0) throw std::runtime_error("GeometryPool::add(): shape without vertices");
+  int first = _allocator.allocate((int)count);
+  if (first < 0) {
+    create_buffer(std::max(2 * capacity(), capacity() + count));
+    first = _allocator.allocate((int)count);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, first * _vertex_size, count * _vertex_size, vertices);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stats::count_upload(count * _vertex_size);
+
+  int shape = (int)_shapes.size();
+  if (_free_shapes.empty()) {
+    _shapes.push_back(Range());
+  } else {
+    shape = _free_shapes.back();
+    _free_shapes.pop_back();
+  }
+  _shapes[shape] = { first, (int)count, true, true };
+  ++_nb_shapes;
+  _draw_dirty = true;
+  return shape;
+}
+
+void GeometryPoolBase::remove(int shape)
+{
+  Range& range = _shapes.at(shape);
+  if (!range.alive) throw std::runtime_error("GeometryPool::remove(): no such shape");
+  _allocator.free(range.first, range.count);
+  range.alive = false;
+  _free_shapes.push_back(shape);
+  --_nb_shapes;
+  _draw_dirty = true;
+}
+
+void GeometryPoolBase::set_visible(int shape, bool visible)
+{
+  Range& range = _shapes.at(shape);
+  _draw_dirty |= (range.visible != visible);
+  range.visible = visible;
+}
+
+bool GeometryPoolBase::is_visible(int shape) const
+{
+  return _shapes.at(shape).alive && _shapes[shape].visible;
+}
+
+size_t GeometryPoolBase::nb_shapes() const
+{
+  return _nb_shapes;
+}
+
+size_t GeometryPoolBase::capacity() const
+{
+  return _allocator.size();
+}
+
+void GeometryPoolBase::draw() const
+{
+  if (_draw_dirty) {
+    // by position in the buffer, which the GPU reads in order
+    std::vector<const Range*> visible;
+    for (const auto& range : _shapes) {
+      if (range.alive && range.visible) visible.push_back(&range);
+    }
+    std::sort(visible.begin(), visible.end(), [] (const Range* a, const Range* b) { return a->first < b->first; });
+    _firsts.clear();
+    _counts.clear();
+    for (const Range* range : visible) {
+      _firsts.push_back(range->first);
+      _counts.push_back(range->count);
+    }
+    _draw_dirty = false;
+  }
+  if (_firsts.empty()) return;
+
+  glBindVertexArray(_vao);
+  glMultiDrawArrays(_mode, _firsts.data(), _counts.data(), (GLsizei)_firsts.size());
+  stats::count_draw();
+  glBindVertexArray(0);
+}
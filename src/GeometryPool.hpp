@@ -0,0 +1,76 @@
+#pragma once
+#include "RangeAllocator.hpp"
+#include "Vertex.hpp"
+#include <glad/glad.h>
+#include <vector>
+
+// Many static shapes of the same vertex layout in a single GL_STATIC_DRAW
+// buffer, drawn with a single glMultiDrawArrays() over the visible ones.
+// Shapes are sub-allocated through a free list; the buffer doubles when it
+// is full. Use one pool per layout and material (shader and uniforms).
+class GeometryPoolBase
+{
+public:
+  GeometryPoolBase(const GeometryPoolBase&) = delete;
+  GeometryPoolBase& operator=(const GeometryPoolBase&) = delete;
+
+  void remove(int shape);
+  void set_visible(int shape, bool visible);
+  bool is_visible(int shape) const;
+  size_t nb_shapes() const;
+  size_t capacity() const;  // in vertices
+
+  void draw() const;
+
+protected:
+  GeometryPoolBase(GLenum mode, size_t vertex_size, void (*enable_attributes)(), size_t capacity);
+  ~GeometryPoolBase();
+
+  int add(const void* vertices, size_t count);
+
+private:
+  struct Range
+  {
+    int first;
+    int count;
+    bool visible;
+    bool alive;
+  };
+
+private:
+  void create_buffer(size_t capacity);
+
+private:
+  const GLenum _mode;
+  const size_t _vertex_size;
+  void (*_enable_attributes)();
+  GLuint _vao;
+  GLuint _vbo;
+  RangeAllocator _allocator;
+
+  std::vector<Range> _shapes;
+  std::vector<int> _free_shapes;
+  size_t _nb_shapes;
+
+  // what draw() submits, rebuilt when shapes come, go, show or hide
+  mutable std::vector<GLint> _firsts;
+  mutable std::vector<GLsizei> _counts;
+  mutable bool _draw_dirty;
+};
+
+template <typename Layout>
+class GeometryPool : public GeometryPoolBase
+{
+public:
+  typedef Layout Vertex;
+
+  explicit GeometryPool(GLenum mode, size_t capacity = 1 << 16)
+    : GeometryPoolBase(mode, sizeof(Vertex), &vertex::attribute_pointers<Layout>::enable, capacity)
+  {}
+
+  // the id of the new shape, visible
+  int add(const std::vector<Vertex>& vertices)
+  {
+    return GeometryPoolBase::add(vertices.data(), vertices.size());
+  }
+};
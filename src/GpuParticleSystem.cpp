@@ -0,0 +1,217 @@
+#include "GpuParticleSystem.hpp"
+#include "Stats.hpp"
+#include <algorithm>
+
+namespace {
+// the same operations in the same order as ParticleSystem, so that both
+// agree to rounding
+const char* INTEGRATE_GLSL = R"(#version 330 core
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 old_position;
+layout (location = 2) in float inv_mass;
+
+uniform vec2 gravity;
+uniform float dt2;
+uniform vec2 box_min;
+uniform vec2 box_max;
+
+out vec2 out_position;
+out vec2 out_old_position;
+out float out_inv_mass;
+
+void main()
+{
+    vec2 pos = position;
+    vec2 old_pos = old_position;
+    if (inv_mass != 0.0) {
+        pos += (position - old_position) + dt2 * gravity;
+        old_pos = position;
+    }
+    out_position = max(box_min, min(box_max, pos));
+    out_old_position = old_pos;
+    out_inv_mass = inv_mass;
+}
+)";
+}
+
+GpuParticleSystem::GpuParticleSystem(const glm::vec2& min, const glm::vec2& max, size_t capacity)
+  : _integrate("GpuParticleSystem::integrate", INTEGRATE_GLSL,
+               { "out_position", "out_old_position", "out_inv_mass" }),
+    _current(0), _nb_particles(0), _capacity(0),
+    _gravity(0, -4.81f), _timestep(0.005f), _min(min), _max(max)
+{
+  _vaos[0] = _vaos[1] = 0;
+  _vbos[0] = _vbos[1] = 0;
+  glGenVertexArrays(2, _vaos);
+  create_buffers(std::max<size_t>(1, capacity));
+}
+
+GpuParticleSystem::~GpuParticleSystem()
+{
+  glDeleteBuffers(2, _vbos);
+  glDeleteVertexArrays(2, _vaos);
+}
+
+// new buffers of capacity particles, the current one with the latest state
+void GpuParticleSystem::create_buffers(size_t capacity)
+{
+  for (int k = 0; k < 2; ++k) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_COPY);
+    if (k == _current && _vbos[k]) {
+      glBindBuffer(GL_COPY_READ_BUFFER, _vbos[k]);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, _nb_particles * sizeof(Vertex));
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    if (_vbos[k]) glDeleteBuffers(1, &_vbos[k]);
+    _vbos[k] = buffer;
+
+    glBindVertexArray(_vaos[k]);
+    vertex::attribute_pointers<Vertex>::enable();
+    glBindVertexArray(0);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  _capacity = capacity;
+}
+
+void GpuParticleSystem::step()
+{
+  if (_nb_particles == 0) return;
+
+  const int next = 1 - _current;
+  _integrate.attach();
+  _integrate.set_uniform("gravity", _gravity);
+  _integrate.set_uniform("dt2", _timestep * _timestep);
+  _integrate.set_uniform("box_min", _min);
+  _integrate.set_uniform("box_max", _max);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(_vaos[_current]);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, _vbos[next]);
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, (GLsizei)_nb_particles);
+  stats::count_draw();
+  glEndTransformFeedback();
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindVertexArray(0);
+  glDisable(GL_RASTERIZER_DISCARD);
+  _integrate.detach();
+
+  _current = next;
+}
+
+int GpuParticleSystem::add_particle(const glm::vec2& position, float inv_mass)
+{
+  add_particles({ position }, inv_mass);
+  return (int)_nb_particles - 1;
+}
+
+void GpuParticleSystem::add_particles(const std::vector<glm::vec2>& positions, float inv_mass)
+{
+  std::vector<Vertex> vertices(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    vertex::set_position(vertices[i], positions[i]);
+    vertex::get<1>(vertices[i]).set(0, positions[i].x);
+    vertex::get<1>(vertices[i]).set(1, positions[i].y);
+    vertex::get<2>(vertices[i]).set(0, inv_mass);
+  }
+  upload(vertices);
+}
+
+void GpuParticleSystem::upload(const std::vector<Vertex>& vertices)
+{
+  if (vertices.empty()) return;
+  if (_nb_particles + vertices.size() > _capacity) {
+    create_buffers(std::max(2 * _capacity, _nb_particles + vertices.size()));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, _vbos[_current]);
+  glBufferSubData(GL_ARRAY_BUFFER, _nb_particles * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stats::count_upload(vertices.size() * sizeof(Vertex));
+  _nb_particles += vertices.size();
+}
+
+size_t GpuParticleSystem::nb_particles() const
+{
+  return _nb_particles;
+}
+
+size_t GpuParticleSystem::capacity() const
+{
+  return _capacity;
+}
+
+void GpuParticleSystem::clear()
+{
+  _nb_particles = 0;
+}
+
+void GpuParticleSystem::set_gravity(const glm::vec2& gravity)
+{
+  _gravity = gravity;
+}
+
+const glm::vec2& GpuParticleSystem::gravity() const
+{
+  return _gravity;
+}
+
+void GpuParticleSystem::set_timestep(float timestep)
+{
+  _timestep = timestep;
+}
+
+float GpuParticleSystem::timestep() const
+{
+  return _timestep;
+}
+
+const glm::vec2& GpuParticleSystem::box_min() const
+{
+  return _min;
+}
+
+const glm::vec2& GpuParticleSystem::box_max() const
+{
+  return _max;
+}
+
+const std::vector<glm::vec2>& GpuParticleSystem::read_particles()
+{
+  _readback.resize(_nb_particles);
+  _positions.resize(_nb_particles);
+  if (_nb_particles > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, _vbos[_current]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, _nb_particles * sizeof(Vertex), _readback.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  for (size_t i = 0; i < _nb_particles; ++i) _positions[i] = vertex::position(_readback[i]);
+  return _positions;
+}
+
+int GpuParticleSystem::pick(const glm::vec2& position, float radius)
+{
+  const std::vector<glm::vec2>& positions = read_particles();
+  int nearest = -1;
+  float best = radius * radius;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    const glm::vec2 d = positions[i] - position;
+    if (glm::dot(d, d) < best || (glm::dot(d, d) == best && nearest < 0)) {
+      best = glm::dot(d, d);
+      nearest = (int)i;
+    }
+  }
+  return nearest;
+}
+
+void GpuParticleSystem::draw(GLenum mode) const
+{
+  if (_nb_particles == 0) return;
+  glBindVertexArray(_vaos[_current]);
+  glDrawArrays(mode, 0, (GLsizei)_nb_particles);
+  stats::count_draw();
+  glBindVertexArray(0);
+}
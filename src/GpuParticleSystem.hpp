@@ -0,0 +1,70 @@
+#pragma once
+#include "Shader.hpp"
+#include "Vertex.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Free particles that live on the GPU. Positions and old positions are kept
+// in two buffers used in turn: step() runs the Verlet integration, gravity
+// and the box clamp of ParticleSystem in a vertex shader that reads one
+// buffer and writes the other by transform feedback, and draw() reads the
+// latest one as it is. Nothing comes back to the CPU unless asked for, by
+// read_particles() or pick(). There are no constraints and no sleeping.
+class GpuParticleSystem
+{
+public:
+  // position, old position, inverse mass
+  typedef vertex::layout<vertex::float2, vertex::float2, vertex::float1> Vertex;
+
+public:
+  GpuParticleSystem(const glm::vec2& min, const glm::vec2& max, size_t capacity = 1024);
+  GpuParticleSystem(const GpuParticleSystem&) = delete;
+  GpuParticleSystem& operator=(const GpuParticleSystem&) = delete;
+  ~GpuParticleSystem();
+
+  void step();
+
+  // inv_mass == 0 pins the particle in place; indices never change
+  int add_particle(const glm::vec2& position, float inv_mass = 1.0f);
+  void add_particles(const std::vector<glm::vec2>& positions, float inv_mass = 1.0f);
+  size_t nb_particles() const;
+  size_t capacity() const;
+  void clear();
+
+  void set_gravity(const glm::vec2& gravity);
+  const glm::vec2& gravity() const;
+  void set_timestep(float timestep);
+  float timestep() const;
+
+  const glm::vec2& box_min() const;
+  const glm::vec2& box_max() const;
+
+  // copies the positions back from the GPU, which waits for it
+  const std::vector<glm::vec2>& read_particles();
+  // the nearest particle within radius of position, or -1, from a readback
+  int pick(const glm::vec2& position, float radius);
+
+  // with the attributes of Vertex, position at location 0
+  void draw(GLenum mode = GL_POINTS) const;
+
+private:
+  void create_buffers(size_t capacity);
+  void upload(const std::vector<Vertex>& vertices);
+
+private:
+  Shader _integrate;
+  GLuint _vaos[2];
+  GLuint _vbos[2];
+  int _current;  // the buffer holding the latest state
+  size_t _nb_particles;
+  size_t _capacity;
+
+  glm::vec2 _gravity;
+  float _timestep;
+  glm::vec2 _min;
+  glm::vec2 _max;
+
+  std::vector<Vertex> _readback;
+  std::vector<glm::vec2> _positions;
+};
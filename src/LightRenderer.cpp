@@ -0,0 +1,314 @@
+#include "LightRenderer.hpp"
+#include "Stats.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::string glsl(const char* body)
+{
+  return "#version 330 core\n#define MAX_LIGHTS " + std::to_string(LightRenderer::MAX_LIGHTS) +
+         "\n#define PI 3.14159265358979\n" + body;
+}
+
+// one instance per light
+const char* SHADOW_VERTEX_GLSL = R"(
+layout (location = 0) in vec2 position;
+
+flat out int Light;
+
+void main()
+{
+    Light = gl_InstanceID;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+// A segment seen from a light covers the angles between its ends, the short
+// way round, split in two where it crosses -pi. Row i of the atlas is light i.
+const char* SHADOW_GEOMETRY_GLSL = R"(
+layout (lines) in;
+layout (line_strip, max_vertices = 4) out;
+
+flat in int Light[];
+
+uniform vec4 lights[MAX_LIGHTS];
+
+flat out vec2 A;
+flat out vec2 B;
+flat out vec3 L;
+
+vec3 light;
+
+// outputs are undefined after EmitVertex(), so they are set for each vertex
+void emit(float angle, float row)
+{
+    A = gl_in[0].gl_Position.xy;
+    B = gl_in[1].gl_Position.xy;
+    L = light;
+    gl_Position = vec4(angle / PI, row, 0.0, 1.0);
+    EmitVertex();
+}
+
+void span(float from, float to, float row)
+{
+    emit(from, row);
+    emit(to, row);
+    EndPrimitive();
+}
+
+void main()
+{
+    light = lights[Light[0]].xyz;
+    vec2 a = gl_in[0].gl_Position.xy - light.xy;
+    vec2 b = gl_in[1].gl_Position.xy - light.xy;
+    float ta = atan(a.y, a.x);
+    float tb = atan(b.y, b.x);
+    float row = (Light[0] + 0.5) / MAX_LIGHTS * 2.0 - 1.0;
+    if (abs(tb - ta) <= PI) {
+        span(min(ta, tb), max(ta, tb), row);
+    } else {
+        span(-PI, min(ta, tb), row);
+        span(max(ta, tb), PI, row);
+    }
+}
+)";
+
+// the exact distance along the ray of the pixel's angle to the segment
+const char* SHADOW_FRAGMENT_GLSL = R"(
+flat in vec2 A;
+flat in vec2 B;
+flat in vec3 L;
+
+uniform int resolution;
+
+float cross2(vec2 u, vec2 v) { return u.x * v.y - u.y * v.x; }
+
+void main()
+{
+    float angle = gl_FragCoord.x / resolution * 2.0 * PI - PI;
+    vec2 d = vec2(cos(angle), sin(angle));
+    vec2 e = B - A;
+    vec2 w = A - L.xy;
+    float den = cross2(d, e);
+    float s = (abs(den) > 1e-12 ? clamp(cross2(w, d) / den, 0.0, 1.0) : 0.0);
+    float t = length(w + s * e);
+    if (abs(den) <= 1e-12) t = min(t, length(B - L.xy));
+    gl_FragDepth = clamp(t / L.z, 0.0, 1.0);
+}
+)";
+
+// a triangle over the whole viewport
+const char* LIGHT_VERTEX_GLSL = R"(
+uniform vec2 view_min;
+uniform vec2 view_max;
+
+out vec2 Position;
+
+void main()
+{
+    vec2 ndc = vec2((gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID & 2) * 2.0 - 1.0);
+    Position = mix(view_min, view_max, ndc * 0.5 + 0.5);
+    gl_Position = vec4(ndc, 0.0, 1.0);
+}
+)";
+
+// fov.fragment's falloff, faded out at the radius
+const char* LIGHT_FRAGMENT_GLSL = R"(
+in vec2 Position;
+
+out vec4 color;
+
+uniform sampler2D shadows;
+uniform vec4 lights[MAX_LIGHTS];
+uniform vec4 light_colors[MAX_LIGHTS];
+uniform int nb_lights;
+uniform float bias;
+
+void main()
+{
+    vec3 sum = vec3(0.0);
+    for (int i = 0; i < nb_lights; ++i) {
+        vec2 d = Position - lights[i].xy;
+        float dist = length(d);
+        float radius = lights[i].z;
+        if (dist >= radius) continue;
+        vec2 uv = vec2((atan(d.y, d.x) + PI) / (2.0 * PI), (i + 0.5) / MAX_LIGHTS);
+        if (dist > texture(shadows, uv).r * radius + bias) continue;
+        float falloff = (1.0 - dist / radius) / (1.0 + dist);
+        sum += falloff * light_colors[i].rgb * light_colors[i].a;
+    }
+    color = vec4(sum, 1.0);
+}
+)";
+}
+
+const int LightRenderer::MAX_LIGHTS;
+
+LightRenderer::LightRenderer(int resolution)
+  : _shadow_shader({ { GL_VERTEX_SHADER, "LightRenderer::shadow.vertex", glsl(SHADOW_VERTEX_GLSL) },
+                     { GL_GEOMETRY_SHADER, "LightRenderer::shadow.geometry", glsl(SHADOW_GEOMETRY_GLSL) },
+                     { GL_FRAGMENT_SHADER, "LightRenderer::shadow.fragment", glsl(SHADOW_FRAGMENT_GLSL) } }),
+    _light_shader({ { GL_VERTEX_SHADER, "LightRenderer::light.vertex", glsl(LIGHT_VERTEX_GLSL) },
+                    { GL_FRAGMENT_SHADER, "LightRenderer::light.fragment", glsl(LIGHT_FRAGMENT_GLSL) } }),
+    _resolution(resolution), _nb_segment_vertices(0), _segments_capacity(0)
+{
+  if (resolution <= 0) throw std::runtime_error("LightRenderer::LightRenderer(): bad resolution");
+
+  // distances over radius; angles wrap around
+  glGenTextures(1, &_atlas);
+  glBindTexture(GL_TEXTURE_2D, _atlas);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, resolution, MAX_LIGHTS, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  GLint previous;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+  glGenFramebuffers(1, &_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _atlas, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, previous);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("LightRenderer::LightRenderer(): incomplete shadow atlas framebuffer");
+  }
+
+  glGenVertexArrays(1, &_segments_VAO);
+  glGenBuffers(1, &_segments_VBO);
+  glGenVertexArrays(1, &_empty_VAO);
+
+  _light_shader.attach();
+  _light_shader.set_uniform("shadows", 0);
+  _light_shader.set_uniform("bias", 1e-3f);
+  _light_shader.detach();
+  _shadow_shader.attach();
+  _shadow_shader.set_uniform("resolution", resolution);
+  _shadow_shader.detach();
+}
+
+LightRenderer::~LightRenderer()
+{
+  glDeleteVertexArrays(1, &_empty_VAO);
+  glDeleteBuffers(1, &_segments_VBO);
+  glDeleteVertexArrays(1, &_segments_VAO);
+  glDeleteFramebuffers(1, &_fbo);
+  glDeleteTextures(1, &_atlas);
+}
+
+void LightRenderer::set_occluders(const std::vector<geometry::segment2>& segments)
+{
+  std::vector<glm::vec2> lines;
+  lines.reserve(2 * segments.size());
+  for (const auto& s : segments) {
+    lines.push_back(s.first);
+    lines.push_back(s.second);
+  }
+  set_occluders(lines);
+}
+
+void LightRenderer::set_occluders(const std::vector<glm::vec2>& lines)
+{
+  _nb_segment_vertices = lines.size() & ~(size_t)1;
+  glBindBuffer(GL_ARRAY_BUFFER, _segments_VBO);
+  if (lines.size() > _segments_capacity) {
+    _segments_capacity = std::max(lines.size(), 2 * _segments_capacity);
+    glBufferData(GL_ARRAY_BUFFER, _segments_capacity * sizeof(glm::vec2), nullptr, GL_STREAM_DRAW);
+    glBindVertexArray(_segments_VAO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLvoid*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+  }
+  if (!lines.empty()) glBufferSubData(GL_ARRAY_BUFFER, 0, lines.size() * sizeof(glm::vec2), lines.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stats::count_upload(lines.size() * sizeof(glm::vec2));
+}
+
+void LightRenderer::set_lights(const std::vector<Light>& lights)
+{
+  if (lights.size() > (size_t)MAX_LIGHTS) throw std::runtime_error("LightRenderer::set_lights(): too many lights");
+  _light_positions.clear();
+  _light_colors.clear();
+  for (const auto& light : lights) {
+    _light_positions.push_back(glm::vec4(light.position.x, light.position.y, light.radius, 0.0f));
+    _light_colors.push_back(light.color);
+  }
+}
+
+size_t LightRenderer::nb_lights() const
+{
+  return _light_positions.size();
+}
+
+int LightRenderer::resolution() const
+{
+  return _resolution;
+}
+
+void LightRenderer::render_shadows()
+{
+  GLint framebuffer, viewport[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+  glViewport(0, 0, _resolution, MAX_LIGHTS);
+  glClearDepth(1.0);
+  glClear(GL_DEPTH_BUFFER_BIT);
+
+  if (_nb_segment_vertices > 0 && !_light_positions.empty()) {
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    _shadow_shader.attach();
+    _shadow_shader.set_uniform("lights", _light_positions);
+    glBindVertexArray(_segments_VAO);
+    glDrawArraysInstanced(GL_LINES, 0, (GLsizei)_nb_segment_vertices, (GLsizei)_light_positions.size());
+    stats::count_draw();
+    glBindVertexArray(0);
+    _shadow_shader.detach();
+    glDisable(GL_DEPTH_TEST);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void LightRenderer::render_light(const glm::vec2& view_min, const glm::vec2& view_max)
+{
+  _light_shader.attach();
+  _light_shader.set_uniform("view_min", view_min);
+  _light_shader.set_uniform("view_max", view_max);
+  _light_shader.set_uniform("nb_lights", (GLint)_light_positions.size());
+  _light_shader.set_uniform("lights", _light_positions);
+  _light_shader.set_uniform("light_colors", _light_colors);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _atlas);
+  glBindVertexArray(_empty_VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  stats::count_draw();
+  glBindVertexArray(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  _light_shader.detach();
+}
+
+std::vector<float> LightRenderer::read_shadow_map(int light) const
+{
+  if (light < 0 || (size_t)light >= _light_positions.size()) {
+    throw std::runtime_error("LightRenderer::read_shadow_map(): no such light");
+  }
+
+  GLint framebuffer;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &framebuffer);
+  std::vector<float> depths(_resolution);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+  glReadPixels(0, light, _resolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT, depths.data());
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+
+  for (float& d : depths) d *= _light_positions[light].z;
+  return depths;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "Geometry.hpp"
+#include "Shader.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Light
+{
+  glm::vec2 position;
+  glm::vec4 color;  // rgb times a
+  float radius;     // no light beyond
+};
+
+// 2D lights with shadows, on the GPU. Every light gets a 1D polar shadow
+// map, the distance to the nearest occluder for each of resolution angles,
+// stored as a row of one depth texture atlas. render_shadows() fills all the
+// rows in one instanced pass over the occluder segments, a geometry shader
+// turning each segment into the span of angles it covers from each light.
+// render_light() then adds up the unshadowed lights of every pixel in one
+// fullscreen pass. The CPU only uploads segments and a few uniforms.
+class LightRenderer
+{
+public:
+  static const int MAX_LIGHTS = 64;
+
+public:
+  explicit LightRenderer(int resolution = 512);
+  LightRenderer(const LightRenderer&) = delete;
+  LightRenderer& operator=(const LightRenderer&) = delete;
+  ~LightRenderer();
+
+  // occluders as segments, or as GL_LINES vertex pairs, in world space
+  void set_occluders(const std::vector<geometry::segment2>& segments);
+  void set_occluders(const std::vector<glm::vec2>& lines);
+  void set_lights(const std::vector<Light>& lights);
+  size_t nb_lights() const;
+  int resolution() const;
+
+  // fills the shadow atlas; restores the framebuffer and viewport after
+  void render_shadows();
+  // the light over the current viewport, which shows [view_min, view_max]
+  void render_light(const glm::vec2& view_min, const glm::vec2& view_max);
+
+  // the shadow map of a light, in distances, from angle -pi on; radius
+  // where nothing occludes
+  std::vector<float> read_shadow_map(int light) const;
+
+private:
+  Shader _shadow_shader;
+  Shader _light_shader;
+  int _resolution;
+
+  GLuint _atlas;
+  GLuint _fbo;
+  GLuint _segments_VAO;
+  GLuint _segments_VBO;
+  size_t _nb_segment_vertices;
+  size_t _segments_capacity;  // in vertices
+  GLuint _empty_VAO;
+
+  std::vector<glm::vec4> _light_positions;  // x, y, radius
+  std::vector<glm::vec4> _light_colors;
+};
@@ -1,23 +1,178 @@
 #include "ParticleSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <numeric>
+#include <stdexcept>
 
-Constraint::Constraint(int f, int s, float l)
-  : first(f), second(s), rest_length(l)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  const float PI = 3.14159265358979323846f;
+  // pick cells per axis of the box, each one a byte
+  const int PICK_CELLS = 256;
+
+  float cross2D(const glm::vec2& u, const glm::vec2& v)
+  {
+    return u.x * v.y - u.y * v.x;
+  }
+
+  // cell of a coordinate given in cells from the box corner; the ones
+  // outside, which the last constraints of a step may push particles to,
+  // fall in the border cells
+  int pick_cell(float x)
+  {
+    // in that order, NaN gives 0
+    return (int)std::min((float)(PICK_CELLS - 1), std::max(0.0f, x));
+  }
+
+  // spreads the low 16 bits of x over the even bits
+  uint32_t part1by1(uint32_t x)
+  {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+  }
+
+  uint32_t morton_key(uint32_t x, uint32_t y)
+  {
+    return part1by1(x) | (part1by1(y) << 1);
+  }
+
+  // distance along the Hilbert curve filling the 2^16 x 2^16 grid
+  uint32_t hilbert_key(uint32_t x, uint32_t y)
+  {
+    const uint32_t n = 1u << 16;
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+      const uint32_t rx = (x & s) ? 1 : 0;
+      const uint32_t ry = (y & s) ? 1 : 0;
+      d += s * s * ((3 * rx) ^ ry);
+      if (ry == 0) {
+        if (rx == 1) {
+          x = n - 1 - x;
+          y = n - 1 - y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return d;
+  }
+
+  template <typename T>
+  void gather(std::vector<T>& values, const std::vector<int>& order)
+  {
+    std::vector<T> tmp;
+    tmp.reserve(values.size());
+    for (const int i : order) tmp.push_back(values[i]);
+    values.swap(tmp);
+  }
+
+  // Reorders constraints within a small window so that none shares a particle
+  // with the two before it. Sorted constraints otherwise form one long chain
+  // of dependent loads and stores, which serializes the Gauss-Seidel loop.
+  template <typename T>
+  void interleave(std::vector<T>& constraints)
+  {
+    const size_t WINDOW = 8;
+    std::vector<T> in;
+    in.swap(constraints);
+    constraints.reserve(in.size());
+
+    std::vector<T> pending;
+    uint32_t recent[4] = { ~0u, ~0u, ~0u, ~0u };
+    size_t next = 0;
+    while (next < in.size() || !pending.empty()) {
+      while (pending.size() < WINDOW && next < in.size()) pending.push_back(in[next++]);
+      size_t pick = 0;
+      for (size_t j = 0; j < pending.size(); ++j) {
+        if (std::find(recent, recent + 4, pending[j].first) == recent + 4 &&
+            std::find(recent, recent + 4, pending[j].second) == recent + 4) {
+          pick = j;
+          break;
+        }
+      }
+      const T c = pending[pick];
+      pending.erase(pending.begin() + pick);
+      constraints.push_back(c);
+      recent[0] = recent[2];
+      recent[1] = recent[3];
+      recent[2] = c.first;
+      recent[3] = c.second;
+    }
+  }
+
+  // keeps the constraints for which keep(c) holds, in order; keep may modify c
+  template <typename T, typename F>
+  void filter(std::vector<T>& constraints, F keep)
+  {
+    size_t n = 0;
+    for (size_t k = 0; k < constraints.size(); ++k) {
+      T c = constraints[k];
+      if (keep(c)) constraints[n++] = c;
+    }
+    constraints.erase(constraints.begin() + n, constraints.end());
+  }
+
+  template <typename T>
+  void sort_by_particle(std::vector<T>& constraints)
+  {
+    std::stable_sort(constraints.begin(), constraints.end(), [] (const T& a, const T& b) {
+      return a.first < b.first || (a.first == b.first && a.second < b.second);
+    });
+  }
+}
+
+Constraint::Constraint(int f, int s, float l, float c)
+  : first(f), second(s), rest_length(l), compliance(c)
+{}
+
+RopeConstraint::RopeConstraint(int f, int s, float min, float max, float c)
+  : first(f), second(s), min_length(min), max_length(max), compliance(c)
+{}
+
+AngleConstraint::AngleConstraint(int f, int m, int s, float a, float c)
+  : first(f), middle(m), second(s), rest_angle(a), compliance(c)
+{}
+
+AreaConstraint::AreaConstraint(int f, int s, int t, float a, float c)
+  : first(f), second(s), third(t), rest_area(a), compliance(c)
 {}
 
-ParticleSystem::ParticleSystem(const glm::vec2& min, const glm::vec2& max)
-  : _timestep(0.005f), _nb_particles(0), _gravity(0, -4.81f), _min(min), _max(max)
+ParticleSystem::ParticleSystem(const glm::vec2& min, const glm::vec2& max, ThreadPool& pool)
+  : _timestep(0.005f), _nb_particles(0), _islands_dirty(true), _sleep_energy(1e-6f), _sleep_steps(60),
+    _pool(&pool), _solver(GAUSS_SEIDEL), _rho(0),
+    _min_iterations(3), _max_iterations(3), _tolerance(0), _metrics(), _residuals(),
+    _cells_per_unit(glm::vec2((float)PICK_CELLS, (float)PICK_CELLS) / (max - min)), _grabbed({ -1, 0 }), _grab_target(0, 0), _grab_compliance(0), _grab_lambda(0),
+    _gravity(0, -4.81f), _min(min), _max(max)
 {}
 
+// Scene format:
+//   <n> followed by n lines "x y"               particles
+//   <n> followed by n lines "a b length"        distance constraints
+// then any number of optional sections:
+//   masses <n>     n lines "i inv_mass"         (0 pins the particle)
+//   distances <n>  n lines "a b length compliance"
+//   ropes <n>      n lines "a b min max compliance"
+//   angles <n>     n lines "a m b angle compliance" (radians)
+//   areas <n>      n lines "a b c area compliance"
 void ParticleSystem::read(const std::string& filename)
 {
   clear();
 
   std::ifstream ifs(filename);
   if (ifs) {
-    int n, a, b;
-    float x, y, r;
+    int n, a, b, c;
+    float x, y, r, k;
 
     ifs >> n;
     for (int i = 0; i < n; ++i) {
@@ -30,7 +185,31 @@ void ParticleSystem::read(const std::string& filename)
     ifs >> n;
     for (int i = 0; i < n; ++i) {
       ifs >> a >> b >> r;
-      add_constraint({ a, b, r });
+      add_constraint(Constraint(a, b, r));
+    }
+
+    std::string section;
+    while (ifs >> section >> n) {
+      for (int i = 0; i < n; ++i) {
+        if (section == "masses") {
+          ifs >> a >> r;
+          set_inv_mass(a, r);
+        } else if (section == "distances") {
+          ifs >> a >> b >> r >> k;
+          add_constraint(Constraint(a, b, r, k));
+        } else if (section == "ropes") {
+          ifs >> a >> b >> x >> y >> k;
+          add_constraint(RopeConstraint(a, b, x, y, k));
+        } else if (section == "angles") {
+          ifs >> a >> b >> c >> r >> k;
+          add_constraint(AngleConstraint(a, b, c, r, k));
+        } else if (section == "areas") {
+          ifs >> a >> b >> c >> r >> k;
+          add_constraint(AreaConstraint(a, b, c, r, k));
+        } else {
+          throw std::runtime_error("ParticleSystem::read('" + filename + "'): unknown section " + section);
+        }
+      }
     }
   }
 
@@ -42,12 +221,271 @@ const std::vector<glm::vec2>& ParticleSystem::particles() const
   return _positions;
 }
 
-void ParticleSystem::add_particle(const glm::vec2& position)
+size_t ParticleSystem::nb_particles() const
+{
+  return _nb_particles;
+}
+
+ParticleHandle ParticleSystem::add_particle(const glm::vec2& position, float inv_mass)
 {
+  const int slot = allocate_slot();
+  _internal_indices[slot] = (int)_nb_particles;
   _positions.push_back(position);
   _old_positions.push_back(position);
   _forces.push_back(_gravity);
+  _inv_masses.push_back(inv_mass);
+  _external_forces.push_back(glm::vec2(0, 0));
+  _external_indices.push_back(slot);
+  _degrees.push_back(0);
+  _island_parents.push_back((int)_nb_particles);
+  _island_sizes.push_back(1);
+  _island_calm_steps.push_back(0);
+  _island_asleep.push_back(0);
+  _island_energies.push_back(0);
+  // a free particle is an island of its own, listed as is
+  if (!_islands_dirty) {
+    const int i = (int)_nb_particles;
+    _islands.push_back(i);
+    _active_island_ranks.push_back(-1);
+    _active_ranks.push_back(-1);
+    activate(i);
+    if (_solver == JACOBI) {
+      _incidence_offsets.push_back(_incidence_offsets.back());
+      _previous_iterate.push_back(position);
+    }
+  }
+  _cells_x.push_back(0);
+  _cells_y.push_back(0);
+  update_cell((int)_nb_particles);
   ++_nb_particles;
+  return { slot, _generations[slot] };
+}
+
+void ParticleSystem::add_particles(const std::vector<glm::vec2>& positions, float inv_mass,
+                                   std::vector<ParticleHandle>& handles)
+{
+  for (const auto& p : positions) handles.push_back(add_particle(p, inv_mass));
+}
+
+void ParticleSystem::remove_particle(const ParticleHandle& handle)
+{
+  remove_particles(std::vector<ParticleHandle>(1, handle));
+}
+
+void ParticleSystem::remove_particles(const std::vector<ParticleHandle>& handles)
+{
+  std::vector<int> removed;
+  bool constrained = false;
+  for (const auto& h : handles) {
+    if (!is_alive(h)) continue;
+    const int i = _internal_indices[h.slot];
+    removed.push_back(i);
+    constrained |= (_degrees[i] > 0);
+    _internal_indices[h.slot] = -1;
+    ++_generations[h.slot];
+    _free_slots.push_back(h.slot);
+  }
+  if (removed.empty()) return;
+
+  // the particles moved into the holes come from the tail
+  for (size_t i = _nb_particles - removed.size(); i < _nb_particles; ++i) {
+    constrained |= (_degrees[i] > 0);
+  }
+  std::vector<int> old_slots;
+  if (constrained) old_slots = _external_indices;
+
+  // without constraints, no constrained particle moves: the active lists are
+  // patched and the packed constraints stay as they are
+  const bool listed = !constrained && !_islands_dirty;
+
+  // highest first, so that the last particle is never one left to remove
+  std::sort(removed.begin(), removed.end(), std::greater<int>());
+  for (const int i : removed) {
+    const int last = (int)_nb_particles - 1;
+    if (listed) deactivate(i);
+    if (i != last) {
+      move_particle(last, i);
+      if (listed) {
+        const int rank = _active_ranks[last];
+        _active_ranks[i] = rank;
+        _active_island_ranks[i] = _active_island_ranks[last];
+        if (rank >= 0) {
+          _active_particles[rank] = i;
+          _active_islands[_active_island_ranks[i]] = i;
+        }
+        if (_solver == JACOBI) _previous_iterate[i] = _previous_iterate[last];
+      }
+    }
+    if (listed) {
+      _islands.pop_back();
+      _active_ranks.pop_back();
+      _active_island_ranks.pop_back();
+      if (_solver == JACOBI) {
+        _incidence_offsets.pop_back();
+        _previous_iterate.pop_back();
+      }
+    }
+    pop_particle();
+  }
+
+  if (constrained) {
+    remap_constraints(old_slots);
+    rebuild_islands();
+  }
+}
+
+bool ParticleSystem::is_alive(const ParticleHandle& handle) const
+{
+  return handle.slot >= 0 && handle.slot < (int)_internal_indices.size() &&
+         _internal_indices[handle.slot] >= 0 && _generations[handle.slot] == handle.generation;
+}
+
+int ParticleSystem::internal_index(const ParticleHandle& handle) const
+{
+  return is_alive(handle) ? _internal_indices[handle.slot] : -1;
+}
+
+void ParticleSystem::reserve(size_t nb_particles)
+{
+  _positions.reserve(nb_particles);
+  _old_positions.reserve(nb_particles);
+  _forces.reserve(nb_particles);
+  _inv_masses.reserve(nb_particles);
+  _external_forces.reserve(nb_particles);
+  _cells_x.reserve(nb_particles);
+  _cells_y.reserve(nb_particles);
+  _internal_indices.reserve(nb_particles);
+  _external_indices.reserve(nb_particles);
+  _generations.reserve(nb_particles);
+  _free_slots.reserve(nb_particles);
+  _degrees.reserve(nb_particles);
+  _island_parents.reserve(nb_particles);
+  _islands.reserve(nb_particles);
+  _island_sizes.reserve(nb_particles);
+  _island_calm_steps.reserve(nb_particles);
+  _island_asleep.reserve(nb_particles);
+  _island_energies.reserve(nb_particles);
+  _active_islands.reserve(nb_particles);
+  _active_particles.reserve(nb_particles);
+  _active_island_ranks.reserve(nb_particles);
+  _active_ranks.reserve(nb_particles);
+}
+
+int ParticleSystem::allocate_slot()
+{
+  if (!_free_slots.empty()) {
+    const int slot = _free_slots.back();
+    _free_slots.pop_back();
+    return slot;
+  }
+  const int slot = (int)_internal_indices.size();
+  _internal_indices.push_back(-1);
+  // generations outlive clear(), so that older handles stay stale
+  if (_generations.size() == (size_t)slot) _generations.push_back(0);
+  return slot;
+}
+
+// island data is only moved for unconstrained particles, the others get
+// their islands rebuilt
+void ParticleSystem::move_particle(int from, int to)
+{
+  _positions[to] = _positions[from];
+  _old_positions[to] = _old_positions[from];
+  _forces[to] = _forces[from];
+  _inv_masses[to] = _inv_masses[from];
+  _external_forces[to] = _external_forces[from];
+  _cells_x[to] = _cells_x[from];
+  _cells_y[to] = _cells_y[from];
+  _external_indices[to] = _external_indices[from];
+  _internal_indices[_external_indices[to]] = to;
+  _degrees[to] = _degrees[from];
+  _island_parents[to] = to;
+  _island_sizes[to] = _island_sizes[from];
+  _island_calm_steps[to] = _island_calm_steps[from];
+  _island_asleep[to] = _island_asleep[from];
+  _island_energies[to] = _island_energies[from];
+}
+
+void ParticleSystem::pop_particle()
+{
+  _positions.pop_back();
+  _old_positions.pop_back();
+  _forces.pop_back();
+  _inv_masses.pop_back();
+  _external_forces.pop_back();
+  _cells_x.pop_back();
+  _cells_y.pop_back();
+  _external_indices.pop_back();
+  _degrees.pop_back();
+  _island_parents.pop_back();
+  _island_sizes.pop_back();
+  _island_calm_steps.pop_back();
+  _island_asleep.pop_back();
+  _island_energies.pop_back();
+  --_nb_particles;
+}
+
+// old_slots[i] is the slot of the particle that was at index i; constraints
+// referencing a removed particle are dropped
+void ParticleSystem::remap_constraints(const std::vector<int>& old_slots)
+{
+  auto remap = [&] (int i) { return _internal_indices[old_slots[i]]; };
+  filter(_constraints, [&] (Constraint& c) {
+    c.first = remap(c.first);
+    c.second = remap(c.second);
+    return c.first >= 0 && c.second >= 0;
+  });
+  filter(_ropes, [&] (RopeConstraint& c) {
+    c.first = remap(c.first);
+    c.second = remap(c.second);
+    return c.first >= 0 && c.second >= 0;
+  });
+  filter(_angles, [&] (AngleConstraint& c) {
+    c.first = remap(c.first);
+    c.middle = remap(c.middle);
+    c.second = remap(c.second);
+    return c.first >= 0 && c.middle >= 0 && c.second >= 0;
+  });
+  filter(_areas, [&] (AreaConstraint& c) {
+    c.first = remap(c.first);
+    c.second = remap(c.second);
+    c.third = remap(c.third);
+    return c.first >= 0 && c.second >= 0 && c.third >= 0;
+  });
+  _rope_lambdas.resize(_ropes.size());
+  _angle_lambdas.resize(_angles.size());
+  _area_lambdas.resize(_areas.size());
+
+  std::fill(_degrees.begin(), _degrees.end(), 0);
+  for (const auto& c : _constraints) {
+    ++_degrees[c.first];
+    ++_degrees[c.second];
+  }
+  for (const auto& c : _ropes) {
+    ++_degrees[c.first];
+    ++_degrees[c.second];
+  }
+  for (const auto& c : _angles) {
+    ++_degrees[c.first];
+    ++_degrees[c.middle];
+    ++_degrees[c.second];
+  }
+  for (const auto& c : _areas) {
+    ++_degrees[c.first];
+    ++_degrees[c.second];
+    ++_degrees[c.third];
+  }
+}
+
+void ParticleSystem::set_inv_mass(int particle, float inv_mass)
+{
+  _inv_masses[_internal_indices[particle]] = inv_mass;
+  wake(particle);
+}
+
+const std::vector<float>& ParticleSystem::inv_masses() const
+{
+  return _inv_masses;
 }
 
 const std::vector<Constraint>& ParticleSystem::constraints() const
@@ -57,7 +495,326 @@ const std::vector<Constraint>& ParticleSystem::constraints() const
 
 void ParticleSystem::add_constraint(const Constraint& constraint)
 {
-  _constraints.push_back(constraint);
+  Constraint c = constraint;
+  c.first = _internal_indices[c.first];
+  c.second = _internal_indices[c.second];
+  _constraints.push_back(c);
+  ++_degrees[c.first];
+  ++_degrees[c.second];
+  _islands_dirty = true;
+  merge_islands(c.first, c.second);
+}
+
+const std::vector<RopeConstraint>& ParticleSystem::rope_constraints() const
+{
+  return _ropes;
+}
+
+void ParticleSystem::add_constraint(const RopeConstraint& constraint)
+{
+  RopeConstraint c = constraint;
+  c.first = _internal_indices[c.first];
+  c.second = _internal_indices[c.second];
+  _ropes.push_back(c);
+  _rope_lambdas.push_back(0);
+  ++_degrees[c.first];
+  ++_degrees[c.second];
+  _islands_dirty = true;
+  merge_islands(c.first, c.second);
+}
+
+const std::vector<AngleConstraint>& ParticleSystem::angle_constraints() const
+{
+  return _angles;
+}
+
+void ParticleSystem::add_constraint(const AngleConstraint& constraint)
+{
+  AngleConstraint c = constraint;
+  c.first = _internal_indices[c.first];
+  c.middle = _internal_indices[c.middle];
+  c.second = _internal_indices[c.second];
+  _angles.push_back(c);
+  _angle_lambdas.push_back(0);
+  ++_degrees[c.first];
+  ++_degrees[c.middle];
+  ++_degrees[c.second];
+  _islands_dirty = true;
+  merge_islands(c.first, c.middle);
+  merge_islands(c.middle, c.second);
+}
+
+const std::vector<AreaConstraint>& ParticleSystem::area_constraints() const
+{
+  return _areas;
+}
+
+void ParticleSystem::add_constraint(const AreaConstraint& constraint)
+{
+  AreaConstraint c = constraint;
+  c.first = _internal_indices[c.first];
+  c.second = _internal_indices[c.second];
+  c.third = _internal_indices[c.third];
+  _areas.push_back(c);
+  _area_lambdas.push_back(0);
+  ++_degrees[c.first];
+  ++_degrees[c.second];
+  ++_degrees[c.third];
+  _islands_dirty = true;
+  merge_islands(c.first, c.second);
+  merge_islands(c.second, c.third);
+}
+
+void ParticleSystem::add_force(int particle, const glm::vec2& force)
+{
+  _external_forces[_internal_indices[particle]] += force;
+  wake(particle);
+}
+
+void ParticleSystem::set_gravity(const glm::vec2& gravity)
+{
+  _gravity = gravity;
+  for (size_t i = 0; i < _nb_particles; ++i) {
+    if (_island_parents[i] == (int)i) wake_island((int)i);
+  }
+}
+
+const glm::vec2& ParticleSystem::gravity() const
+{
+  return _gravity;
+}
+
+void ParticleSystem::set_timestep(float timestep)
+{
+  _timestep = timestep;
+  // the packed constraints hold compliance / dt^2
+  _islands_dirty = true;
+}
+
+float ParticleSystem::timestep() const
+{
+  return _timestep;
+}
+
+const glm::vec2& ParticleSystem::box_min() const
+{
+  return _min;
+}
+
+const glm::vec2& ParticleSystem::box_max() const
+{
+  return _max;
+}
+
+void ParticleSystem::set_solver_iterations(int min_iterations, int max_iterations, float tolerance)
+{
+  _min_iterations = std::max(1, min_iterations);
+  _max_iterations = std::max(_min_iterations, max_iterations);
+  _tolerance = tolerance;
+}
+
+const SolverMetrics& ParticleSystem::metrics() const
+{
+  return _metrics;
+}
+
+void ParticleSystem::set_solver(Solver solver, float rho)
+{
+  _solver = solver;
+  _rho = rho;
+  _islands_dirty = true;
+}
+
+void ParticleSystem::set_sleep_threshold(float energy, int steps)
+{
+  _sleep_energy = energy;
+  _sleep_steps = steps;
+}
+
+void ParticleSystem::wake(int particle)
+{
+  wake_island(find_island(_internal_indices[particle]));
+}
+
+size_t ParticleSystem::nb_active_particles() const
+{
+  return _active_particles.size();
+}
+
+int ParticleSystem::internal_index(int particle) const
+{
+  return _internal_indices[particle];
+}
+
+int ParticleSystem::external_index(int index) const
+{
+  return _external_indices[index];
+}
+
+void ParticleSystem::reorder(Ordering ordering)
+{
+  if (ordering == CUTHILL_MCKEE) {
+    permute(cuthill_mckee_order());
+  } else {
+    permute(spatial_order(ordering));
+  }
+}
+
+// particles sorted along a Morton or Hilbert curve over their bounding square
+std::vector<int> ParticleSystem::spatial_order(Ordering ordering) const
+{
+  glm::vec2 lo(0, 0), hi(0, 0);
+  if (_nb_particles > 0) lo = hi = _positions[0];
+  for (const auto& p : _positions) {
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  const float extent = std::max(hi.x - lo.x, hi.y - lo.y);
+  const float scale = (extent > 0 ? 65535.0f / extent : 0.0f);
+
+  std::vector<uint32_t> keys(_nb_particles);
+  for (size_t i = 0; i < _nb_particles; ++i) {
+    const glm::vec2 q = (_positions[i] - lo) * scale;
+    const uint32_t x = (uint32_t)std::min(65535.0f, q.x);
+    const uint32_t y = (uint32_t)std::min(65535.0f, q.y);
+    keys[i] = (ordering == HILBERT ? hilbert_key(x, y) : morton_key(x, y));
+  }
+
+  std::vector<int> order(_nb_particles);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&keys] (int a, int b) { return keys[a] < keys[b]; });
+  return order;
+}
+
+// breadth-first from a lowest degree particle of each island, neighbours by
+// increasing degree, reversed at the end; this keeps the constraint graph's
+// bandwidth small so both ends of a constraint are close in memory
+std::vector<int> ParticleSystem::cuthill_mckee_order() const
+{
+  std::vector<std::pair<int, int>> edges;
+  for (const auto& c : _constraints) edges.push_back({ c.first, c.second });
+  for (const auto& c : _ropes) edges.push_back({ c.first, c.second });
+  for (const auto& c : _angles) {
+    edges.push_back({ c.first, c.middle });
+    edges.push_back({ c.middle, c.second });
+  }
+  for (const auto& c : _areas) {
+    edges.push_back({ c.first, c.second });
+    edges.push_back({ c.second, c.third });
+    edges.push_back({ c.third, c.first });
+  }
+
+  // adjacency in compressed rows
+  std::vector<int> offsets(_nb_particles + 1, 0);
+  for (const auto& e : edges) {
+    ++offsets[e.first + 1];
+    ++offsets[e.second + 1];
+  }
+  for (size_t i = 0; i < _nb_particles; ++i) offsets[i + 1] += offsets[i];
+  std::vector<int> neighbours(offsets.back());
+  std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+  for (const auto& e : edges) {
+    neighbours[fill[e.first]++] = e.second;
+    neighbours[fill[e.second]++] = e.first;
+  }
+  auto degree = [&offsets] (int i) { return offsets[i + 1] - offsets[i]; };
+  for (size_t i = 0; i < _nb_particles; ++i) {
+    std::sort(neighbours.begin() + offsets[i], neighbours.begin() + offsets[i + 1], [&degree] (int a, int b) {
+      return degree(a) < degree(b) || (degree(a) == degree(b) && a < b);
+    });
+  }
+
+  std::vector<int> starts(_nb_particles);
+  std::iota(starts.begin(), starts.end(), 0);
+  std::stable_sort(starts.begin(), starts.end(), [&degree] (int a, int b) { return degree(a) < degree(b); });
+
+  std::vector<int> order;
+  order.reserve(_nb_particles);
+  std::vector<char> visited(_nb_particles, 0);
+  for (const int start : starts) {
+    if (visited[start]) continue;
+    visited[start] = 1;
+    order.push_back(start);
+    for (size_t head = order.size() - 1; head < order.size(); ++head) {
+      const int i = order[head];
+      for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+        const int j = neighbours[k];
+        if (visited[j]) continue;
+        visited[j] = 1;
+        order.push_back(j);
+      }
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// order[new index] = old index
+void ParticleSystem::permute(const std::vector<int>& order)
+{
+  std::vector<int> ranks(_nb_particles);
+  for (size_t i = 0; i < _nb_particles; ++i) ranks[order[i]] = (int)i;
+
+  gather(_positions, order);
+  gather(_old_positions, order);
+  gather(_forces, order);
+  gather(_inv_masses, order);
+  gather(_external_forces, order);
+  gather(_cells_x, order);
+  gather(_cells_y, order);
+  gather(_external_indices, order);
+  gather(_degrees, order);
+  for (size_t i = 0; i < _nb_particles; ++i) _internal_indices[_external_indices[i]] = (int)i;
+
+  for (auto& c : _constraints) {
+    c.first = ranks[c.first];
+    c.second = ranks[c.second];
+    if (c.first > c.second) std::swap(c.first, c.second);
+  }
+  for (auto& c : _ropes) {
+    c.first = ranks[c.first];
+    c.second = ranks[c.second];
+    if (c.first > c.second) std::swap(c.first, c.second);
+  }
+  for (auto& c : _angles) {
+    c.first = ranks[c.first];
+    c.middle = ranks[c.middle];
+    c.second = ranks[c.second];
+  }
+  for (auto& c : _areas) {
+    c.first = ranks[c.first];
+    c.second = ranks[c.second];
+    c.third = ranks[c.third];
+  }
+  sort_by_particle(_constraints);
+  sort_by_particle(_ropes);
+  sort_by_particle(_angles);
+  sort_by_particle(_areas);
+
+  rebuild_islands();
+}
+
+// union-find from scratch over all constraints, every island awake
+void ParticleSystem::rebuild_islands()
+{
+  for (size_t i = 0; i < _nb_particles; ++i) {
+    _island_parents[i] = (int)i;
+    _island_sizes[i] = 1;
+    _island_calm_steps[i] = 0;
+    _island_asleep[i] = 0;
+    _island_energies[i] = 0;
+  }
+  for (const auto& c : _constraints) merge_islands(c.first, c.second);
+  for (const auto& c : _ropes) merge_islands(c.first, c.second);
+  for (const auto& c : _angles) {
+    merge_islands(c.first, c.middle);
+    merge_islands(c.middle, c.second);
+  }
+  for (const auto& c : _areas) {
+    merge_islands(c.first, c.second);
+    merge_islands(c.second, c.third);
+  }
+  _islands_dirty = true;
 }
 
 void ParticleSystem::clear()
@@ -65,20 +822,360 @@ void ParticleSystem::clear()
   _positions.clear();
   _old_positions.clear();
   _forces.clear();
+  _inv_masses.clear();
   _constraints.clear();
+  _packed_constraints.clear();
+  _lambdas.clear();
+  _ropes.clear();
+  _rope_lambdas.clear();
+  _angles.clear();
+  _angle_lambdas.clear();
+  _areas.clear();
+  _area_lambdas.clear();
+  _external_forces.clear();
+  _internal_indices.clear();
+  _external_indices.clear();
+  _free_slots.clear();
+  _degrees.clear();
+  for (auto& g : _generations) ++g;
+  _island_parents.clear();
+  _islands.clear();
+  _island_sizes.clear();
+  _island_calm_steps.clear();
+  _island_asleep.clear();
+  _island_energies.clear();
+  _islands_dirty = true;
+  _cells_x.clear();
+  _cells_y.clear();
   _nb_particles = 0;
 }
 
+int ParticleSystem::find_island(int particle)
+{
+  while (_island_parents[particle] != particle) {
+    _island_parents[particle] = _island_parents[_island_parents[particle]];
+    particle = _island_parents[particle];
+  }
+  return particle;
+}
+
+void ParticleSystem::merge_islands(int a, int b)
+{
+  a = find_island(a);
+  b = find_island(b);
+  if (a != b) {
+    if (_island_sizes[a] < _island_sizes[b]) std::swap(a, b);
+    _island_parents[b] = a;
+    _island_sizes[a] += _island_sizes[b];
+    _islands_dirty = true;
+  }
+  wake_island(a);
+}
+
+void ParticleSystem::wake_island(int root)
+{
+  _island_calm_steps[root] = 0;
+  if (_island_asleep[root]) {
+    _island_asleep[root] = 0;
+    if (!_islands_dirty && _degrees[root] == 0) {
+      activate(root);
+    } else {
+      _islands_dirty = true;
+    }
+  }
+}
+
+void ParticleSystem::update_islands()
+{
+  _islands.resize(_nb_particles);
+  _active_islands.clear();
+  _active_particles.clear();
+  _active_island_ranks.assign(_nb_particles, -1);
+  _active_ranks.assign(_nb_particles, -1);
+  for (size_t i = 0; i < _nb_particles; ++i) {
+    const int root = find_island((int)i);
+    _islands[i] = root;
+    if (_island_asleep[root]) continue;
+    _active_ranks[i] = (int)_active_particles.size();
+    _active_particles.push_back((int)i);
+    if (root == (int)i) {
+      _active_island_ranks[i] = (int)_active_islands.size();
+      _active_islands.push_back(root);
+    }
+  }
+
+  const float dt2 = _timestep * _timestep;
+  _packed_constraints.clear();
+  for (const Constraint& c : _constraints) {
+    if (_island_asleep[_islands[c.first]]) continue;
+    _packed_constraints.push_back({ (uint32_t)c.first, (uint32_t)c.second, c.rest_length, c.compliance / dt2 });
+  }
+  interleave(_packed_constraints);
+  _lambdas.resize(_packed_constraints.size());
+  _active_ropes.clear();
+  for (size_t k = 0; k < _ropes.size(); ++k) {
+    if (!_island_asleep[_islands[_ropes[k].first]]) _active_ropes.push_back((int)k);
+  }
+  _active_angles.clear();
+  for (size_t k = 0; k < _angles.size(); ++k) {
+    if (!_island_asleep[_islands[_angles[k].first]]) _active_angles.push_back((int)k);
+  }
+  _active_areas.clear();
+  for (size_t k = 0; k < _areas.size(); ++k) {
+    if (!_island_asleep[_islands[_areas[k].first]]) _active_areas.push_back((int)k);
+  }
+
+  if (_solver == JACOBI) update_incidences();
+  _islands_dirty = false;
+}
+
+// a free particle joins or leaves the active lists, as its own island
+void ParticleSystem::activate(int particle)
+{
+  _active_ranks[particle] = (int)_active_particles.size();
+  _active_particles.push_back(particle);
+  _active_island_ranks[particle] = (int)_active_islands.size();
+  _active_islands.push_back(particle);
+}
+
+void ParticleSystem::deactivate(int particle)
+{
+  const int rank = _active_ranks[particle];
+  if (rank < 0) return;
+  _active_ranks[_active_particles.back()] = rank;
+  _active_particles[rank] = _active_particles.back();
+  _active_particles.pop_back();
+  const int island_rank = _active_island_ranks[particle];
+  _active_island_ranks[_active_islands.back()] = island_rank;
+  _active_islands[island_rank] = _active_islands.back();
+  _active_islands.pop_back();
+  _active_ranks[particle] = -1;
+  _active_island_ranks[particle] = -1;
+}
+
+// for each particle, the corrections of the packed constraints it is part of:
+// 2k for the first end of constraint k, 2k + 1 for the second
+void ParticleSystem::update_incidences()
+{
+  _incidence_offsets.assign(_nb_particles + 1, 0);
+  for (const auto& c : _packed_constraints) {
+    ++_incidence_offsets[c.first + 1];
+    ++_incidence_offsets[c.second + 1];
+  }
+  for (size_t i = 0; i < _nb_particles; ++i) _incidence_offsets[i + 1] += _incidence_offsets[i];
+  _incidences.resize(_incidence_offsets.back());
+  std::vector<int> fill(_incidence_offsets.begin(), _incidence_offsets.end() - 1);
+  for (size_t k = 0; k < _packed_constraints.size(); ++k) {
+    _incidences[fill[_packed_constraints[k].first]++] = (int)(2 * k);
+    _incidences[fill[_packed_constraints[k].second]++] = (int)(2 * k + 1);
+  }
+  _corrections.resize(2 * _packed_constraints.size());
+  _previous_iterate.resize(_nb_particles);
+}
+
+void ParticleSystem::update_sleep()
+{
+  const float dt2 = _timestep * _timestep;
+  // the byte stores of the cells may alias anything, keep the rest in locals
+  const glm::vec2* positions = _positions.data();
+  glm::vec2* old_positions = _old_positions.data();
+  const float* inv_masses = _inv_masses.data();
+  const int* islands = _islands.data();
+  float* island_energies = _island_energies.data();
+  uint8_t* cells_x = _cells_x.data();
+  uint8_t* cells_y = _cells_y.data();
+  const glm::vec2 min = _min;
+  const glm::vec2 cells_per_unit = _cells_per_unit;
+  const glm::vec2 gravity = _gravity;
+  float kinetic_energy = 0;
+  float potential_energy = 0;
+  for (const int i : _active_particles) {
+    const glm::vec2 p = positions[i];
+    const glm::vec2 c = (p - min) * cells_per_unit;
+    cells_x[i] = (uint8_t)pick_cell(c.x);
+    cells_y[i] = (uint8_t)pick_cell(c.y);
+    const float w = inv_masses[i];
+    if (w == 0) {
+      // pinned particles only move when the box clamps them, count it once
+      old_positions[i] = p;
+      continue;
+    }
+    const glm::vec2 v = p - old_positions[i];
+    const float energy = 0.5f * glm::dot(v, v) / (w * dt2);
+    island_energies[islands[i]] += energy;
+    kinetic_energy += energy;
+    potential_energy -= glm::dot(gravity, p) / w;
+  }
+  _metrics.kinetic_energy = kinetic_energy;
+  _metrics.potential_energy = potential_energy;
+  // free particles that fall asleep leave the lists by themselves, unless
+  // they are rebuilt anyway
+  bool asleep = false;
+  std::vector<int> free_sleepers;
+  for (const int root : _active_islands) {
+    if (_island_energies[root] < _sleep_energy * _island_sizes[root]) {
+      ++_island_calm_steps[root];
+    } else {
+      _island_calm_steps[root] = 0;
+    }
+    if (_island_calm_steps[root] >= _sleep_steps) {
+      _island_asleep[root] = 1;
+      if (_degrees[root] == 0 && !_islands_dirty) {
+        free_sleepers.push_back(root);
+      } else {
+        asleep = true;
+      }
+    }
+    _island_energies[root] = 0;
+  }
+
+  // drop residual velocities so that woken islands start at rest
+  if (asleep) {
+    for (const int i : _active_particles) {
+      if (_island_asleep[_islands[i]]) _old_positions[i] = _positions[i];
+    }
+    _islands_dirty = true;
+  } else {
+    for (const int i : free_sleepers) {
+      _old_positions[i] = _positions[i];
+      deactivate(i);
+    }
+  }
+}
+
+ParticleHandle ParticleSystem::pick(const glm::vec2& position, float radius) const
+{
+  const size_t nb_chunks = _pool->nb_chunks(_nb_particles, 1 << 16);
+  std::vector<int> nearest(nb_chunks, -1);
+  _pool->parallel_for(_nb_particles, nb_chunks, [&] (size_t chunk, size_t begin, size_t end) {
+    float best = radius * radius;
+    scan_cells(begin, end, position, best, nearest[chunk]);
+  });
+  // the lowest index on ties
+  int i = -1;
+  float best = radius * radius;
+  for (const int k : nearest) {
+    if (k < 0) continue;
+    const glm::vec2 d = _positions[k] - position;
+    if (glm::dot(d, d) < best || (glm::dot(d, d) == best && i < 0)) {
+      best = glm::dot(d, d);
+      i = k;
+    }
+  }
+
+  if (i < 0) return { -1, 0 };
+  const int slot = _external_indices[i];
+  return { slot, _generations[slot] };
+}
+
+void ParticleSystem::update_cell(int particle)
+{
+  const glm::vec2 c = (_positions[particle] - _min) * _cells_per_unit;
+  _cells_x[particle] = (uint8_t)pick_cell(c.x);
+  _cells_y[particle] = (uint8_t)pick_cell(c.y);
+}
+
+// The first particle of [begin, end) nearer to position than sqrt(best), or
+// as near if there is none yet. Only the particles whose cell is in the
+// square of cells around that disk, and not further than the disk from the
+// cell of position, are read; the square shrinks with best. Cells are
+// computed as update_cell() does, with operations that keep the order of
+// their arguments: the reach only grows by a few ulps for the rounding of
+// its ends and of the distances.
+void ParticleSystem::scan_cells(size_t begin, size_t end, const glm::vec2& position, float& best, int& nearest) const
+{
+  const glm::vec2 cell_size = 1.0f / _cells_per_unit;
+  const int center_x = pick_cell((position.x - _min.x) * _cells_per_unit.x);
+  const int center_y = pick_cell((position.y - _min.y) * _cells_per_unit.y);
+  int lo[2], hi[2];
+  bool shrunk = true;
+  auto bound = [&] () {
+    for (int axis = 0; axis < 2; ++axis) {
+      const float reach = std::sqrt(best) * 1.00001f + 1e-6f * std::fabs(position[axis]);
+      lo[axis] = pick_cell((position[axis] - reach - _min[axis]) * _cells_per_unit[axis]);
+      hi[axis] = pick_cell((position[axis] + reach - _min[axis]) * _cells_per_unit[axis]);
+    }
+    shrunk = true;
+  };
+  auto visit = [&] (size_t k) {
+    // cells between the one of position and this one are all crossed
+    const glm::vec2 gap(std::max(0, std::abs(_cells_x[k] - center_x) - 1) * cell_size.x,
+                        std::max(0, std::abs(_cells_y[k] - center_y) - 1) * cell_size.y);
+    if (glm::dot(gap, gap) > best * 1.0001f) return;
+    const glm::vec2 d = _positions[k] - position;
+    if (glm::dot(d, d) < best || (glm::dot(d, d) == best && nearest < 0)) {
+      best = glm::dot(d, d);
+      nearest = (int)k;
+      bound();
+    }
+  };
+  bound();
+
+  size_t k = begin;
+#ifdef PARTICLE_SSE2
+  // lo <= c <= hi as c - lo <= hi - lo on unsigned bytes, with wrapping
+  __m128i lo_x = _mm_setzero_si128(), lo_y = lo_x, width_x = lo_x, width_y = lo_x;
+  for (; k + 16 <= end; k += 16) {
+    if (shrunk) {
+      lo_x = _mm_set1_epi8((char)lo[0]);
+      lo_y = _mm_set1_epi8((char)lo[1]);
+      width_x = _mm_set1_epi8((char)(hi[0] - lo[0]));
+      width_y = _mm_set1_epi8((char)(hi[1] - lo[1]));
+      shrunk = false;
+    }
+    const __m128i x = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)&_cells_x[k]), lo_x);
+    const __m128i y = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)&_cells_y[k]), lo_y);
+    const __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_min_epu8(x, width_x), x),
+                                     _mm_cmpeq_epi8(_mm_min_epu8(y, width_y), y));
+    for (int mask = _mm_movemask_epi8(in), j = 0; mask != 0; mask >>= 1, ++j) {
+      if (mask & 1) visit(k + j);
+    }
+  }
+#endif
+  for (; k < end; ++k) {
+    if (_cells_x[k] >= lo[0] && _cells_x[k] <= hi[0] && _cells_y[k] >= lo[1] && _cells_y[k] <= hi[1]) visit(k);
+  }
+}
+
+void ParticleSystem::grab(const ParticleHandle& handle, const glm::vec2& target, float compliance)
+{
+  _grabbed = handle;
+  _grab_compliance = compliance;
+  drag(target);
+}
+
+void ParticleSystem::drag(const glm::vec2& target)
+{
+  _grab_target = target;
+  if (is_alive(_grabbed)) wake(_grabbed.slot);
+}
+
+void ParticleSystem::release()
+{
+  _grabbed = { -1, 0 };
+}
+
+const ParticleHandle& ParticleSystem::grabbed() const
+{
+  return _grabbed;
+}
+
 void ParticleSystem::step()
 {
+  const auto start = std::chrono::steady_clock::now();
+  if (is_alive(_grabbed)) wake(_grabbed.slot);
+  if (_islands_dirty) update_islands();
   accumulate_forces();
   verlet_integration();
   satisfy_constraints();
+  update_sleep();
+  _metrics.step_time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
 }
 
 void ParticleSystem::verlet_integration()
 {
-  for (size_t i = 0; i < _nb_particles; ++i) {
+  for (const int i : _active_particles) {
+    if (_inv_masses[i] == 0) continue;
     glm::vec2& pos = _positions[i];
     glm::vec2& old_pos = _old_positions[i];
     glm::vec2& acc = _forces[i];
@@ -90,29 +1187,241 @@ void ParticleSystem::verlet_integration()
 
 void ParticleSystem::satisfy_constraints()
 {
-  for (int iter = 0; iter < 3; ++iter) {
+  // XPBD multipliers accumulate over the iterations of a single step
+  std::fill(_lambdas.begin(), _lambdas.end(), 0.0f);
+  std::fill(_rope_lambdas.begin(), _rope_lambdas.end(), 0.0f);
+  std::fill(_angle_lambdas.begin(), _angle_lambdas.end(), 0.0f);
+  std::fill(_area_lambdas.begin(), _area_lambdas.end(), 0.0f);
+  _grab_lambda = 0;
+
+  float omega = 1;
+  int iter = 0;
+  while (iter < _max_iterations) {
     // stay inside the box
-    for (size_t i = 0; i < _nb_particles; ++i) {
+    for (const int i : _active_particles) {
       glm::vec2& pos = _positions[i];
       pos.x = std::max(_min.x, std::min(_max.x, pos.x));
       pos.y = std::max(_min.y, std::min(_max.y, pos.y));
     }
 
     // relax constraints
-    for (const auto& c : _constraints) {
+    _residuals = Residuals();
+    if (_solver == JACOBI) {
+      // Chebyshev weights, 1 then 2 / (2 - rho^2) then 4 / (4 - rho^2 omega)
+      const float rho2 = _rho * _rho;
+      omega = (iter == 0 ? 1.0f : iter == 1 ? 2.0f / (2.0f - rho2) : 4.0f / (4.0f - rho2 * omega));
+      solve_distance_constraints_jacobi(omega);
+    } else {
+      solve_distance_constraints();
+    }
+    solve_rope_constraints();
+    solve_angle_constraints();
+    solve_area_constraints();
+    solve_grab_constraint();
+
+    ++iter;
+    if (iter >= _min_iterations && _residuals.max <= _tolerance) break;
+  }
+
+  _metrics.iterations = iter;
+  _metrics.max_residual = _residuals.max;
+  _metrics.rms_residual = (_residuals.count > 0 ? (float)std::sqrt(_residuals.sum / _residuals.count) : 0.0f);
+}
+
+void ParticleSystem::solve_distance_constraints()
+{
+  Residuals residuals = _residuals;
+  for (size_t k = 0; k < _packed_constraints.size(); ++k) {
+    const PackedConstraint& c = _packed_constraints[k];
+    const float w1 = _inv_masses[c.first];
+    const float w2 = _inv_masses[c.second];
+    const float alpha = c.alpha;
+    if (w1 + w2 + alpha == 0) continue;
+
+    const glm::vec2 d = _positions[c.second] - _positions[c.first];
+    const float len = glm::length(d);
+    residuals.add(std::fabs(len - c.rest_length) / (c.rest_length > 0 ? c.rest_length : 1.0f));
+    // clamp the relative stretch so that large deformations stay stable
+    float diff = (len - c.rest_length) / (len + 0.001f);
+    diff = (diff < 0 ? std::max(diff, -c.rest_length / 10.0f) : std::min(diff, c.rest_length / 10.0f));
+
+    const float dl = (-diff * len - alpha * _lambdas[k]) / (w1 + w2 + alpha);
+    _lambdas[k] += dl;
+    const glm::vec2 n = d / (len + 0.001f);
+    _positions[c.first] -= w1 * dl * n;
+    _positions[c.second] += w2 * dl * n;
+  }
+  _residuals = residuals;
+}
+
+void ParticleSystem::solve_distance_constraints_jacobi(float omega)
+{
+  // every constraint writes its own two corrections
+  const size_t nb_constraints = _packed_constraints.size();
+  const size_t nb_constraint_chunks = _pool->nb_chunks(nb_constraints, 4096);
+  _chunk_residuals.assign(nb_constraint_chunks, Residuals());
+  _pool->parallel_for(nb_constraints, nb_constraint_chunks, [this] (size_t chunk, size_t begin, size_t end) {
+    Residuals residuals = Residuals();
+    for (size_t k = begin; k < end; ++k) {
+      const PackedConstraint& c = _packed_constraints[k];
+      const float w1 = _inv_masses[c.first];
+      const float w2 = _inv_masses[c.second];
+      const float alpha = c.alpha;
+      _corrections[2 * k] = _corrections[2 * k + 1] = glm::vec2(0, 0);
+      if (w1 + w2 + alpha == 0) continue;
+
       const glm::vec2 d = _positions[c.second] - _positions[c.first];
       const float len = glm::length(d);
+      residuals.add(std::fabs(len - c.rest_length) / (c.rest_length > 0 ? c.rest_length : 1.0f));
       float diff = (len - c.rest_length) / (len + 0.001f);
       diff = (diff < 0 ? std::max(diff, -c.rest_length / 10.0f) : std::min(diff, c.rest_length / 10.0f));
-      _positions[c.first] += 0.5f * diff * d;
-      _positions[c.second] -= 0.5f * diff * d;
+
+      const float dl = (-diff * len - alpha * _lambdas[k]) / (w1 + w2 + alpha);
+      _lambdas[k] += dl;
+      const glm::vec2 n = d / (len + 0.001f);
+      _corrections[2 * k] = -w1 * dl * n;
+      _corrections[2 * k + 1] = w2 * dl * n;
+    }
+    _chunk_residuals[chunk] = residuals;
+  });
+  for (const auto& r : _chunk_residuals) _residuals.merge(r);
+
+  // every particle reads its own corrections
+  const size_t nb_particles = _active_particles.size();
+  _pool->parallel_for(nb_particles, _pool->nb_chunks(nb_particles, 4096), [this, omega] (size_t, size_t begin, size_t end) {
+    for (size_t a = begin; a < end; ++a) {
+      const int i = _active_particles[a];
+      const int first = _incidence_offsets[i];
+      const int last = _incidence_offsets[i + 1];
+      if (first == last || _inv_masses[i] == 0) continue;
+
+      glm::vec2 delta(0, 0);
+      for (int r = first; r < last; ++r) delta += _corrections[_incidences[r]];
+      const glm::vec2 target = _positions[i] + delta / (float)(last - first);
+      const glm::vec2 previous = _previous_iterate[i];
+      _previous_iterate[i] = _positions[i];
+      _positions[i] = omega * (target - previous) + previous;
     }
+  });
+}
+
+void ParticleSystem::solve_rope_constraints()
+{
+  Residuals residuals = _residuals;
+  const float dt2 = _timestep * _timestep;
+  for (const int k : _active_ropes) {
+    const RopeConstraint& c = _ropes[k];
+    const float w1 = _inv_masses[c.first];
+    const float w2 = _inv_masses[c.second];
+    const float alpha = c.compliance / dt2;
+    if (w1 + w2 + alpha == 0) continue;
+
+    const glm::vec2 d = _positions[c.second] - _positions[c.first];
+    const float len = glm::length(d);
+    float C = 0;
+    if (len < c.min_length) C = len - c.min_length;
+    else if (len > c.max_length) C = len - c.max_length;
+    else continue;
+    residuals.add(std::fabs(C) / (c.max_length > 0 ? c.max_length : 1.0f));
+
+    const float dl = (-C - alpha * _rope_lambdas[k]) / (w1 + w2 + alpha);
+    _rope_lambdas[k] += dl;
+    const glm::vec2 n = d / (len + 0.001f);
+    _positions[c.first] -= w1 * dl * n;
+    _positions[c.second] += w2 * dl * n;
   }
+  _residuals = residuals;
+}
+
+void ParticleSystem::solve_angle_constraints()
+{
+  Residuals residuals = _residuals;
+  const float dt2 = _timestep * _timestep;
+  for (const int k : _active_angles) {
+    const AngleConstraint& c = _angles[k];
+    const float w0 = _inv_masses[c.first];
+    const float w1 = _inv_masses[c.middle];
+    const float w2 = _inv_masses[c.second];
+    const float alpha = c.compliance / dt2;
+
+    const glm::vec2 u = _positions[c.first] - _positions[c.middle];
+    const glm::vec2 v = _positions[c.second] - _positions[c.middle];
+    const float uu = glm::dot(u, u);
+    const float vv = glm::dot(v, v);
+    if (uu == 0 || vv == 0) continue;
+
+    float C = std::atan2(cross2D(u, v), glm::dot(u, v)) - c.rest_angle;
+    if (C > PI) C -= 2 * PI;
+    if (C < -PI) C += 2 * PI;
+    residuals.add(std::fabs(C));
+
+    const glm::vec2 g0(u.y / uu, -u.x / uu);
+    const glm::vec2 g2(-v.y / vv, v.x / vv);
+    const glm::vec2 g1 = -(g0 + g2);
+    const float denom = w0 * glm::dot(g0, g0) + w1 * glm::dot(g1, g1) + w2 * glm::dot(g2, g2) + alpha;
+    if (denom == 0) continue;
+
+    const float dl = (-C - alpha * _angle_lambdas[k]) / denom;
+    _angle_lambdas[k] += dl;
+    _positions[c.first] += w0 * dl * g0;
+    _positions[c.middle] += w1 * dl * g1;
+    _positions[c.second] += w2 * dl * g2;
+  }
+  _residuals = residuals;
+}
+
+void ParticleSystem::solve_area_constraints()
+{
+  Residuals residuals = _residuals;
+  const float dt2 = _timestep * _timestep;
+  for (const int k : _active_areas) {
+    const AreaConstraint& c = _areas[k];
+    const float w0 = _inv_masses[c.first];
+    const float w1 = _inv_masses[c.second];
+    const float w2 = _inv_masses[c.third];
+    const float alpha = c.compliance / dt2;
+
+    const glm::vec2& p0 = _positions[c.first];
+    const glm::vec2& p1 = _positions[c.second];
+    const glm::vec2& p2 = _positions[c.third];
+    const float C = 0.5f * cross2D(p1 - p0, p2 - p0) - c.rest_area;
+    residuals.add(std::fabs(C) / (c.rest_area != 0 ? std::fabs(c.rest_area) : 1.0f));
+
+    const glm::vec2 g0(0.5f * (p1.y - p2.y), 0.5f * (p2.x - p1.x));
+    const glm::vec2 g1(0.5f * (p2.y - p0.y), 0.5f * (p0.x - p2.x));
+    const glm::vec2 g2(0.5f * (p0.y - p1.y), 0.5f * (p1.x - p0.x));
+    const float denom = w0 * glm::dot(g0, g0) + w1 * glm::dot(g1, g1) + w2 * glm::dot(g2, g2) + alpha;
+    if (denom == 0) continue;
+
+    const float dl = (-C - alpha * _area_lambdas[k]) / denom;
+    _area_lambdas[k] += dl;
+    _positions[c.first] += w0 * dl * g0;
+    _positions[c.second] += w1 * dl * g1;
+    _positions[c.third] += w2 * dl * g2;
+  }
+  _residuals = residuals;
+}
+
+// not part of the residuals, it is meant to lag behind a moving target
+void ParticleSystem::solve_grab_constraint()
+{
+  const int i = internal_index(_grabbed);
+  if (i < 0) return;
+  const float w = _inv_masses[i];
+  const float alpha = _grab_compliance / (_timestep * _timestep);
+  const glm::vec2 d = _grab_target - _positions[i];
+  const float len = glm::length(d);
+  if (w + alpha == 0 || len == 0) return;
+
+  const float dl = (len - alpha * _grab_lambda) / (w + alpha);
+  _grab_lambda += dl;
+  _positions[i] += w * dl * d / len;
 }
 
 void ParticleSystem::accumulate_forces()
 {
-  for (size_t i = 0; i < _nb_particles; ++i) {
-    _forces[i] = _gravity;
+  for (const int i : _active_particles) {
+    _forces[i] = _gravity + _external_forces[i];
+    _external_forces[i] = glm::vec2(0, 0);
   }
 }
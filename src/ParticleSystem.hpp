@@ -1,43 +1,326 @@
 #pragma once
+#include "ThreadPool.hpp"
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
 #include <vector>
 
+// Keeps |p[second] - p[first]| == rest_length.
 struct Constraint
 {
-  Constraint(int f, int s, float l);
+  Constraint(int f, int s, float l, float c = 0);
 
   int first;
   int second;
   float rest_length;
+  float compliance;
+};
+
+// Keeps min_length <= |p[second] - p[first]| <= max_length.
+struct RopeConstraint
+{
+  RopeConstraint(int f, int s, float min, float max, float c = 0);
+
+  int first;
+  int second;
+  float min_length;
+  float max_length;
+  float compliance;
+};
+
+// Keeps the signed angle (p[first] - p[middle], p[second] - p[middle]) == rest_angle.
+struct AngleConstraint
+{
+  AngleConstraint(int f, int m, int s, float a, float c = 0);
+
+  int first;
+  int middle;
+  int second;
+  float rest_angle;
+  float compliance;
+};
+
+// Keeps the signed area of the triangle (p[first], p[second], p[third]) == rest_area.
+struct AreaConstraint
+{
+  AreaConstraint(int f, int s, int t, float a, float c = 0);
+
+  int first;
+  int second;
+  int third;
+  float rest_area;
+  float compliance;
+};
+
+// What the last step() did. Residuals are relative constraint errors, as
+// |len - rest_length| / rest_length for distances, measured while relaxing
+// during the last iteration; NaN means the simulation diverged. Energies are
+// those of the awake particles. The step time is in seconds.
+struct SolverMetrics
+{
+  float step_time;
+  int iterations;
+  float max_residual;
+  float rms_residual;
+  float kinetic_energy;
+  float potential_energy;
+};
+
+// Refers to a particle for as long as it lives, whatever its index becomes.
+// slot is the index the rest of the API takes; a slot is reused once its
+// particle is removed, with a new generation.
+struct ParticleHandle
+{
+  int slot;
+  uint32_t generation;
 };
 
 class ParticleSystem
 {
 public:
-  ParticleSystem(const glm::vec2& min, const glm::vec2& max);
+  enum Ordering { MORTON, HILBERT, CUTHILL_MCKEE };
+  enum Solver { GAUSS_SEIDEL, JACOBI };
+
+public:
+  ParticleSystem(const glm::vec2& min, const glm::vec2& max, ThreadPool& pool = ThreadPool::global());
 
   void read(const std::string& filename);
   void step();
 
-  void add_particle(const glm::vec2& position);
+  // inv_mass == 0 pins the particle in place
+  ParticleHandle add_particle(const glm::vec2& position, float inv_mass = 1.0f);
   const std::vector<glm::vec2>& particles() const;
+  size_t nb_particles() const;
+  void set_inv_mass(int particle, float inv_mass);
+  const std::vector<float>& inv_masses() const;
 
   void add_constraint(const Constraint& constraint);
   const std::vector<Constraint>& constraints() const;
 
+  void add_constraint(const RopeConstraint& constraint);
+  const std::vector<RopeConstraint>& rope_constraints() const;
+
+  void add_constraint(const AngleConstraint& constraint);
+  const std::vector<AngleConstraint>& angle_constraints() const;
+
+  void add_constraint(const AreaConstraint& constraint);
+  const std::vector<AreaConstraint>& area_constraints() const;
+
+  // external forces last for one step and wake the particle's island
+  void add_force(int particle, const glm::vec2& force);
+  void set_gravity(const glm::vec2& gravity);
+  const glm::vec2& gravity() const;
+  void set_timestep(float timestep);
+  float timestep() const;
+
+  // particles are kept inside the box [box_min, box_max]
+  const glm::vec2& box_min() const;
+  const glm::vec2& box_max() const;
+
+  // an island (connected component of the constraint graph) falls asleep when
+  // its mean kinetic energy per particle stays under energy for steps steps
+  void set_sleep_threshold(float energy, int steps);
+
+  // relaxation runs between min and max iterations per step, and stops once
+  // the max residual is under tolerance
+  void set_solver_iterations(int min_iterations, int max_iterations, float tolerance = 0.0f);
+  const SolverMetrics& metrics() const;
+
+  // Gauss-Seidel relaxes the constraints one after the other, in place.
+  // Jacobi computes the corrections of all distance constraints from the same
+  // positions, then moves each particle by the average of its corrections,
+  // both passes in parallel; rho > 0 adds Chebyshev acceleration for that
+  // estimate of the spectral radius (0.9 to 0.99 for cloth). Other constraint
+  // types are relaxed Gauss-Seidel in both modes.
+  void set_solver(Solver solver, float rho = 0.0f);
+
+  void wake(int particle);
+  size_t nb_active_particles() const;
+
+  // Renumbers the particles for locality, along a space-filling curve or by
+  // reverse Cuthill-McKee over the constraint graph, and sorts the constraints
+  // by particle. The API keeps taking particle slots, see ParticleHandle;
+  // particles(), inv_masses() and the constraint arrays use the new order.
+  void reorder(Ordering ordering);
+  int internal_index(int particle) const;
+  int external_index(int index) const;
+
+  // Particles are removed by moving the last one into their place, along with
+  // the constraints that reference them. Unconstrained particles, as emitters
+  // create, are added and removed in O(1) each, without touching the islands
+  // or constraints of the others; otherwise the constraints are remapped in
+  // one pass and the islands are rebuilt awake. Stale handles are ignored.
+  void add_particles(const std::vector<glm::vec2>& positions, float inv_mass,
+                     std::vector<ParticleHandle>& handles);
+  void remove_particle(const ParticleHandle& handle);
+  void remove_particles(const std::vector<ParticleHandle>& handles);
+  bool is_alive(const ParticleHandle& handle) const;
+  int internal_index(const ParticleHandle& handle) const;
+
+  // so that adding up to nb_particles particles never reallocates
+  void reserve(size_t nb_particles);
+
+  // The nearest particle within radius of position, or a handle that is not
+  // alive if there is none. Each particle keeps its cell in a 256 x 256 grid
+  // over the box, a byte per axis that the step refreshes in the loop it
+  // already runs over the moving particles for sleeping. Picks scan these
+  // 2 bytes per particle instead of the positions, 16 at a time with SSE2,
+  // and only read the positions in cells within the nearest distance found
+  // so far: nothing is rebuilt, however fast the particles move.
+  ParticleHandle pick(const glm::vec2& position, float radius) const;
+
+  // Pulls a particle towards target through a zero-length constraint of the
+  // given compliance, solved with the others until release(); its island
+  // stays awake meanwhile. One particle is held at a time.
+  void grab(const ParticleHandle& handle, const glm::vec2& target, float compliance = 0.0f);
+  void drag(const glm::vec2& target);
+  void release();
+  const ParticleHandle& grabbed() const;
+
+private:
+  // distance constraint as the solver streams it: 32-bit indices and the
+  // compliance already divided by dt^2, four to a cache line
+  struct alignas(16) PackedConstraint
+  {
+    uint32_t first;
+    uint32_t second;
+    float rest_length;
+    float alpha;
+  };
+
+  // accumulated by the kernels in a local copy, which stays in registers
+  struct Residuals
+  {
+    float max;
+    double sum;
+    size_t count;
+
+    void add(float residual)
+    {
+      // written so that a NaN sticks, where std::max would drop it
+      if (!(residual <= max)) max = residual;
+      sum += residual * residual;
+      ++count;
+    }
+
+    void merge(const Residuals& other)
+    {
+      if (!(other.max <= max)) max = other.max;
+      sum += other.sum;
+      count += other.count;
+    }
+  };
+
 private:
   void clear();
   void verlet_integration();
   void satisfy_constraints();
   void accumulate_forces();
 
+  void solve_distance_constraints();
+  void solve_distance_constraints_jacobi(float omega);
+  void update_incidences();
+  void solve_rope_constraints();
+  void solve_angle_constraints();
+  void solve_area_constraints();
+  void solve_grab_constraint();
+
+  int find_island(int particle);
+  void merge_islands(int a, int b);
+  void wake_island(int root);
+  void update_islands();
+  void activate(int particle);
+  void deactivate(int particle);
+  void update_sleep();
+  void update_cell(int particle);
+  void scan_cells(size_t begin, size_t end, const glm::vec2& position, float& best, int& nearest) const;
+
+  std::vector<int> spatial_order(Ordering ordering) const;
+  std::vector<int> cuthill_mckee_order() const;
+  void permute(const std::vector<int>& order);
+  void rebuild_islands();
+
+  int allocate_slot();
+  void move_particle(int from, int to);
+  void pop_particle();
+  void remap_constraints(const std::vector<int>& old_slots);
+
 private:
   float _timestep;
   size_t _nb_particles;
   std::vector<glm::vec2> _positions;
   std::vector<glm::vec2> _old_positions;
   std::vector<glm::vec2> _forces;
+  std::vector<float> _inv_masses;
+  std::vector<glm::vec2> _external_forces;
+
+  // slot given to the API <-> position in the arrays above, -1 for free slots
+  std::vector<int> _internal_indices;
+  std::vector<int> _external_indices;
+  std::vector<uint32_t> _generations;
+  std::vector<int> _free_slots;
+  std::vector<int> _degrees;  // constraint references per particle
+
+  // one contiguous array per constraint type, with the matching XPBD multipliers
   std::vector<Constraint> _constraints;
+  std::vector<RopeConstraint> _ropes;
+  std::vector<float> _rope_lambdas;
+  std::vector<AngleConstraint> _angles;
+  std::vector<float> _angle_lambdas;
+  std::vector<AreaConstraint> _areas;
+  std::vector<float> _area_lambdas;
+
+  // union-find over the constraint graph, per-island data is indexed by root
+  std::vector<int> _island_parents;
+  std::vector<int> _islands;
+  std::vector<int> _island_sizes;
+  std::vector<int> _island_calm_steps;
+  std::vector<char> _island_asleep;
+  std::vector<float> _island_energies;
+  bool _islands_dirty;
+  float _sleep_energy;
+  int _sleep_steps;
+
+  // what step() actually iterates over, rebuilt when an island sleeps or wakes;
+  // free particles (no constraint) come and go without a rebuild, through
+  // their rank in the two lists, -1 when not listed
+  std::vector<int> _active_islands;
+  std::vector<int> _active_particles;
+  std::vector<int> _active_island_ranks;
+  std::vector<int> _active_ranks;
+  std::vector<PackedConstraint> _packed_constraints;  // with their multipliers in _lambdas
+  std::vector<float> _lambdas;
+  std::vector<int> _active_ropes;
+  std::vector<int> _active_angles;
+  std::vector<int> _active_areas;
+
+  ThreadPool* _pool;
+  Solver _solver;
+  float _rho;
+
+  // Jacobi: two corrections per packed constraint, gathered per particle
+  // through the compressed incidence lists
+  std::vector<glm::vec2> _corrections;
+  std::vector<int> _incidence_offsets;
+  std::vector<int> _incidences;
+  std::vector<glm::vec2> _previous_iterate;
+  std::vector<Residuals> _chunk_residuals;
+
+  int _min_iterations;
+  int _max_iterations;
+  float _tolerance;
+  SolverMetrics _metrics;
+  Residuals _residuals;
+
+  // pick cell of each particle, by internal index
+  std::vector<uint8_t> _cells_x;
+  std::vector<uint8_t> _cells_y;
+  glm::vec2 _cells_per_unit;
+  ParticleHandle _grabbed;
+  glm::vec2 _grab_target;
+  float _grab_compliance;
+  float _grab_lambda;
+
   glm::vec2 _gravity;
   glm::vec2 _min, _max;
 };
@@ -0,0 +1,79 @@
+#include "RangeAllocator.hpp"
+#include <iterator>
+#include <stdexcept>
+
+RangeAllocator::RangeAllocator(int size)
+  : _size(0), _nb_free(0)
+{
+  grow(size);
+}
+
+void RangeAllocator::insert(int first, int count)
+{
+  _free[first] = count;
+  _by_count.insert({ count, first });
+  _nb_free += count;
+}
+
+void RangeAllocator::erase(std::map<int, int>::iterator it)
+{
+  _by_count.erase({ it->second, it->first });
+  _nb_free -= it->second;
+  _free.erase(it);
+}
+
+int RangeAllocator::allocate(int count)
+{
+  if (count <= 0) throw std::runtime_error("RangeAllocator::allocate(): empty range");
+  auto best = _by_count.lower_bound({ count, -1 });
+  if (best == _by_count.end()) return -1;
+
+  const int first = best->second;
+  const int left = best->first - count;
+  erase(_free.find(first));
+  if (left > 0) insert(first + count, left);
+  return first;
+}
+
+void RangeAllocator::free(int first, int count)
+{
+  if (count <= 0) return;
+  auto next = _free.lower_bound(first);
+  if (next != _free.end() && next->first == first + count) {
+    count += next->second;
+    erase(next++);
+  }
+  if (next != _free.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == first) {
+      first = previous->first;
+      count += previous->second;
+      erase(previous);
+    }
+  }
+  insert(first, count);
+}
+
+void RangeAllocator::grow(int size)
+{
+  if (size > _size) {
+    const int first = _size;
+    _size = size;
+    free(first, size - first);
+  }
+}
+
+int RangeAllocator::size() const
+{
+  return _size;
+}
+
+int RangeAllocator::nb_free() const
+{
+  return _nb_free;
+}
+
+size_t RangeAllocator::nb_free_ranges() const
+{
+  return _free.size();
+}
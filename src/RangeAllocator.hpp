@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+
+// Best-fit allocator of ranges in [0, size), merging freed neighbours.
+class RangeAllocator
+{
+public:
+  explicit RangeAllocator(int size = 0);
+
+  // first element of a free range of count elements, -1 if none is large enough
+  int allocate(int count);
+  void free(int first, int count);
+  // extends the range managed to [0, size)
+  void grow(int size);
+
+  int size() const;
+  int nb_free() const;
+  size_t nb_free_ranges() const;
+
+private:
+  void insert(int first, int count);
+  void erase(std::map<int, int>::iterator it);
+
+private:
+  int _size;
+  int _nb_free;
+  std::map<int, int> _free;                 // first -> count, never adjacent
+  std::set<std::pair<int, int>> _by_count;  // (count, first)
+};
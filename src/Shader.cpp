@@ -7,55 +7,77 @@
 #include <stdexcept>
 
 namespace {
-void compile_glsl(const std::string& filename, GLuint shader)
+std::string read_glsl(const std::string& filename)
 {
   std::ifstream ifs(filename);
   if (!ifs) {
-    throw std::runtime_error("compile_glsl(): unable to open " + filename);
+    throw std::runtime_error("read_glsl(): unable to open " + filename);
   }
 
   std::ostringstream oss;
   oss << ifs.rdbuf();
-  ifs.close();
-
-  const std::string glsl = oss.str();
-  const char* str = glsl.c_str();
-  glShaderSource(shader, 1, &str, nullptr);
-
-  glCompileShader(shader);
-
-  GLint success;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    char buf[512];
-    glGetShaderInfoLog(shader, sizeof(buf), nullptr, buf);
-    throw std::runtime_error("compile_glsl('" + filename + "'): " + buf);
-  }
+  return oss.str();
 }
 }
 
 Shader::Shader(const std::string& vertex_file, const std::string& fragment_file)
-  : _vertex(glCreateShader(GL_VERTEX_SHADER)),
-    _fragment(glCreateShader(GL_FRAGMENT_SHADER)),
-    _program(glCreateProgram())
+  : Shader({ { GL_VERTEX_SHADER, vertex_file, read_glsl(vertex_file) },
+             { GL_FRAGMENT_SHADER, fragment_file, read_glsl(fragment_file) } })
+{}
+
+Shader::Shader(const std::string& vertex_file, const std::string& fragment_file,
+               const std::string& vertex_source, const std::string& fragment_source)
+  : Shader({ { GL_VERTEX_SHADER, vertex_file, vertex_source },
+             { GL_FRAGMENT_SHADER, fragment_file, fragment_source } })
+{}
+
+Shader::Shader(const std::string& vertex_file, const std::string& vertex_source,
+               const std::vector<std::string>& varyings)
+  : _program(glCreateProgram())
+{
+  compile({ GL_VERTEX_SHADER, vertex_file, vertex_source });
+
+  std::vector<const GLchar*> names;
+  for (const auto& v : varyings) names.push_back(v.c_str());
+  glTransformFeedbackVaryings(_program, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+  link();
+}
+
+Shader::Shader(const std::vector<Stage>& stages)
+  : _program(glCreateProgram())
 {
-  load(vertex_file, fragment_file);
+  for (const auto& stage : stages) compile(stage);
+  link();
 }
 
 Shader::~Shader()
 {
-  glDeleteShader(_vertex);
-  glDeleteShader(_fragment);
+  for (const GLuint shader : _shaders) glDeleteShader(shader);
   glDeleteProgram(_program);
 }
 
-void Shader::load(const std::string& vertex_file, const std::string& fragment_file)
+void Shader::compile(const Stage& stage)
 {
-  compile_glsl(vertex_file, _vertex);
-  compile_glsl(fragment_file, _fragment);
+  const GLuint shader = glCreateShader(stage.type);
+  _shaders.push_back(shader);
+
+  const char* str = stage.source.c_str();
+  glShaderSource(shader, 1, &str, nullptr);
 
-  glAttachShader(_program, _vertex);
-  glAttachShader(_program, _fragment);
+  glCompileShader(shader);
+
+  GLint success;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    char buf[512];
+    glGetShaderInfoLog(shader, sizeof(buf), nullptr, buf);
+    throw std::runtime_error("compile_glsl('" + stage.name + "'): " + buf);
+  }
+  glAttachShader(_program, shader);
+}
+
+void Shader::link()
+{
   glLinkProgram(_program);
 
   GLint success;
@@ -82,6 +104,11 @@ void Shader::set_uniform(const GLchar* name, GLfloat value) const
   glUniform1f(glGetUniformLocation(_program, name), value);
 }
 
+void Shader::set_uniform(const GLchar* name, GLint value) const
+{
+  glUniform1i(glGetUniformLocation(_program, name), value);
+}
+
 void Shader::set_uniform(const GLchar* name, const glm::vec2& value) const
 {
   glUniform2fv(glGetUniformLocation(_program, name), 1, glm::value_ptr(value));
@@ -96,3 +123,9 @@ void Shader::set_uniform(const GLchar* name, const glm::mat4& value) const
 {
   glUniformMatrix4fv(glGetUniformLocation(_program, name), 1, GL_FALSE, glm::value_ptr(value));
 }
+
+void Shader::set_uniform(const GLchar* name, const std::vector<glm::vec4>& values) const
+{
+  if (values.empty()) return;
+  glUniform4fv(glGetUniformLocation(_program, name), (GLsizei)values.size(), glm::value_ptr(values[0]));
+}
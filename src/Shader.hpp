@@ -3,11 +3,30 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
 
 class Shader
 {
 public:
   Shader(const std::string& vertex_file, const std::string& fragment_file);
+  // compiles sources already read, e.g. by an AssetLoader; the file names
+  // only label the errors
+  Shader(const std::string& vertex_file, const std::string& fragment_file,
+         const std::string& vertex_source, const std::string& fragment_source);
+  // a vertex-only program whose outputs varyings are captured, interleaved,
+  // by transform feedback
+  Shader(const std::string& vertex_file, const std::string& vertex_source,
+         const std::vector<std::string>& varyings);
+
+  // a stage of glCreateShader(type), named in errors
+  struct Stage
+  {
+    GLenum type;
+    std::string name;
+    std::string source;
+  };
+  // a program from any stages, e.g. with a geometry shader
+  explicit Shader(const std::vector<Stage>& stages);
   Shader(const Shader&) = delete;
   Shader& operator=(const Shader&) = delete;
   ~Shader();
@@ -16,15 +35,18 @@ public:
   void detach() const;
 
   void set_uniform(const GLchar* name, GLfloat value) const;
+  void set_uniform(const GLchar* name, GLint value) const;
   void set_uniform(const GLchar* name, const glm::vec2& value) const;
   void set_uniform(const GLchar* name, const glm::vec4& value) const;
   void set_uniform(const GLchar* name, const glm::mat4& value) const;
+  // a uniform array, from its first element
+  void set_uniform(const GLchar* name, const std::vector<glm::vec4>& values) const;
 
 private:
-  void load(const std::string& vertex_file, const std::string& fragment_file);
+  void compile(const Stage& stage);
+  void link();
 
 private:
-  GLuint _vertex;
-  GLuint _fragment;
+  std::vector<GLuint> _shaders;
   GLuint _program;
 };
@@ -1,219 +1,260 @@
 #include "Shape.hpp"
-#include <glm/gtc/matrix_transform.hpp>
+#include "Stats.hpp"
 #include <algorithm>
-#include <limits>
 
 namespace {
-  size_t get_stride(Shape::Type type)
+  // counterclockwise, none if it has no area
+  void add_triangle(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c,
+                    std::vector<geometry::polygon2>& pieces)
   {
-    switch (type) {
-      case Shape::Type::VEC2:           return 2;
-      case Shape::Type::VEC2_COL3:      return 5;
-      case Shape::Type::VEC2_COL3_TEX2: return 7;
-    }
-    return 0;
+    const int sign = geometry::orient2D_sign(a, b, c);
+    if (sign > 0) pieces.push_back({ a, b, c });
+    if (sign < 0) pieces.push_back({ a, c, b });
   }
 }
 
-Shape::Shape(GLenum mode, const std::vector<glm::vec2>& vertices)
-  : _mode(mode), _type(Type::VEC2), _scale(1.0f, 1.0f), _rotation(0),
-   _need_update(false), _segments_need_update(true)
-{
-  _vertices.reserve(2 * vertices.size());
-  glm::vec2 bl(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());;
-  glm::vec2 tr(std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
-  for (const auto& v : vertices) {
-    _vertices.push_back(v.x);
-    _vertices.push_back(v.y);
-    bl.x = std::min(bl.x, v.x);
-    tr.x = std::max(tr.x, v.x);
-    bl.y = std::min(bl.y, v.y);
-    tr.y = std::max(tr.y, v.y);
-  }
-  _aabb.first = bl;
-  _aabb.second = tr;
-  init_vao();
-}
-
-Shape::Shape(GLenum mode, Type type, const std::vector<GLfloat>& vertices)
-  : _mode(mode), _type(type), _vertices(vertices), _scale(1.0f, 1.0f), _rotation(0),
-    _need_update(false), _segments_need_update(true)
-{
-  init_vao();
-}
-
-void Shape::init_vao()
-{
-  glGenVertexArrays(1, &_VAO);
-  glBindVertexArray(_VAO);
-
-  glGenBuffers(1, &_VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, _VBO);
-  glBufferData(GL_ARRAY_BUFFER, _vertices.size() * sizeof(GLfloat), _vertices.data(), GL_DYNAMIC_DRAW);
-
-  switch (_type) {
-    case Type::VEC2:
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-      glEnableVertexAttribArray(0);
-      _nb_vertices = _vertices.size() / 2;
-      break;
-    case Type::VEC2_COL3:
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)));
-      glEnableVertexAttribArray(1);
-      _nb_vertices = _vertices.size() / 5;
-      break;
-    case Type::VEC2_COL3_TEX2:
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(GLfloat), (GLvoid*)0);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)));
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(GLfloat), (GLvoid*)(5 * sizeof(GLfloat)));
-      glEnableVertexAttribArray(2);
-      _nb_vertices = _vertices.size() / 7;
-      break;
-  }
+ShapeBase::ShapeBase(GLenum mode)
+  : _vao(0), _vbo(0), _mode(mode), _nb_vertices(0), _capacity(0),
+    _node(TransformHierarchy::global().add()), _generation(0),
+    _segments_need_update(true), _outline_changed(false), _pieces_need_update(true)
+{}
 
-  glBindVertexArray(0);
+void ShapeBase::create_buffer(const void* data, size_t size)
+{
+  glGenVertexArrays(1, &_vao);
+  glBindVertexArray(_vao);
+
+  glGenBuffers(1, &_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+  glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+  _capacity = size;
+  if (data) stats::count_upload(size);
 }
 
-Shape::~Shape()
+ShapeBase::~ShapeBase()
 {
-  glDeleteBuffers(1, &_VBO);
-  glDeleteVertexArrays(1, &_VAO);
+  glDeleteBuffers(1, &_vbo);
+  glDeleteVertexArrays(1, &_vao);
+  TransformHierarchy::global().remove(_node);
 }
 
-size_t Shape::nb_vertices() const
+size_t ShapeBase::nb_vertices() const
 {
   return _nb_vertices;
 }
 
-void Shape::draw() const
+void ShapeBase::upload(const void* data, size_t size)
 {
-  glBindVertexArray(_VAO);
+  _segments_need_update = true;
+
+  glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+  if (size > _capacity) {
+    // grow geometrically so that a slowly growing shape is rarely reallocated
+    _capacity = std::max(size, 2 * _capacity);
+    glBufferData(GL_ARRAY_BUFFER, _capacity, nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stats::count_upload(size);
+}
+
+void ShapeBase::draw() const
+{
+  glBindVertexArray(_vao);
   glDrawArrays(_mode, 0, (GLsizei)_nb_vertices);
+  stats::count_draw();
   glBindVertexArray(0);
 }
 
-void Shape::draw(GLenum mode, GLint first, GLsizei count) const
+void ShapeBase::draw(GLenum mode, GLint first, GLsizei count) const
 {
-  glBindVertexArray(_VAO);
+  glBindVertexArray(_vao);
   glDrawArrays(mode, first, count);
+  stats::count_draw();
   glBindVertexArray(0);
 }
 
-glm::mat4 Shape::get_transform() const
+glm::mat4 ShapeBase::get_transform() const
 {
-  if (_need_update) {
-    _transform = glm::mat4();
-    _transform = glm::translate(_transform, glm::vec3(_origin.x + _position.x, _origin.y + _position.y, 0.0f));
-    _transform = glm::rotate(_transform, _rotation, glm::vec3(0.0f, 0.0f , 1.0f));
-    _transform = glm::scale(_transform, glm::vec3(_scale.x, _scale.y, 1.0f));
-    _need_update = false;
+  check_transform();
+  return to_mat4(world_transform());
+}
+
+affine2 ShapeBase::world_transform() const
+{
+  return TransformHierarchy::global().world(_node);
+}
+
+void ShapeBase::check_transform() const
+{
+  const uint32_t generation = TransformHierarchy::global().generation(_node);
+  if (generation != _generation) {
+    _generation = generation;
     _segments_need_update = true;
+    _pieces_need_update = true;
   }
-  return _transform;
 }
 
-void Shape::reset_transform()
+void ShapeBase::reset_transform()
 {
-  _need_update = true;
-  _origin.x = _origin.y = 0;
-  _position.x = _position.y = 0;
-  _rotation = 0;
-  _scale.x = _scale.y = 1;
+  TransformHierarchy& hierarchy = TransformHierarchy::global();
+  hierarchy.set_origin(_node, glm::vec2(0.0f, 0.0f));
+  hierarchy.set_position(_node, glm::vec2(0.0f, 0.0f));
+  hierarchy.set_rotation(_node, 0.0f);
+  hierarchy.set_scale(_node, glm::vec2(1.0f, 1.0f));
 }
 
-void Shape::set_origin(float x, float y)
+void ShapeBase::set_origin(float x, float y)
 {
-  _need_update |= (x != _origin.x || y != _origin.y);
-  _origin.x = x;
-  _origin.y = y;
+  TransformHierarchy::global().set_origin(_node, glm::vec2(x, y));
 }
 
-void Shape::set_position(float x, float y)
+void ShapeBase::set_position(float x, float y)
 {
-  _need_update |= (x != _position.x || y != _position.y);
-  _position.x = x;
-  _position.y = y;
+  TransformHierarchy::global().set_position(_node, glm::vec2(x, y));
 }
 
-void Shape::set_rotation(float angle)
+void ShapeBase::set_rotation(float angle)
 {
-  _need_update |= (angle != _rotation);
-  _rotation = angle;
+  TransformHierarchy::global().set_rotation(_node, angle);
 }
 
-void Shape::set_scale(float x, float y)
+void ShapeBase::set_scale(float x, float y)
 {
-  _need_update |= (x != _scale.x || y != _scale.y);
-  _scale.x = x;
-  _scale.y = y;
+  TransformHierarchy::global().set_scale(_node, glm::vec2(x, y));
 }
 
-void Shape::translate(float x, float y)
+void ShapeBase::translate(float x, float y)
 {
-  _need_update |= (x != 0 || y != 0);
-  _position.x += x;
-  _position.y += y;
+  const glm::vec2 position = TransformHierarchy::global().position(_node);
+  set_position(position.x + x, position.y + y);
 }
 
-void Shape::rotate(float angle)
+void ShapeBase::rotate(float angle)
 {
-  _need_update |= (angle != 0);
-  _rotation += angle;
+  set_rotation(TransformHierarchy::global().rotation(_node) + angle);
 }
 
-void Shape::scale(float x, float y)
+void ShapeBase::scale(float x, float y)
 {
-  _need_update |= (x != 1 || y != 1);
-  _scale.x *= x;
-  _scale.y *= y;
+  const glm::vec2 scale = TransformHierarchy::global().scale(_node);
+  set_scale(scale.x * x, scale.y * y);
 }
 
-void Shape::clamp_position(float xmin, float xmax, float ymin, float ymax)
+int ShapeBase::node() const
 {
-  const float x = std::max(xmin, std::min(xmax, _position.x));
-  const float y = std::max(ymin, std::min(ymax, _position.y));
-  set_position(x, y);
+  return _node;
+}
+
+void ShapeBase::set_parent(const ShapeBase* parent)
+{
+  TransformHierarchy::global().set_parent(_node, parent ? parent->_node : -1);
+}
+
+size_t ShapeBase::nb_convex_pieces() const
+{
+  decompose();
+  return _piece_offsets.empty() ? 0 : _piece_offsets.size() - 1;
 }
 
-const std::vector<geometry::segment2>& Shape::get_segments() const
+bool ShapeBase::collide_shape(const ShapeBase& other, glm::vec2& mtv, geometry::SatCache* cache) const
 {
-  const glm::mat4 model = get_transform();
-  if (_segments_need_update) {
-    glm::vec4 u = model * glm::vec4(_aabb.first.x, _aabb.first.y, 0.0f, 1.0f);
-    glm::vec4 v = model * glm::vec4(_aabb.second.x, _aabb.second.y, 0.0f, 1.0f);
-    _aabb.first = glm::vec2(u.x, u.y);
-    _aabb.second = glm::vec2(v.x, v.y);
+  if (nb_convex_pieces() == 0 || other.nb_convex_pieces() == 0) return false;
+  update_pieces();
+  other.update_pieces();
 
-    const size_t stride = get_stride(_type);
-    const size_t n = _vertices.size() - stride;
-    _segments.clear();
+  bool hit = false;
+  float deepest = 0;
+  for (size_t i = 0; i < nb_convex_pieces(); ++i) {
+    const glm::vec4& a = _piece_bounds[i];
+    for (size_t j = 0; j < other.nb_convex_pieces(); ++j) {
+      const glm::vec4& b = other._piece_bounds[j];
+      if (a.x > b.z || b.x > a.z || a.y > b.w || b.y > a.w) continue;
 
-    for (size_t i = 0; i < n; i += stride) {
-      u = model * glm::vec4(_vertices[i], _vertices[i + 1], 0.0f, 1.0f);
-      v = model * glm::vec4(_vertices[i + stride], _vertices[i + stride + 1], 0.0f, 1.0f);
-      _segments.push_back({ glm::vec2(u.x, u.y), glm::vec2(v.x, v.y) });
+      int no_cache = -1;
+      int& axis = (cache ? cache->axis(this, (int)i, &other, (int)j) : no_cache);
+      glm::vec2 v;
+      if (geometry::collide_convex(&_world_piece_vertices[_piece_offsets[i]], _piece_offsets[i + 1] - _piece_offsets[i],
+                                   &other._world_piece_vertices[other._piece_offsets[j]],
+                                   other._piece_offsets[j + 1] - other._piece_offsets[j], v, axis) &&
+          glm::dot(v, v) > deepest) {
+        deepest = glm::dot(v, v);
+        mtv = v;
+        hit = true;
+      }
     }
-    u = model * glm::vec4(_vertices[n], _vertices[n + 1], 0.0f, 1.0f);
-    v = model * glm::vec4(_vertices[0], _vertices[1], 0.0f, 1.0f);
-    _segments.push_back({ glm::vec2(u.x, u.y), glm::vec2(v.x, v.y) });
+  }
+  return hit;
+}
 
-    _segments_need_update = false;
+void ShapeBase::decompose() const
+{
+  if (!_outline_changed) return;
+  _outline_changed = false;
+
+  std::vector<geometry::polygon2> pieces;
+  const size_t n = _outline.size();
+  if (_mode == (GLint)GL_LINE_LOOP) {
+    geometry::decompose_convex(_outline, pieces);
+  } else if (_mode == (GLint)GL_TRIANGLE_FAN && n >= 3) {
+    // a closed fan ends on its first rim vertex and is outlined by its rim
+    const bool closed = (_outline[n - 1] == _outline[1]);
+    const geometry::polygon2 outline(_outline.begin() + (closed ? 1 : 0), _outline.end());
+    if (!geometry::decompose_convex(outline, pieces)) {
+      for (size_t i = 1; i + 1 < n; ++i) add_triangle(_outline[0], _outline[i], _outline[i + 1], pieces);
+      geometry::merge_convex(pieces);
+    }
+  } else if (_mode == (GLint)GL_TRIANGLES) {
+    for (size_t i = 0; i + 2 < n; i += 3) add_triangle(_outline[i], _outline[i + 1], _outline[i + 2], pieces);
+    geometry::merge_convex(pieces);
+  } else if (_mode == (GLint)GL_TRIANGLE_STRIP) {
+    for (size_t i = 0; i + 2 < n; ++i) add_triangle(_outline[i], _outline[i + 1], _outline[i + 2], pieces);
+    geometry::merge_convex(pieces);
   }
-  return _segments;
+
+  _piece_vertices.clear();
+  _piece_offsets.clear();
+  for (const auto& piece : pieces) {
+    _piece_offsets.push_back(_piece_vertices.size());
+    _piece_vertices.insert(_piece_vertices.end(), piece.begin(), piece.end());
+  }
+  if (!pieces.empty()) _piece_offsets.push_back(_piece_vertices.size());
+  _pieces_need_update = true;
 }
 
-bool Shape::collide_ray(const glm::vec2& o, const glm::vec2& r,
-                        glm::vec2& point, geometry::segment2& segment) const
+void ShapeBase::update_pieces() const
 {
-  return geometry::intersect_ray_seg(o, r, get_segments(), point, segment);
+  decompose();
+  check_transform();
+  if (!_pieces_need_update) return;
+  const affine2 model = world_transform();
+
+  _world_piece_vertices.resize(_piece_vertices.size());
+  for (size_t i = 0; i < _piece_vertices.size(); ++i) {
+    _world_piece_vertices[i] = apply(model, _piece_vertices[i]);
+  }
+  // a mirroring scale turns the pieces clockwise
+  if (model.a * model.d - model.b * model.c < 0) {
+    for (size_t i = 0; i + 1 < _piece_offsets.size(); ++i) {
+      std::reverse(_world_piece_vertices.begin() + _piece_offsets[i], _world_piece_vertices.begin() + _piece_offsets[i + 1]);
+    }
+  }
+  _piece_bounds.resize(nb_convex_pieces());
+  for (size_t i = 0; i < _piece_bounds.size(); ++i) {
+    glm::vec2 min = _world_piece_vertices[_piece_offsets[i]], max = min;
+    for (size_t k = _piece_offsets[i] + 1; k < _piece_offsets[i + 1]; ++k) {
+      min = glm::min(min, _world_piece_vertices[k]);
+      max = glm::max(max, _world_piece_vertices[k]);
+    }
+    _piece_bounds[i] = glm::vec4(min.x, min.y, max.x, max.y);
+  }
+  _pieces_need_update = false;
 }
 
-bool Shape::collide_segment(const glm::vec2& a, const glm::vec2& b,
-                            glm::vec2& point, geometry::segment2& segment) const
+void ShapeBase::clamp_position(float xmin, float xmax, float ymin, float ymax)
 {
-  return geometry::intersect_seg_seg(a, b, get_segments(), point, segment);
+  const glm::vec2 position = TransformHierarchy::global().position(_node);
+  const float x = std::max(xmin, std::min(xmax, position.x));
+  const float y = std::max(ymin, std::min(ymax, position.y));
+  set_position(x, y);
 }
@@ -1,22 +1,23 @@
 #pragma once
 
+#include "Convex.hpp"
 #include "Geometry.hpp"
+#include "TransformHierarchy.hpp"
+#include "Vertex.hpp"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-class Shape
+// What every shape has whatever its vertex layout: the GL buffers, a node
+// of TransformHierarchy::global() for its transform, and the segments and
+// convex pieces of its outline for collisions.
+class ShapeBase
 {
 public:
-  enum Type { VEC2, VEC2_COL3, VEC2_COL3_TEX2 };
-
-public:
-  Shape(GLenum mode, const std::vector<glm::vec2>& vertices);
-  Shape(GLenum mode, Type type, const std::vector<GLfloat>& vertices);
-  Shape(const Shape&) = delete;
-  Shape& operator=(const Shape&) = delete;
-  ~Shape();
+  ShapeBase(const ShapeBase&) = delete;
+  ShapeBase& operator=(const ShapeBase&) = delete;
 
   size_t nb_vertices() const;
 
@@ -37,6 +38,92 @@ public:
 
   void clamp_position(float xmin, float xmax, float ymin, float ymax);
 
+  // the shape moves with its parent, nullptr detaches it
+  int node() const;
+  void set_parent(const ShapeBase* parent);
+
+  // Convex pieces, made at construction and again by the first collision
+  // after update() changed the vertices. GL_LINE_LOOP outlines are decomposed,
+  // none if they are not simple. A GL_TRIANGLE_FAN is decomposed along its
+  // rim, or through its center if it is open, and falls back to its
+  // triangles; those, like the triangles of GL_TRIANGLES and
+  // GL_TRIANGLE_STRIP shapes, are merged across the edges they share while
+  // the pieces stay convex. Points and lines have none.
+  size_t nb_convex_pieces() const;
+  // Separating axis test of every pair of pieces whose bounds overlap. On
+  // overlap, mtv is the smallest translation of this shape out of the
+  // deepest pair. cache keeps the last separating axis of each pair. False
+  // when either shape has no pieces.
+  bool collide_shape(const ShapeBase& other, glm::vec2& mtv, geometry::SatCache* cache = nullptr) const;
+
+protected:
+  explicit ShapeBase(GLenum mode);
+  ~ShapeBase();
+
+  // a VAO over a new buffer holding size bytes of data
+  void create_buffer(const void* data, size_t size);
+  // replaces the buffer contents, reusing the buffer when they fit
+  void upload(const void* data, size_t size);
+
+  // rebuilds the closed outline through the n positions position(i) when
+  // the vertices or the transform changed
+  template <typename F>
+  const std::vector<geometry::segment2>& segments(size_t n, F position) const;
+
+  // keeps the n positions position(i) for the pieces of the modes that have
+  // them, to be decomposed when needed
+  template <typename F>
+  void set_outline(size_t n, F position);
+  // makes the pieces from the outline when it changed
+  void decompose() const;
+  // moves the pieces to world space when they or the transform changed
+  void update_pieces() const;
+  // flags the segments and pieces when the world transform changed
+  void check_transform() const;
+  affine2 world_transform() const;
+
+protected:
+  GLuint _vao;
+  GLuint _vbo;
+  const GLint _mode;
+  size_t _nb_vertices;
+  size_t _capacity;  // in bytes
+
+  const int _node;
+  // of the world transform the segments and pieces were made with
+  mutable uint32_t _generation;
+
+  mutable std::vector<geometry::segment2> _segments;
+  mutable bool _segments_need_update;
+
+  std::vector<glm::vec2> _outline;
+  mutable bool _outline_changed;
+  // piece i is [_piece_offsets[i], _piece_offsets[i + 1]) of the vertices
+  mutable std::vector<glm::vec2> _piece_vertices;
+  mutable std::vector<size_t> _piece_offsets;
+  mutable std::vector<glm::vec2> _world_piece_vertices;
+  mutable std::vector<glm::vec4> _piece_bounds;  // min.xy, max.xy
+  mutable bool _pieces_need_update;
+};
+
+// A shape whose vertices follow Layout, a vertex::layout<...>. The vertex
+// type, its stride and attribute pointers, and the position decoding used by
+// the outline are all fixed at compile time, so compact layouts (half floats,
+// normalized shorts, bytes) cost nothing at runtime.
+template <typename Layout>
+class BasicShape : public ShapeBase
+{
+public:
+  typedef Layout Vertex;
+
+  BasicShape(GLenum mode, const std::vector<Vertex>& vertices);
+  // for layouts made of a float2 position only
+  BasicShape(GLenum mode, const std::vector<glm::vec2>& vertices);
+
+  const std::vector<Vertex>& vertices() const;
+  void update(const std::vector<Vertex>& vertices);
+  void update(const std::vector<glm::vec2>& vertices);
+
   const std::vector<geometry::segment2>& get_segments() const;
   bool collide_ray(const glm::vec2& o, const glm::vec2& r,
                    glm::vec2& point, geometry::segment2& segment) const;
@@ -44,25 +131,126 @@ public:
                        glm::vec2& point, geometry::segment2& segment) const;
 
 private:
-  void init_vao();
-
-private:
-  GLuint _VAO;
-  GLuint _VBO;
-  const GLint _mode;
-  const Type _type;
-  std::vector<GLfloat> _vertices;
-  size_t _nb_vertices;
+  static const bool POSITIONS_ONLY = std::is_same<Layout, vertex::layout<vertex::float2>>::value;
 
-  glm::vec2 _origin;
-  glm::vec2 _position;
-  glm::vec2 _scale;
-  float _rotation;
+  void init();
 
 private:
-  mutable glm::mat4 _transform;
-  mutable geometry::segment2 _aabb;
-  mutable std::vector<geometry::segment2> _segments;
-  mutable bool _need_update;
-  mutable bool _segments_need_update;
+  std::vector<Vertex> _vertices;
 };
+
+// the former runtime Shape::Type layouts
+typedef BasicShape<vertex::layout<vertex::float2>> Shape;
+typedef BasicShape<vertex::layout<vertex::float2, vertex::float3>> ColoredShape;
+typedef BasicShape<vertex::layout<vertex::float2, vertex::float3, vertex::float2>> TexturedShape;
+// 8 bytes per vertex
+typedef BasicShape<vertex::layout<vertex::half2, vertex::ubyte4n>> CompactShape;
+
+template <typename F>
+const std::vector<geometry::segment2>& ShapeBase::segments(size_t n, F position) const
+{
+  check_transform();
+  if (_segments_need_update) {
+    const affine2 model = world_transform();
+    _segments.clear();
+    if (n > 0) {
+      const glm::vec2 first = apply(model, position(0));
+      glm::vec2 u = first;
+      for (size_t i = 1; i < n; ++i) {
+        const glm::vec2 v = apply(model, position(i));
+        _segments.push_back({ u, v });
+        u = v;
+      }
+      _segments.push_back({ u, first });
+    }
+    _segments_need_update = false;
+  }
+  return _segments;
+}
+
+template <typename F>
+void ShapeBase::set_outline(size_t n, F position)
+{
+  if (_mode != (GLint)GL_LINE_LOOP && _mode != (GLint)GL_TRIANGLE_FAN &&
+      _mode != (GLint)GL_TRIANGLES && _mode != (GLint)GL_TRIANGLE_STRIP) return;
+  _outline.resize(n);
+  for (size_t i = 0; i < n; ++i) _outline[i] = position(i);
+  _outline_changed = true;
+}
+
+template <typename Layout>
+BasicShape<Layout>::BasicShape(GLenum mode, const std::vector<Vertex>& vertices)
+  : ShapeBase(mode), _vertices(vertices)
+{
+  init();
+}
+
+template <typename Layout>
+BasicShape<Layout>::BasicShape(GLenum mode, const std::vector<glm::vec2>& vertices)
+  : ShapeBase(mode), _vertices(vertices.size())
+{
+  static_assert(POSITIONS_ONLY, "BasicShape: only a float2 layout is made of bare positions");
+  for (size_t i = 0; i < vertices.size(); ++i) vertex::set_position(_vertices[i], vertices[i]);
+  init();
+}
+
+template <typename Layout>
+void BasicShape<Layout>::init()
+{
+  create_buffer(_vertices.data(), _vertices.size() * sizeof(Vertex));
+  vertex::attribute_pointers<Layout>::enable();
+  glBindVertexArray(0);
+  _nb_vertices = _vertices.size();
+  const Vertex* v = _vertices.data();
+  set_outline(_vertices.size(), [v] (size_t i) { return vertex::position(v[i]); });
+  decompose();
+}
+
+template <typename Layout>
+const std::vector<typename BasicShape<Layout>::Vertex>& BasicShape<Layout>::vertices() const
+{
+  return _vertices;
+}
+
+template <typename Layout>
+void BasicShape<Layout>::update(const std::vector<Vertex>& vertices)
+{
+  _vertices = vertices;
+  _nb_vertices = _vertices.size();
+  upload(_vertices.data(), _vertices.size() * sizeof(Vertex));
+  const Vertex* v = _vertices.data();
+  set_outline(_vertices.size(), [v] (size_t i) { return vertex::position(v[i]); });
+}
+
+template <typename Layout>
+void BasicShape<Layout>::update(const std::vector<glm::vec2>& vertices)
+{
+  static_assert(POSITIONS_ONLY, "BasicShape: only a float2 layout is made of bare positions");
+  static_assert(sizeof(Vertex) == sizeof(glm::vec2), "BasicShape: float2 vertices are not packed");
+  _vertices.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) vertex::set_position(_vertices[i], vertices[i]);
+  _nb_vertices = _vertices.size();
+  upload(_vertices.data(), _vertices.size() * sizeof(Vertex));
+  set_outline(vertices.size(), [&vertices] (size_t i) { return vertices[i]; });
+}
+
+template <typename Layout>
+const std::vector<geometry::segment2>& BasicShape<Layout>::get_segments() const
+{
+  const Vertex* vertices = _vertices.data();
+  return segments(_vertices.size(), [vertices] (size_t i) { return vertex::position(vertices[i]); });
+}
+
+template <typename Layout>
+bool BasicShape<Layout>::collide_ray(const glm::vec2& o, const glm::vec2& r,
+                                     glm::vec2& point, geometry::segment2& segment) const
+{
+  return geometry::intersect_ray_seg(o, r, get_segments(), point, segment);
+}
+
+template <typename Layout>
+bool BasicShape<Layout>::collide_segment(const glm::vec2& a, const glm::vec2& b,
+                                         glm::vec2& point, geometry::segment2& segment) const
+{
+  return geometry::intersect_seg_seg(a, b, get_segments(), point, segment);
+}
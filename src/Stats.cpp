@@ -0,0 +1,146 @@
+#include "Stats.hpp"
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace stats {
+  int bucket(float ms)
+  {
+    int i = 0;
+    while (i < NB_BUCKETS - 1 && ms >= BUCKET_LIMITS[i]) ++i;
+    return i;
+  }
+
+  std::string page_name(int pid)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "/simplegl.%d", pid);
+    return name;
+  }
+
+  std::string page_name()
+  {
+    return page_name((int)getpid());
+  }
+
+  bool read(const Page& page, Snapshot& snapshot, int max_tries)
+  {
+    for (int i = 0; i < max_tries; ++i) {
+      const uint32_t before = page.sequence.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      std::memcpy(&snapshot, &page.data, sizeof(Snapshot));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (page.sequence.load(std::memory_order_relaxed) == before) {
+        return snapshot.magic == MAGIC && snapshot.version == VERSION;
+      }
+    }
+    return false;
+  }
+
+  Writer::Writer(const std::string& name)
+    : _name(name), _page(nullptr), _shared(false)
+  {
+#ifndef _WIN32
+    const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd >= 0) {
+      if (ftruncate(fd, sizeof(Page)) == 0) {
+        void* p = mmap(nullptr, sizeof(Page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+          _page = static_cast<Page*>(p);
+          _shared = true;
+        }
+      }
+      close(fd);
+      if (!_shared) shm_unlink(name.c_str());
+    }
+#endif
+    if (!_page) _page = static_cast<Page*>(::operator new(sizeof(Page)));
+
+    new (_page) Page();
+    Snapshot& data = begin();
+    std::memset(&data, 0, sizeof(Snapshot));
+    data.magic = MAGIC;
+    data.version = VERSION;
+    data.pid = (uint32_t)getpid();
+    end();
+  }
+
+  Writer::~Writer()
+  {
+#ifndef _WIN32
+    if (_shared) {
+      munmap(_page, sizeof(Page));
+      shm_unlink(_name.c_str());
+      return;
+    }
+#endif
+    ::operator delete(_page);
+  }
+
+  bool Writer::is_shared() const
+  {
+    return _shared;
+  }
+
+  const Page& Writer::page() const
+  {
+    return *_page;
+  }
+
+  Snapshot& Writer::begin()
+  {
+    // odd while writing; the fence keeps the writes after the increment
+    _page->sequence.store(_page->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return _page->data;
+  }
+
+  void Writer::end()
+  {
+    _page->sequence.store(_page->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  Reader::Reader(const std::string& name)
+    : _page(nullptr)
+  {
+#ifndef _WIN32
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw std::runtime_error("stats::Reader::Reader(): no page " + name);
+    // mapping past the end of a truncated page would fault on read
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Page)) {
+      close(fd);
+      throw std::runtime_error("stats::Reader::Reader(): not a stats page " + name);
+    }
+    void* p = mmap(nullptr, sizeof(Page), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("stats::Reader::Reader(): cannot map " + name);
+    _page = static_cast<const Page*>(p);
+#else
+    throw std::runtime_error("stats::Reader::Reader(): no shared memory on this platform");
+#endif
+  }
+
+  Reader::~Reader()
+  {
+#ifndef _WIN32
+    munmap(const_cast<Page*>(_page), sizeof(Page));
+#endif
+  }
+
+  bool Reader::read(Snapshot& snapshot) const
+  {
+    return stats::read(*_page, snapshot);
+  }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Live metrics of a running simulation, published in a POSIX shared-memory
+// page that simplegl-stat reads from another process. The page has a fixed
+// layout and a seqlock: the writer makes the sequence odd, writes, and makes
+// it even again; a reader copies the page and keeps the copy only if the
+// sequence was even and did not change meanwhile. Neither side ever blocks.
+namespace stats {
+  const uint32_t MAGIC = 0x53474c53;  // "SGLS"
+  const uint32_t VERSION = 1;
+
+  // frame and step times are counted in buckets bounded by these, in ms
+  const int NB_BUCKETS = 8;
+  const float BUCKET_LIMITS[NB_BUCKETS - 1] = { 1.0f, 2.0f, 4.0f, 8.0f, 16.7f, 33.3f, 66.7f };
+
+  // the bucket of a time in ms
+  int bucket(float ms);
+
+  // What the page holds. The values are those of the last frame, the
+  // histograms count all of them since the page was created.
+  struct Snapshot
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pid;
+    uint32_t pad;
+    uint64_t frame;
+
+    uint64_t nb_particles;
+    uint64_t nb_active_particles;
+    uint64_t nb_constraints;
+
+    float step_ms;
+    int32_t iterations;
+    float max_residual;
+    float rms_residual;
+
+    float frame_ms;
+    uint32_t upload_bytes;
+    uint32_t draw_calls;
+    uint32_t allocations;
+
+    uint64_t frame_histogram[NB_BUCKETS];
+    uint64_t step_histogram[NB_BUCKETS];
+  };
+
+  struct Page
+  {
+    std::atomic<uint32_t> sequence;
+    uint32_t pad;
+    Snapshot data;
+  };
+
+  // /simplegl.<pid>, of this process by default
+  std::string page_name(int pid);
+  std::string page_name();
+
+  // Consistent copy of a page being written, false if the writer kept
+  // changing it for max_tries attempts or the page is not a stats page.
+  bool read(const Page& page, Snapshot& snapshot, int max_tries = 1000);
+
+  // Owns a page, shared under name when possible and private otherwise, so
+  // that publishing works the same without shared memory.
+  class Writer
+  {
+  public:
+    explicit Writer(const std::string& name);
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool is_shared() const;
+    const Page& page() const;
+
+    // the data to update between begin() and end()
+    Snapshot& begin();
+    void end();
+
+  private:
+    std::string _name;
+    Page* _page;
+    bool _shared;
+  };
+
+  // Maps the page of another process, read-only.
+  class Reader
+  {
+  public:
+    explicit Reader(const std::string& name);
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool read(Snapshot& snapshot) const;
+
+  private:
+    const Page* _page;
+  };
+
+  // What the current frame did so far, bumped where GL is called and reset
+  // by the main loop once the frame is published. Rendering is single
+  // threaded, these are plain counters.
+  struct FrameCounters
+  {
+    size_t upload_bytes;
+    size_t draw_calls;
+  };
+
+  inline FrameCounters& frame_counters()
+  {
+    static FrameCounters counters = { 0, 0 };
+    return counters;
+  }
+
+  inline void count_upload(size_t bytes) { frame_counters().upload_bytes += bytes; }
+  inline void count_draw() { ++frame_counters().draw_calls; }
+
+  // Heap allocations of the whole process, counted by the operator new of
+  // the executable that wants them; stays at 0 otherwise.
+  inline std::atomic<uint64_t>& allocations()
+  {
+    static std::atomic<uint64_t> count(0);
+    return count;
+  }
+}
@@ -0,0 +1,526 @@
+#include "Sweep.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <set>
+#include <unordered_set>
+
+namespace {
+  using geometry::segment2;
+  using geometry::intersection2;
+
+  bool lex_less(const glm::vec2& a, const glm::vec2& b)
+  {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+  }
+
+  // Exact arithmetic on expansions: sums of doubles that do not overlap,
+  // by increasing magnitude, see Shewchuk's "Adaptive Precision
+  // Floating-Point Arithmetic and Fast Robust Geometric Predicates".
+  typedef std::vector<double> Expansion;
+
+  // adds q to e, dropping zeros
+  void grow(Expansion& e, double q)
+  {
+    size_t k = 0;
+    for (size_t j = 0; j < e.size(); ++j) {
+      const double sum = q + e[j];
+      const double bv = sum - q;
+      const double err = (q - (sum - bv)) + (e[j] - bv);
+      if (err != 0) e[k++] = err;
+      q = sum;
+    }
+    e.resize(k);
+    if (q != 0) e.push_back(q);
+  }
+
+  Expansion difference(double a, double b)
+  {
+    Expansion e;
+    grow(e, a);
+    grow(e, -b);
+    return e;
+  }
+
+  Expansion operator+(Expansion e, const Expansion& f)
+  {
+    for (const double q : f) grow(e, q);
+    return e;
+  }
+
+  Expansion operator-(Expansion e, const Expansion& f)
+  {
+    for (const double q : f) grow(e, -q);
+    return e;
+  }
+
+  Expansion operator*(const Expansion& e, const Expansion& f)
+  {
+    Expansion product;
+    for (const double a : e) {
+      for (const double b : f) {
+        const double x = a * b;
+        grow(product, std::fma(a, b, -x));
+        grow(product, x);
+      }
+    }
+    return product;
+  }
+
+  int sign(const Expansion& e)
+  {
+    return (e.empty() ? 0 : (e.back() > 0 ? 1 : -1));
+  }
+
+  // a double that knows whether it holds its exact value
+  struct Tracked
+  {
+    double value;
+    bool exact;
+  };
+
+  Tracked tracked_difference(double a, double b)
+  {
+    const double x = a - b;
+    const double bv = a - x;
+    return { x, (a - (x + bv)) + (bv - b) == 0 };
+  }
+
+  Tracked operator*(const Tracked& a, const Tracked& b)
+  {
+    const double x = a.value * b.value;
+    return { x, a.exact && b.exact && std::fma(a.value, b.value, -x) == 0 };
+  }
+
+  Tracked operator+(const Tracked& a, const Tracked& b)
+  {
+    const double x = a.value + b.value;
+    const double bv = x - a.value;
+    return { x, a.exact && b.exact && (a.value - (x - bv)) + (b.value - bv) == 0 };
+  }
+
+  Tracked operator-(const Tracked& a, const Tracked& b)
+  {
+    return a + Tracked{ -b.value, b.exact };
+  }
+
+  // The sweep line moves left to right, events are ordered by (x, y).
+  // The status holds the segments crossing the sweep line, bottom to top; the
+  // set is only searched at endpoint events, where the event point is exact,
+  // and crossings just swap two neighbouring nodes.
+  class SweepLine
+  {
+  public:
+    SweepLine(const std::vector<segment2>& segments, const std::vector<segment2>& oriented)
+      : _segments(segments), _oriented(oriented), _status(Less(this)), _crossings(Later(this)), _seq(0)
+    {}
+
+    // subset is a list of indices into segments, without degenerate ones
+    void run(const std::vector<int>& subset, std::vector<intersection2>& out);
+
+  private:
+    static const int PROBE = -1;
+
+    struct Node
+    {
+      explicit Node(int s) : segment(s) {}
+      mutable int segment;
+    };
+
+    struct Less
+    {
+      explicit Less(const SweepLine* s) : sweep(s) {}
+      bool operator()(const Node& a, const Node& b) const { return sweep->below(a.segment, b.segment); }
+      const SweepLine* sweep;
+    };
+
+    typedef std::set<Node, Less> Status;
+
+    struct Endpoint
+    {
+      glm::vec2 point;
+      int segment;
+      bool left;
+    };
+
+    // The crossing point of two segments is rational, a float rounding of
+    // it may land on the wrong side of an event that the status order sees
+    // exactly: crossings are ordered on the exact point, from a double
+    // estimate when its error bound allows.
+    struct Crossing
+    {
+      int lower;
+      int upper;
+      size_t seq;
+      double coords[2];
+      double errors[2];
+    };
+
+    struct Later
+    {
+      explicit Later(const SweepLine* s) : sweep(s) {}
+      // reversed for std::priority_queue
+      bool operator()(const Crossing& a, const Crossing& b) const
+      {
+        const int c = sweep->compare(a, b);
+        return c > 0 || (c == 0 && a.seq > b.seq);
+      }
+      const SweepLine* sweep;
+    };
+
+  private:
+    int side(int s) const;
+    bool below(int a, int b) const;
+
+    Crossing make_crossing(int lower, int upper);
+    // exact (x, y) order of a crossing against another one, or a point
+    int compare(const Crossing& a, const Crossing& b) const;
+    int compare(const Crossing& a, const glm::vec2& p) const;
+    // the crossing point in exact homogeneous coordinates (x / w, y / w)
+    void exact(const Crossing& crossing, Expansion* coords, Expansion& w) const;
+
+    void process_endpoints(const std::vector<Endpoint>& endpoints, size_t begin, size_t end);
+    void process_crossing(const Crossing& crossing);
+    void check(Status::iterator lower, Status::iterator upper);
+    void report(int a, int b);
+
+  private:
+    const std::vector<segment2>& _segments;
+    const std::vector<segment2>& _oriented;
+    Status _status;
+    std::vector<Status::iterator> _nodes;
+    std::vector<char> _active;
+    std::priority_queue<Crossing, std::vector<Crossing>, Later> _crossings;
+    std::unordered_set<uint64_t> _reported;
+    std::vector<intersection2>* _out;
+    glm::vec2 _point;
+    size_t _seq;
+  };
+
+  // > 0 if the segment is below the current point, < 0 if above, 0 if through
+  int SweepLine::side(int s) const
+  {
+    if (s == PROBE) return 0;
+    return geometry::orient2D_sign(_oriented[s].first, _oriented[s].second, _point);
+  }
+
+  // order of a and b just right of the current point, one of them goes through it
+  bool SweepLine::below(int a, int b) const
+  {
+    const int sa = side(a);
+    const int sb = side(b);
+    if (sa != sb) return sa > sb;
+    if (a == PROBE || b == PROBE) return false;
+    if (sa == 0) {
+      const segment2& u = _oriented[a];
+      const segment2& v = _oriented[b];
+      const int c = geometry::cross2D_sign(u.first, u.second, v.first, v.second);
+      if (c != 0) return c > 0;
+      return a < b;
+    }
+    // not reached by std::set, which only compares against the inserted node
+    return a < b;
+  }
+
+  // the crossing is a + t (b - a) with t = n / d, n = (c - a) x (d - c) and
+  // d = (b - a) x (d - c); when n and d are exact in double, as on integer
+  // grids, the coordinates are rounded once and often exact, otherwise their
+  // error bound follows the roundings of the evaluation, with some margin
+  SweepLine::Crossing SweepLine::make_crossing(int lower, int upper)
+  {
+    const double eps = std::numeric_limits<double>::epsilon();
+    const segment2& u = _oriented[lower];
+    const segment2& v = _oriented[upper];
+    const Tracked ux = tracked_difference(u.second.x, u.first.x), uy = tracked_difference(u.second.y, u.first.y);
+    const Tracked vx = tracked_difference(v.second.x, v.first.x), vy = tracked_difference(v.second.y, v.first.y);
+    const Tracked wx = tracked_difference(v.first.x, u.first.x), wy = tracked_difference(v.first.y, u.first.y);
+    const Tracked d = ux * vy - uy * vx;
+    const Tracked n = wx * vy - wy * vx;
+    const double t = n.value / d.value;
+    const double t_error = 8 * eps * (std::fabs(wx.value * vy.value) + std::fabs(wy.value * vx.value) +
+                                      std::fabs(t) * (std::fabs(ux.value * vy.value) + std::fabs(uy.value * vx.value))) /
+                           std::fabs(d.value);
+
+    Crossing crossing = { lower, upper, _seq++, { 0, 0 }, { 0, 0 } };
+    const Tracked starts[2] = { { u.first.x, true }, { u.first.y, true } };
+    const Tracked directions[2] = { ux, uy };
+    for (int axis = 0; axis < 2; ++axis) {
+      const Tracked numerator = starts[axis] * d + n * directions[axis];
+      if (numerator.exact && d.exact) {
+        const double x = numerator.value / d.value;
+        crossing.coords[axis] = x;
+        crossing.errors[axis] = (std::fma(x, d.value, -numerator.value) == 0 ? 0 : eps * std::fabs(x));
+      } else {
+        const double dir = directions[axis].value;
+        crossing.coords[axis] = starts[axis].value + t * dir;
+        crossing.errors[axis] = std::fabs(dir) * t_error + 4 * eps * (std::fabs(starts[axis].value) + std::fabs(t * dir));
+      }
+    }
+    return crossing;
+  }
+
+  void SweepLine::exact(const Crossing& crossing, Expansion* coords, Expansion& w) const
+  {
+    const segment2& u = _oriented[crossing.lower];
+    const segment2& v = _oriented[crossing.upper];
+    const Expansion ux = difference(u.second.x, u.first.x), uy = difference(u.second.y, u.first.y);
+    const Expansion vx = difference(v.second.x, v.first.x), vy = difference(v.second.y, v.first.y);
+    const Expansion wx = difference(v.first.x, u.first.x), wy = difference(v.first.y, u.first.y);
+    w = ux * vy - uy * vx;
+    const Expansion n = wx * vy - wy * vx;
+    coords[0] = Expansion(1, u.first.x) * w + n * ux;
+    coords[1] = Expansion(1, u.first.y) * w + n * uy;
+  }
+
+  int SweepLine::compare(const Crossing& a, const Crossing& b) const
+  {
+    if (a.lower == b.lower && a.upper == b.upper) return 0;
+    // y only matters on an exact tie in x
+    for (int axis = 0; axis < 2; ++axis) {
+      const double delta = a.coords[axis] - b.coords[axis];
+      const double error = a.errors[axis] + b.errors[axis];
+      if (std::fabs(delta) > error) return (delta > 0 ? 1 : -1);
+      if (error != 0) break;
+      if (axis == 1) return 0;
+    }
+    Expansion pa[2], wa, pb[2], wb;
+    exact(a, pa, wa);
+    exact(b, pb, wb);
+    const int w_sign = sign(wa) * sign(wb);
+    for (int axis = 0; axis < 2; ++axis) {
+      const int c = sign(pa[axis] * wb - pb[axis] * wa) * w_sign;
+      if (c != 0) return c;
+    }
+    return 0;
+  }
+
+  int SweepLine::compare(const Crossing& a, const glm::vec2& p) const
+  {
+    for (int axis = 0; axis < 2; ++axis) {
+      const double delta = a.coords[axis] - p[axis];
+      if (std::fabs(delta) > a.errors[axis]) return (delta > 0 ? 1 : -1);
+      if (a.errors[axis] != 0) break;
+      if (axis == 1) return 0;
+    }
+    Expansion pa[2], wa;
+    exact(a, pa, wa);
+    for (int axis = 0; axis < 2; ++axis) {
+      const int c = sign(pa[axis] - Expansion(1, p[axis]) * wa) * sign(wa);
+      if (c != 0) return c;
+    }
+    return 0;
+  }
+
+  void SweepLine::report(int a, int b)
+  {
+    if (a > b) std::swap(a, b);
+    const uint64_t key = ((uint64_t)a << 32) | (uint32_t)b;
+    if (!_reported.insert(key).second) return;
+
+    glm::vec2 p;
+    if (geometry::intersect_seg_seg(_segments[a].first, _segments[a].second,
+                                    _segments[b].first, _segments[b].second, p)) {
+      _out->push_back({ a, b, p });
+    }
+  }
+
+  // schedules the crossing of two neighbours if they still have to swap
+  void SweepLine::check(Status::iterator lower, Status::iterator upper)
+  {
+    const int s = lower->segment;
+    const int t = upper->segment;
+    const segment2& u = _oriented[s];
+    const segment2& v = _oriented[t];
+
+    // only proper crossings, touching points are endpoint events
+    const int o1 = geometry::orient2D_sign(u.first, u.second, v.first);
+    const int o2 = geometry::orient2D_sign(u.first, u.second, v.second);
+    if (o1 * o2 >= 0) return;
+    const int o3 = geometry::orient2D_sign(v.first, v.second, u.first);
+    const int o4 = geometry::orient2D_sign(v.first, v.second, u.second);
+    if (o3 * o4 >= 0) return;
+    // the lower one must be steeper to cross the upper one ahead
+    if (geometry::cross2D_sign(u.first, u.second, v.first, v.second) >= 0) return;
+
+    _crossings.push(make_crossing(s, t));
+  }
+
+  void SweepLine::process_crossing(const Crossing& crossing)
+  {
+    if (!_active[crossing.lower] || !_active[crossing.upper]) return;
+    Status::iterator lower = _nodes[crossing.lower];
+    Status::iterator upper = _nodes[crossing.upper];
+    // stale event, the pair was separated or already swapped
+    if (std::next(lower) != upper) return;
+
+    report(crossing.lower, crossing.upper);
+    lower->segment = crossing.upper;
+    upper->segment = crossing.lower;
+    std::swap(_nodes[crossing.lower], _nodes[crossing.upper]);
+
+    if (lower != _status.begin()) check(std::prev(lower), lower);
+    if (std::next(upper) != _status.end()) check(upper, std::next(upper));
+  }
+
+  void SweepLine::process_endpoints(const std::vector<Endpoint>& endpoints, size_t begin, size_t end)
+  {
+    _point = endpoints[begin].point;
+
+    // segments through the point, ending or not
+    std::vector<int> through;
+    auto range = _status.equal_range(Node(PROBE));
+    for (auto it = range.first; it != range.second; ++it) through.push_back(it->segment);
+    _status.erase(range.first, range.second);
+
+    std::vector<int> all = through;
+    for (size_t i = begin; i < end; ++i) {
+      if (endpoints[i].left) all.push_back(endpoints[i].segment);
+    }
+    for (size_t i = 0; i < all.size(); ++i) {
+      for (size_t j = i + 1; j < all.size(); ++j) report(all[i], all[j]);
+    }
+
+    // reinsert what continues in its order just right of the point
+    bool inserted = false;
+    for (const int s : all) {
+      if (_oriented[s].second == _point) {
+        _active[s] = 0;
+        continue;
+      }
+      _nodes[s] = _status.insert(Node(s)).first;
+      _active[s] = 1;
+      inserted = true;
+    }
+
+    range = _status.equal_range(Node(PROBE));
+    if (!inserted) {
+      if (range.first != _status.begin() && range.first != _status.end()) {
+        check(std::prev(range.first), range.first);
+      }
+      return;
+    }
+    if (range.first != _status.begin()) check(std::prev(range.first), range.first);
+    if (range.second != _status.end()) check(std::prev(range.second), range.second);
+  }
+
+  void SweepLine::run(const std::vector<int>& subset, std::vector<intersection2>& out)
+  {
+    _out = &out;
+    _nodes.resize(_segments.size());
+    _active.assign(_segments.size(), 0);
+
+    std::vector<Endpoint> endpoints;
+    endpoints.reserve(2 * subset.size());
+    for (const int s : subset) {
+      endpoints.push_back({ _oriented[s].first, s, true });
+      endpoints.push_back({ _oriented[s].second, s, false });
+    }
+    std::sort(endpoints.begin(), endpoints.end(), [] (const Endpoint& a, const Endpoint& b) {
+      return lex_less(a.point, b.point);
+    });
+
+    size_t i = 0;
+    while (i < endpoints.size()) {
+      const glm::vec2 p = endpoints[i].point;
+      while (!_crossings.empty() && compare(_crossings.top(), p) <= 0) {
+        const Crossing crossing = _crossings.top();
+        _crossings.pop();
+        process_crossing(crossing);
+      }
+      size_t j = i + 1;
+      while (j < endpoints.size() && endpoints[j].point == p) ++j;
+      process_endpoints(endpoints, i, j);
+      i = j;
+    }
+    while (!_crossings.empty()) {
+      const Crossing crossing = _crossings.top();
+      _crossings.pop();
+      process_crossing(crossing);
+    }
+  }
+
+  void orient_segments(const std::vector<segment2>& segments,
+                       std::vector<segment2>& oriented, std::vector<int>& valid)
+  {
+    oriented.resize(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+      const segment2& s = segments[i];
+      oriented[i] = (lex_less(s.second, s.first) ? segment2(s.second, s.first) : s);
+      // a degenerate segment never intersects anything
+      if (s.first != s.second) valid.push_back((int)i);
+    }
+  }
+
+  void sort_intersections(std::vector<intersection2>& out)
+  {
+    std::sort(out.begin(), out.end(), [] (const intersection2& a, const intersection2& b) {
+      return a.first < b.first || (a.first == b.first && a.second < b.second);
+    });
+  }
+}
+
+namespace geometry {
+  std::vector<intersection2> intersect_all(const std::vector<segment2>& segments)
+  {
+    std::vector<segment2> oriented;
+    std::vector<int> valid;
+    orient_segments(segments, oriented, valid);
+
+    std::vector<intersection2> out;
+    SweepLine(segments, oriented).run(valid, out);
+    sort_intersections(out);
+    return out;
+  }
+
+  std::vector<intersection2> intersect_all(const std::vector<segment2>& segments,
+                                           ThreadPool& pool, size_t nb_slabs)
+  {
+    std::vector<segment2> oriented;
+    std::vector<int> valid;
+    orient_segments(segments, oriented, valid);
+    if (nb_slabs == 0) nb_slabs = pool.size();
+    nb_slabs = std::max<size_t>(1, std::min(nb_slabs, valid.size() / 64));
+
+    // slab bounds at quantiles of the segment midpoints
+    std::vector<float> middles;
+    middles.reserve(valid.size());
+    for (const int s : valid) middles.push_back(0.5f * (oriented[s].first.x + oriented[s].second.x));
+    std::vector<float> bounds(nb_slabs + 1);
+    bounds[0] = -std::numeric_limits<float>::infinity();
+    bounds[nb_slabs] = std::numeric_limits<float>::infinity();
+    for (size_t k = 1; k < nb_slabs; ++k) {
+      auto nth = middles.begin() + k * middles.size() / nb_slabs;
+      std::nth_element(middles.begin(), nth, middles.end());
+      bounds[k] = *nth;
+    }
+
+    // each slab sweeps every segment overlapping it, with some slack for the
+    // rounding of intersection points, and keeps the points falling inside
+    std::vector<std::vector<intersection2>> slabs(nb_slabs);
+    pool.parallel_for(nb_slabs, nb_slabs, [&] (size_t, size_t begin, size_t end) {
+      for (size_t k = begin; k < end; ++k) {
+        const float x0 = bounds[k];
+        const float x1 = bounds[k + 1];
+        const float slack0 = 1e-5f * (1.0f + std::fabs(x0));
+        const float slack1 = 1e-5f * (1.0f + std::fabs(x1));
+        std::vector<int> subset;
+        for (const int s : valid) {
+          if (oriented[s].second.x >= x0 - slack0 && oriented[s].first.x <= x1 + slack1) subset.push_back(s);
+        }
+
+        std::vector<intersection2> found;
+        SweepLine(segments, oriented).run(subset, found);
+        for (const auto& i : found) {
+          if (i.point.x >= x0 && i.point.x < x1) slabs[k].push_back(i);
+        }
+      }
+    });
+
+    std::vector<intersection2> out;
+    for (const auto& slab : slabs) out.insert(out.end(), slab.begin(), slab.end());
+    sort_intersections(out);
+    return out;
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Geometry.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+
+namespace geometry {
+  struct intersection2
+  {
+    int first;
+    int second;
+    glm::vec2 point;
+  };
+
+  // All pairs first < second of segments for which intersect_seg_seg() holds,
+  // sorted by (first, second), with point as intersect_seg_seg(segments[first],
+  // segments[second]) computes it. Bentley-Ottmann plane sweep in
+  // O((n + k) log n); the status order only relies on exact predicates.
+  std::vector<intersection2> intersect_all(const std::vector<segment2>& segments);
+
+  // Same result, sweeping nb_slabs vertical slabs in parallel (0 picks one per thread).
+  std::vector<intersection2> intersect_all(const std::vector<segment2>& segments,
+                                           ThreadPool& pool, size_t nb_slabs = 0);
+}
@@ -0,0 +1,116 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace {
+  thread_local bool t_in_pool = false;
+}
+
+ThreadPool::ThreadPool(size_t nb_threads)
+  : _stop(false), _generation(0), _job(nullptr), _n(0), _nb_job_chunks(0),
+    _next_chunk(0), _pending(0), _active(0)
+{
+  // the calling thread is one of the workers
+  for (size_t i = 1; i < nb_threads; ++i) {
+    _threads.push_back(std::thread(&ThreadPool::worker, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& t : _threads) t.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+size_t ThreadPool::size() const
+{
+  return _threads.size() + 1;
+}
+
+size_t ThreadPool::nb_chunks(size_t n, size_t min_chunk_size) const
+{
+  const size_t chunks = std::min(n / std::max<size_t>(min_chunk_size, 1), 4 * size());
+  return std::max<size_t>(chunks, 1);
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, size_t, size_t)>& fn)
+{
+  parallel_for(n, nb_chunks(n), fn);
+}
+
+void ThreadPool::parallel_for(size_t n, size_t nb_chunks,
+                              const std::function<void(size_t, size_t, size_t)>& fn)
+{
+  nb_chunks = std::max<size_t>(1, std::min(nb_chunks, n));
+  if (n == 0) return;
+
+  if (t_in_pool || nb_chunks == 1 || _threads.empty()) {
+    for (size_t c = 0; c < nb_chunks; ++c) {
+      fn(c, c * n / nb_chunks, (c + 1) * n / nb_chunks);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> call_lock(_call_mutex);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = &fn;
+    _n = n;
+    _nb_job_chunks = nb_chunks;
+    _next_chunk = 0;
+    _pending = nb_chunks;
+    ++_generation;
+  }
+  _wake.notify_all();
+
+  t_in_pool = true;
+  run_chunks();
+  t_in_pool = false;
+
+  // wait for the workers to leave run_chunks() too, so that none of them
+  // can pick up a chunk of the next job while it is being set up
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this] { return _pending == 0 && _active == 0; });
+  _job = nullptr;
+}
+
+void ThreadPool::worker()
+{
+  t_in_pool = true;
+  size_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this, seen] { return _stop || (_generation != seen && _job); });
+      if (_stop) return;
+      seen = _generation;
+      ++_active;
+    }
+    run_chunks();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_active;
+    }
+    _done.notify_all();
+  }
+}
+
+void ThreadPool::run_chunks()
+{
+  for (;;) {
+    const size_t c = _next_chunk++;
+    if (c >= _nb_job_chunks) break;
+    (*_job)(c, c * _n / _nb_job_chunks, (c + 1) * _n / _nb_job_chunks);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (--_pending == 0) _done.notify_all();
+  }
+}
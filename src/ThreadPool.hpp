@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t nb_threads = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  // shared by everything that doesn't need its own workers
+  static ThreadPool& global();
+
+  size_t size() const;
+
+  // calls fn(chunk, begin, end) over [0, n) split into nb_chunks chunks and
+  // returns once all of them are done; the calling thread takes part too.
+  // Nested calls from inside fn run inline.
+  void parallel_for(size_t n, size_t nb_chunks,
+                    const std::function<void(size_t, size_t, size_t)>& fn);
+  void parallel_for(size_t n, const std::function<void(size_t, size_t, size_t)>& fn);
+
+  // a good default number of chunks for load balancing
+  size_t nb_chunks(size_t n, size_t min_chunk_size = 1024) const;
+
+private:
+  void worker();
+  void run_chunks();
+
+private:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  bool _stop;
+  size_t _generation;
+
+  const std::function<void(size_t, size_t, size_t)>* _job;
+  size_t _n;
+  size_t _nb_job_chunks;
+  std::atomic<size_t> _next_chunk;
+  size_t _pending;
+  size_t _active;
+  std::mutex _call_mutex;
+};
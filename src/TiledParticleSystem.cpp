@@ -0,0 +1,368 @@
+#include "TiledParticleSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+TiledParticleSystem::TiledParticleSystem(const glm::vec2& min, const glm::vec2& max, const glm::vec2& tile_size,
+                                         ThreadPool& pool)
+  : _min(min), _max(max), _tile_size(tile_size), _pool(&pool), _gravity(0, -4.81f), _timestep(0.005f),
+    _iterations(3), _incidences_dirty(false), _nb_migrations(0)
+{
+  if (!(tile_size.x > 0 && tile_size.y > 0)) {
+    throw std::runtime_error("TiledParticleSystem::TiledParticleSystem(): tiles must have a positive size");
+  }
+  _nb_tiles_x = std::max(1, (int)std::ceil((max.x - min.x) / tile_size.x));
+  _nb_tiles_y = std::max(1, (int)std::ceil((max.y - min.y) / tile_size.y));
+  _tiles.resize(_nb_tiles_x * _nb_tiles_y);
+  for (auto& tile : _tiles) {
+    tile.nb_owned = 0;
+    tile.dirty = false;
+  }
+}
+
+int TiledParticleSystem::add_particle(const glm::vec2& position, float inv_mass)
+{
+  const int id = (int)_locations.size();
+  const int t = tile_index(position);
+  Tile& tile = _tiles[t];
+  truncate_ghosts(tile);
+  _locations.push_back({ t, (int)tile.nb_owned });
+  _inv_masses.push_back(inv_mass);
+  tile.ids.push_back(id);
+  tile.positions.push_back(position);
+  tile.old_positions.push_back(position);
+  tile.inv_masses.push_back(inv_mass);
+  ++tile.nb_owned;
+  _incidences_dirty = true;
+  return id;
+}
+
+void TiledParticleSystem::add_constraint(const Constraint& constraint)
+{
+  const int n = (int)_locations.size();
+  if (constraint.first < 0 || constraint.first >= n || constraint.second < 0 || constraint.second >= n) {
+    throw std::runtime_error("TiledParticleSystem::add_constraint(): no such particle");
+  }
+  _constraints.push_back(constraint);
+  truncate_ghosts(_tiles[_locations[constraint.first].tile]);
+  truncate_ghosts(_tiles[_locations[constraint.second].tile]);
+  _incidences_dirty = true;
+}
+
+void TiledParticleSystem::add_particles(const ParticleSystem& system)
+{
+  if (!system.rope_constraints().empty() || !system.angle_constraints().empty() ||
+      !system.area_constraints().empty()) {
+    throw std::runtime_error("TiledParticleSystem::add_particles(): only distance constraints can be tiled");
+  }
+  const int offset = (int)_locations.size();
+  const std::vector<glm::vec2>& positions = system.particles();
+  for (size_t i = 0; i < positions.size(); ++i) add_particle(positions[i], system.inv_masses()[i]);
+  for (const auto& c : system.constraints()) {
+    add_constraint(Constraint(offset + c.first, offset + c.second, c.rest_length, c.compliance));
+  }
+}
+
+size_t TiledParticleSystem::nb_particles() const
+{
+  return _locations.size();
+}
+
+size_t TiledParticleSystem::nb_constraints() const
+{
+  return _constraints.size();
+}
+
+glm::vec2 TiledParticleSystem::particle(int particle) const
+{
+  const Location& location = _locations[particle];
+  return _tiles[location.tile].positions[location.index];
+}
+
+std::vector<glm::vec2> TiledParticleSystem::particles() const
+{
+  std::vector<glm::vec2> positions(_locations.size());
+  for (size_t i = 0; i < positions.size(); ++i) positions[i] = particle((int)i);
+  return positions;
+}
+
+void TiledParticleSystem::set_gravity(const glm::vec2& gravity)
+{
+  _gravity = gravity;
+}
+
+const glm::vec2& TiledParticleSystem::gravity() const
+{
+  return _gravity;
+}
+
+void TiledParticleSystem::set_timestep(float timestep)
+{
+  _timestep = timestep;
+}
+
+float TiledParticleSystem::timestep() const
+{
+  return _timestep;
+}
+
+void TiledParticleSystem::set_solver_iterations(int iterations)
+{
+  _iterations = std::max(1, iterations);
+}
+
+size_t TiledParticleSystem::nb_tiles() const
+{
+  return _tiles.size();
+}
+
+int TiledParticleSystem::tile_of(int particle) const
+{
+  return _locations[particle].tile;
+}
+
+size_t TiledParticleSystem::nb_ghosts() const
+{
+  size_t nb_ghosts = 0;
+  for (const auto& tile : _tiles) nb_ghosts += tile.ids.size() - tile.nb_owned;
+  return nb_ghosts;
+}
+
+size_t TiledParticleSystem::nb_migrations() const
+{
+  return _nb_migrations;
+}
+
+// Every phase is a pass over the tiles in parallel, where a tile only writes
+// its own arrays: the halo exchange reads the owned particles of other tiles
+// while nothing writes them, and the solver reads nothing but its own tile.
+void TiledParticleSystem::step()
+{
+  rebuild_tiles();
+
+  const size_t nb_tiles = _tiles.size();
+  _pool->parallel_for(nb_tiles, nb_tiles, [this] (size_t, size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      integrate(_tiles[t]);
+      clamp(_tiles[t]);
+    }
+  });
+
+  for (int iter = 0; iter < _iterations; ++iter) {
+    const bool last = (iter + 1 == _iterations);
+    _pool->parallel_for(nb_tiles, nb_tiles, [this] (size_t, size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) exchange(_tiles[t]);
+    });
+    _pool->parallel_for(nb_tiles, nb_tiles, [this, last] (size_t, size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+        solve(_tiles[t]);
+        // the box of the next iteration
+        if (!last) clamp(_tiles[t]);
+      }
+    });
+  }
+
+  migrate();
+  rebuild_tiles();
+}
+
+int TiledParticleSystem::tile_index(const glm::vec2& position) const
+{
+  const int x = (int)std::floor((position.x - _min.x) / _tile_size.x);
+  const int y = (int)std::floor((position.y - _min.y) / _tile_size.y);
+  return std::max(0, std::min(_nb_tiles_y - 1, y)) * _nb_tiles_x + std::max(0, std::min(_nb_tiles_x - 1, x));
+}
+
+// the constraints of each particle, in the order they were added
+void TiledParticleSystem::update_incidences()
+{
+  _incidence_offsets.assign(_locations.size() + 1, 0);
+  for (const auto& c : _constraints) {
+    ++_incidence_offsets[c.first + 1];
+    if (c.second != c.first) ++_incidence_offsets[c.second + 1];
+  }
+  for (size_t i = 1; i < _incidence_offsets.size(); ++i) _incidence_offsets[i] += _incidence_offsets[i - 1];
+  _incidences.resize(_incidence_offsets.back());
+  std::vector<int> fill(_incidence_offsets.begin(), _incidence_offsets.end() - 1);
+  for (size_t k = 0; k < _constraints.size(); ++k) {
+    _incidences[fill[_constraints[k].first]++] = (int)k;
+    if (_constraints[k].second != _constraints[k].first) _incidences[fill[_constraints[k].second]++] = (int)k;
+  }
+  _incidences_dirty = false;
+}
+
+// the constraints reaching the owned particles of a tile, and ghosts for the
+// particles of other tiles at their other end
+void TiledParticleSystem::rebuild(int t)
+{
+  Tile& tile = _tiles[t];
+  std::vector<int> constraints;
+  for (size_t i = 0; i < tile.nb_owned; ++i) {
+    const int id = tile.ids[i];
+    constraints.insert(constraints.end(), _incidences.begin() + _incidence_offsets[id],
+                       _incidences.begin() + _incidence_offsets[id + 1]);
+  }
+  // in the order they were added, whatever tile they come from
+  std::sort(constraints.begin(), constraints.end());
+  constraints.erase(std::unique(constraints.begin(), constraints.end()), constraints.end());
+
+  std::unordered_map<int, int> ghosts;
+  auto local = [&] (int id) {
+    const Location& location = _locations[id];
+    if (location.tile == t) return location.index;
+    auto it = ghosts.find(id);
+    if (it != ghosts.end()) return it->second;
+    const int index = (int)tile.ids.size();
+    ghosts.insert({ id, index });
+    tile.ids.push_back(id);
+    // other tiles may be growing their arrays, the exchange fills it in
+    tile.positions.push_back(glm::vec2(0, 0));
+    tile.inv_masses.push_back(_inv_masses[id]);
+    return index;
+  };
+
+  tile.constraints.clear();
+  for (const int k : constraints) {
+    const Constraint& c = _constraints[k];
+    tile.constraints.push_back(Constraint(local(c.first), local(c.second), c.rest_length, c.compliance));
+  }
+  tile.lambdas.assign(tile.constraints.size(), 0.0f);
+  tile.dirty = false;
+}
+
+void TiledParticleSystem::truncate_ghosts(Tile& tile)
+{
+  tile.ids.resize(tile.nb_owned);
+  tile.positions.resize(tile.nb_owned);
+  tile.inv_masses.resize(tile.nb_owned);
+  tile.constraints.clear();
+  tile.lambdas.clear();
+  tile.dirty = true;
+}
+
+void TiledParticleSystem::rebuild_tiles()
+{
+  if (_incidences_dirty) update_incidences();
+  const size_t nb_tiles = _tiles.size();
+  _pool->parallel_for(nb_tiles, nb_tiles, [this] (size_t, size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      if (_tiles[t].dirty) rebuild((int)t);
+    }
+  });
+}
+
+// verlet integration of the owned particles, pinned particles don't move
+void TiledParticleSystem::integrate(Tile& tile)
+{
+  const glm::vec2 acc = _timestep * _timestep * _gravity;
+  for (size_t i = 0; i < tile.nb_owned; ++i) {
+    if (tile.inv_masses[i] == 0) continue;
+    glm::vec2& pos = tile.positions[i];
+    glm::vec2& old_pos = tile.old_positions[i];
+    glm::vec2 tmp = pos;
+    pos += pos - old_pos + acc;
+    old_pos = tmp;
+  }
+  std::fill(tile.lambdas.begin(), tile.lambdas.end(), 0.0f);
+}
+
+// stay inside the box
+void TiledParticleSystem::clamp(Tile& tile)
+{
+  for (size_t i = 0; i < tile.nb_owned; ++i) {
+    glm::vec2& pos = tile.positions[i];
+    pos.x = std::max(_min.x, std::min(_max.x, pos.x));
+    pos.y = std::max(_min.y, std::min(_max.y, pos.y));
+  }
+}
+
+// Gauss-Seidel over the tile's constraints, as ParticleSystem does; ghosts
+// stay where the exchange put them, their tile moves them
+void TiledParticleSystem::solve(Tile& tile)
+{
+  const float dt2 = _timestep * _timestep;
+  const int nb_owned = (int)tile.nb_owned;
+  for (size_t k = 0; k < tile.constraints.size(); ++k) {
+    const Constraint& c = tile.constraints[k];
+    const float w1 = tile.inv_masses[c.first];
+    const float w2 = tile.inv_masses[c.second];
+    const float alpha = c.compliance / dt2;
+    if (w1 + w2 + alpha == 0) continue;
+
+    const glm::vec2 d = tile.positions[c.second] - tile.positions[c.first];
+    const float len = glm::length(d);
+    // clamp the relative stretch so that large deformations stay stable
+    float diff = (len - c.rest_length) / (len + 0.001f);
+    diff = (diff < 0 ? std::max(diff, -c.rest_length / 10.0f) : std::min(diff, c.rest_length / 10.0f));
+
+    const float dl = (-diff * len - alpha * tile.lambdas[k]) / (w1 + w2 + alpha);
+    tile.lambdas[k] += dl;
+    const glm::vec2 n = d / (len + 0.001f);
+    if (c.first < nb_owned) tile.positions[c.first] -= w1 * dl * n;
+    if (c.second < nb_owned) tile.positions[c.second] += w2 * dl * n;
+  }
+}
+
+// the halo: ghosts take the position their own tile has for them
+void TiledParticleSystem::exchange(Tile& tile)
+{
+  for (size_t g = tile.nb_owned; g < tile.ids.size(); ++g) {
+    const Location& location = _locations[tile.ids[g]];
+    tile.positions[g] = _tiles[location.tile].positions[location.index];
+  }
+}
+
+// Particles that crossed into another tile move there. Finding them is done
+// in parallel; moving them is serial, in tile order so that the layout does
+// not depend on the threads. Both tiles of a move are rebuilt afterwards.
+void TiledParticleSystem::migrate()
+{
+  const size_t nb_tiles = _tiles.size();
+  _pool->parallel_for(nb_tiles, nb_tiles, [this] (size_t, size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      Tile& tile = _tiles[t];
+      tile.leaving.clear();
+      for (size_t i = 0; i < tile.nb_owned; ++i) {
+        const int destination = tile_index(tile.positions[i]);
+        if (destination != (int)t) tile.leaving.push_back({ (int)i, destination });
+      }
+    }
+  });
+
+  _nb_migrations = 0;
+  for (size_t t = 0; t < nb_tiles; ++t) {
+    Tile& source = _tiles[t];
+    if (source.leaving.empty()) continue;
+    truncate_ghosts(source);
+    // from the last index down, so that the swaps never move a particle still to leave
+    for (auto it = source.leaving.rbegin(); it != source.leaving.rend(); ++it) {
+      const int i = it->first;
+      Tile& destination = _tiles[it->second];
+      truncate_ghosts(destination);
+      const int id = source.ids[i];
+      _locations[id] = { it->second, (int)destination.nb_owned };
+      destination.ids.push_back(id);
+      destination.positions.push_back(source.positions[i]);
+      destination.old_positions.push_back(source.old_positions[i]);
+      destination.inv_masses.push_back(source.inv_masses[i]);
+      ++destination.nb_owned;
+
+      const int last = (int)source.nb_owned - 1;
+      if (i != last) {
+        source.ids[i] = source.ids[last];
+        source.positions[i] = source.positions[last];
+        source.old_positions[i] = source.old_positions[last];
+        source.inv_masses[i] = source.inv_masses[last];
+        _locations[source.ids[i]].index = i;
+      }
+      source.ids.pop_back();
+      source.positions.pop_back();
+      source.old_positions.pop_back();
+      source.inv_masses.pop_back();
+      --source.nb_owned;
+      ++_nb_migrations;
+    }
+    source.leaving.clear();
+  }
+}
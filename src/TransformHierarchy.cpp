@@ -0,0 +1,322 @@
+#include "TransformHierarchy.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+glm::mat4 to_mat4(const affine2& m)
+{
+  glm::mat4 result;
+  result[0] = glm::vec4(m.a, m.b, 0.0f, 0.0f);
+  result[1] = glm::vec4(m.c, m.d, 0.0f, 0.0f);
+  result[3] = glm::vec4(m.tx, m.ty, 0.0f, 1.0f);
+  return result;
+}
+
+TransformHierarchy::TransformHierarchy()
+  : _order_dirty(false), _any_dirty(false)
+{}
+
+TransformHierarchy& TransformHierarchy::global()
+{
+  static TransformHierarchy hierarchy;
+  return hierarchy;
+}
+
+int TransformHierarchy::add(int parent)
+{
+  if (parent >= 0) check(parent);
+
+  int id = (int)_slots.size();
+  if (_free_ids.empty()) {
+    _slots.push_back(-1);
+    _first_child.push_back(-1);
+    _next_sibling.push_back(-1);
+    _prev_sibling.push_back(-1);
+  } else {
+    id = _free_ids.back();
+    _free_ids.pop_back();
+  }
+  _slots[id] = (int)_ids.size();
+  _first_child[id] = -1;
+  link(id, parent);
+
+  _ids.push_back(id);
+  _parent_ids.push_back(parent);
+  _parents.push_back(-1);
+  _x.push_back(0); _y.push_back(0);
+  _origin_x.push_back(0); _origin_y.push_back(0);
+  _rotation.push_back(0); _cos.push_back(1); _sin.push_back(0);
+  _scale_x.push_back(1); _scale_y.push_back(1);
+  _a.push_back(1); _b.push_back(0); _c.push_back(0); _d.push_back(1); _tx.push_back(0); _ty.push_back(0);
+  _dirty.push_back(1);
+  _generations.push_back(0);
+
+  // the new node goes at the end of its level
+  _order_dirty = true;
+  _any_dirty = true;
+  return id;
+}
+
+void TransformHierarchy::remove(int node)
+{
+  check(node);
+  const int parent = _parent_ids[_slots[node]];
+  unlink(node);
+  for (int child = _first_child[node]; child >= 0; ) {
+    const int next = _next_sibling[child];
+    _parent_ids[_slots[child]] = parent;
+    link(child, parent);
+    touch(_slots[child]);
+    child = next;
+  }
+  _ids[_slots[node]] = -1;
+  _slots[node] = -1;
+  _free_ids.push_back(node);
+  _order_dirty = true;
+}
+
+void TransformHierarchy::set_parent(int node, int parent)
+{
+  check(node);
+  if (parent >= 0) check(parent);
+  for (int p = parent; p >= 0; p = _parent_ids[_slots[p]]) {
+    if (p == node) throw std::runtime_error("TransformHierarchy::set_parent(): node would be its own ancestor");
+  }
+  const int slot = _slots[node];
+  if (_parent_ids[slot] == parent) return;
+  unlink(node);
+  _parent_ids[slot] = parent;
+  link(node, parent);
+  touch(slot);
+  _order_dirty = true;
+}
+
+int TransformHierarchy::parent(int node) const
+{
+  check(node);
+  return _parent_ids[_slots[node]];
+}
+
+size_t TransformHierarchy::nb_nodes() const
+{
+  return _slots.size() - _free_ids.size();
+}
+
+void TransformHierarchy::set_origin(int node, const glm::vec2& origin)
+{
+  check(node);
+  const int i = _slots[node];
+  if (origin.x == _origin_x[i] && origin.y == _origin_y[i]) return;
+  _origin_x[i] = origin.x;
+  _origin_y[i] = origin.y;
+  touch(i);
+}
+
+glm::vec2 TransformHierarchy::origin(int node) const
+{
+  check(node);
+  return glm::vec2(_origin_x[_slots[node]], _origin_y[_slots[node]]);
+}
+
+void TransformHierarchy::set_position(int node, const glm::vec2& position)
+{
+  check(node);
+  const int i = _slots[node];
+  if (position.x == _x[i] && position.y == _y[i]) return;
+  _x[i] = position.x;
+  _y[i] = position.y;
+  touch(i);
+}
+
+glm::vec2 TransformHierarchy::position(int node) const
+{
+  check(node);
+  return glm::vec2(_x[_slots[node]], _y[_slots[node]]);
+}
+
+void TransformHierarchy::set_rotation(int node, float angle)
+{
+  check(node);
+  const int i = _slots[node];
+  if (angle == _rotation[i]) return;
+  // the trigonometry is done here, once, to keep update() to products
+  _rotation[i] = angle;
+  _cos[i] = std::cos(angle);
+  _sin[i] = std::sin(angle);
+  touch(i);
+}
+
+float TransformHierarchy::rotation(int node) const
+{
+  check(node);
+  return _rotation[_slots[node]];
+}
+
+void TransformHierarchy::set_scale(int node, const glm::vec2& scale)
+{
+  check(node);
+  const int i = _slots[node];
+  if (scale.x == _scale_x[i] && scale.y == _scale_y[i]) return;
+  _scale_x[i] = scale.x;
+  _scale_y[i] = scale.y;
+  touch(i);
+}
+
+glm::vec2 TransformHierarchy::scale(int node) const
+{
+  check(node);
+  return glm::vec2(_scale_x[_slots[node]], _scale_y[_slots[node]]);
+}
+
+void TransformHierarchy::update()
+{
+  if (_order_dirty) reorder();
+  if (!_any_dirty) return;
+
+  // parents first: a single pass takes the flags all the way down
+  const size_t n = _ids.size();
+  uint8_t* dirty = _dirty.data();
+  const int* parents = _parents.data();
+  for (size_t i = _levels[1]; i < n; ++i) dirty[i] |= dirty[parents[i]];
+
+  const float *x = _x.data(), *y = _y.data(), *ox = _origin_x.data(), *oy = _origin_y.data();
+  const float *cs = _cos.data(), *sn = _sin.data(), *sx = _scale_x.data(), *sy = _scale_y.data();
+  float *a = _a.data(), *b = _b.data(), *c = _c.data(), *d = _d.data(), *tx = _tx.data(), *ty = _ty.data();
+  for (size_t level = 0; level + 1 < _levels.size(); ++level) {
+    const size_t begin = _levels[level], end = _levels[level + 1];
+    uint8_t any = 0;
+    for (size_t i = begin; i < end; ++i) any |= dirty[i];
+    if (!any) continue;
+
+    // a whole level at once: clean nodes get the same values again, which
+    // costs less than branching on them
+    if (level == 0) {
+      for (size_t i = begin; i < end; ++i) {
+        a[i] = cs[i] * sx[i];
+        b[i] = sn[i] * sx[i];
+        c[i] = -sn[i] * sy[i];
+        d[i] = cs[i] * sy[i];
+        tx[i] = ox[i] + x[i];
+        ty[i] = oy[i] + y[i];
+      }
+    } else {
+      for (size_t i = begin; i < end; ++i) {
+        const int p = parents[i];
+        const float la = cs[i] * sx[i], lb = sn[i] * sx[i], lc = -sn[i] * sy[i], ld = cs[i] * sy[i];
+        const float lx = ox[i] + x[i], ly = oy[i] + y[i];
+        a[i] = a[p] * la + c[p] * lb;
+        b[i] = b[p] * la + d[p] * lb;
+        c[i] = a[p] * lc + c[p] * ld;
+        d[i] = b[p] * lc + d[p] * ld;
+        tx[i] = a[p] * lx + c[p] * ly + tx[p];
+        ty[i] = b[p] * lx + d[p] * ly + ty[p];
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    _generations[i] += dirty[i];
+    dirty[i] = 0;
+  }
+  _any_dirty = false;
+}
+
+affine2 TransformHierarchy::world(int node)
+{
+  check(node);
+  if (_order_dirty || _any_dirty) update();
+  const int i = _slots[node];
+  const affine2 m = { _a[i], _b[i], _c[i], _d[i], _tx[i], _ty[i] };
+  return m;
+}
+
+uint32_t TransformHierarchy::generation(int node)
+{
+  check(node);
+  if (_order_dirty || _any_dirty) update();
+  return _generations[_slots[node]];
+}
+
+void TransformHierarchy::check(int node) const
+{
+  if (node < 0 || node >= (int)_slots.size() || _slots[node] < 0) {
+    throw std::runtime_error("TransformHierarchy: no node " + std::to_string(node));
+  }
+}
+
+void TransformHierarchy::touch(int slot)
+{
+  _dirty[slot] = 1;
+  _any_dirty = true;
+}
+
+void TransformHierarchy::link(int node, int parent)
+{
+  _prev_sibling[node] = -1;
+  _next_sibling[node] = -1;
+  if (parent < 0) return;
+  const int next = _first_child[parent];
+  if (next >= 0) _prev_sibling[next] = node;
+  _next_sibling[node] = next;
+  _first_child[parent] = node;
+}
+
+void TransformHierarchy::unlink(int node)
+{
+  const int parent = _parent_ids[_slots[node]];
+  if (parent < 0) return;
+  const int prev = _prev_sibling[node], next = _next_sibling[node];
+  if (prev >= 0) _next_sibling[prev] = next;
+  else _first_child[parent] = next;
+  if (next >= 0) _prev_sibling[next] = prev;
+}
+
+void TransformHierarchy::reorder()
+{
+  const int n = (int)_ids.size();
+
+  // breadth first from the roots
+  std::vector<int> order;
+  order.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    if (_ids[i] >= 0 && _parent_ids[i] < 0) order.push_back(i);
+  }
+  _levels.assign(1, 0);
+  for (size_t begin = 0; begin < order.size(); ) {
+    const size_t end = order.size();
+    for (size_t k = begin; k < end; ++k) {
+      for (int child = _first_child[_ids[order[k]]]; child >= 0; child = _next_sibling[child]) order.push_back(_slots[child]);
+    }
+    _levels.push_back(end);
+    begin = end;
+  }
+  if (_levels.size() == 1) _levels.push_back(0);
+
+  permute(_ids, order);
+  permute(_parent_ids, order);
+  permute(_x, order); permute(_y, order);
+  permute(_origin_x, order); permute(_origin_y, order);
+  permute(_rotation, order); permute(_cos, order); permute(_sin, order);
+  permute(_scale_x, order); permute(_scale_y, order);
+  permute(_a, order); permute(_b, order); permute(_c, order); permute(_d, order);
+  permute(_tx, order); permute(_ty, order);
+  permute(_dirty, order);
+  permute(_generations, order);
+
+  _parents.resize(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    _slots[_ids[i]] = (int)i;
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    _parents[i] = (_parent_ids[i] < 0 ? -1 : _slots[_parent_ids[i]]);
+  }
+  _order_dirty = false;
+}
+
+template <typename T>
+void TransformHierarchy::permute(std::vector<T>& values, const std::vector<int>& order)
+{
+  std::vector<T> result(order.size());
+  for (size_t i = 0; i < order.size(); ++i) result[i] = values[order[i]];
+  values.swap(result);
+}
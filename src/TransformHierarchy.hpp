@@ -0,0 +1,99 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 2D affine transform: x' = a x + c y + tx, y' = b x + d y + ty
+struct affine2
+{
+  float a, b, c, d;
+  float tx, ty;
+};
+
+glm::mat4 to_mat4(const affine2& m);
+
+// m applied to the point p
+inline glm::vec2 apply(const affine2& m, const glm::vec2& p)
+{
+  return glm::vec2(m.a * p.x + m.c * p.y + m.tx, m.b * p.x + m.d * p.y + m.ty);
+}
+
+// Transforms of many objects, each relative to a parent, as flat arrays in
+// breadth-first order: parents come before their children and each depth is
+// a contiguous range. update() makes the dirty flags flow down in one pass,
+// then composes the world transforms one depth at a time with 2x3 affine
+// math, in loops over plain float arrays that the compiler can vectorize.
+// A node's local transform is translate(origin + position) * rotate *
+// scale, as shapes had. Nodes are named by ids that stay valid while the
+// arrays are reordered.
+class TransformHierarchy
+{
+public:
+  TransformHierarchy();
+  TransformHierarchy(const TransformHierarchy&) = delete;
+  TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+  // where shapes have their nodes
+  static TransformHierarchy& global();
+
+  // a node with the identity transform, a root without parent
+  int add(int parent = -1);
+  // the children of a removed node keep their local transform, under its parent
+  void remove(int node);
+  void set_parent(int node, int parent);
+  int parent(int node) const;
+  size_t nb_nodes() const;
+
+  void set_origin(int node, const glm::vec2& origin);
+  glm::vec2 origin(int node) const;
+  void set_position(int node, const glm::vec2& position);
+  glm::vec2 position(int node) const;
+  void set_rotation(int node, float angle);
+  float rotation(int node) const;
+  void set_scale(int node, const glm::vec2& scale);
+  glm::vec2 scale(int node) const;
+
+  // recomputes the world transforms of the dirty nodes and their descendants
+  void update();
+  // updated first if needed
+  affine2 world(int node);
+  // changes whenever world(node) does
+  uint32_t generation(int node);
+
+private:
+  void check(int node) const;
+  void touch(int slot);
+  // into or out of the children of its parent
+  void link(int node, int parent);
+  void unlink(int node);
+  void reorder();
+
+  template <typename T>
+  static void permute(std::vector<T>& values, const std::vector<int>& order);
+
+private:
+  // by id
+  std::vector<int> _slots;  // -1 once removed
+  std::vector<int> _free_ids;
+  // children of each node, as doubly linked lists of ids
+  std::vector<int> _first_child;
+  std::vector<int> _next_sibling, _prev_sibling;
+
+  // by slot
+  std::vector<int> _ids;
+  std::vector<int> _parent_ids;
+  std::vector<int> _parents;  // slot of the parent, valid once ordered
+  std::vector<float> _x, _y;
+  std::vector<float> _origin_x, _origin_y;
+  std::vector<float> _rotation, _cos, _sin;
+  std::vector<float> _scale_x, _scale_y;
+  std::vector<float> _a, _b, _c, _d, _tx, _ty;
+  std::vector<uint8_t> _dirty;
+  std::vector<uint32_t> _generations;
+
+  // nodes of depth i are the slots [_levels[i], _levels[i + 1])
+  std::vector<size_t> _levels;
+  bool _order_dirty;
+  bool _any_dirty;
+};
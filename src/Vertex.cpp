@@ -0,0 +1,59 @@
+#include "Vertex.hpp"
+#include <cstring>
+
+namespace vertex {
+  // IEEE 754 binary16, rounding to nearest even
+  uint16_t float_to_half(float f)
+  {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    const uint32_t abs = x & 0x7fffffff;
+
+    if (abs >= 0x7f800000) {
+      // inf stays inf, NaN stays a quiet NaN
+      return sign | (abs > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if (abs >= 0x477ff000) return sign | 0x7c00;  // rounds past 65504
+    if (abs < 0x38800000) {
+      // subnormal half, or zero
+      if (abs < 0x33000000) return sign;
+      const uint32_t mantissa = (abs & 0x007fffff) | 0x00800000;
+      const int shift = 126 - (int)(abs >> 23);
+      const uint32_t half = mantissa >> shift;
+      const uint32_t rest = mantissa & ((1u << shift) - 1);
+      const uint32_t middle = 1u << (shift - 1);
+      return sign | (uint16_t)(half + (rest > middle || (rest == middle && (half & 1))));
+    }
+    const uint32_t rebiased = abs - 0x38000000;
+    const uint32_t half = rebiased >> 13;
+    const uint32_t rest = rebiased & 0x1fff;
+    return sign | (uint16_t)(half + (rest > 0x1000 || (rest == 0x1000 && (half & 1))));
+  }
+
+  float half_to_float(uint16_t h)
+  {
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+    if (exponent == 0x1f) {
+      x = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+      x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+      x = sign;
+    } else {
+      // subnormal, normalized for the float
+      int e = 113;
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        --e;
+      }
+      x = sign | ((uint32_t)e << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time vertex layouts. An attribute is N components of one GL type,
+// stored as the GPU reads them; layout<A, B, ...> is a vertex made of those
+// attributes in order, the first one being the 2D position. Strides, offsets
+// and attribute pointers all come from the types.
+namespace vertex {
+  uint16_t float_to_half(float f);
+  float half_to_float(uint16_t h);
+
+  // how a component is stored, and read back as the vertex shader sees it
+  template <GLenum TYPE, GLboolean NORMALIZED> struct codec;
+
+  template <> struct codec<GL_FLOAT, GL_FALSE>
+  {
+    typedef GLfloat value_type;
+    static float decode(GLfloat v) { return v; }
+    static GLfloat encode(float f) { return f; }
+  };
+
+  template <> struct codec<GL_HALF_FLOAT, GL_FALSE>
+  {
+    typedef GLhalf value_type;
+    static float decode(GLhalf v) { return half_to_float(v); }
+    static GLhalf encode(float f) { return float_to_half(f); }
+  };
+
+  // [-1, 1]
+  template <> struct codec<GL_SHORT, GL_TRUE>
+  {
+    typedef GLshort value_type;
+    static float decode(GLshort v) { return std::max(v / 32767.0f, -1.0f); }
+    static GLshort encode(float f) { return (GLshort)std::round(std::max(-1.0f, std::min(1.0f, f)) * 32767.0f); }
+  };
+
+  // [0, 1]
+  template <> struct codec<GL_UNSIGNED_SHORT, GL_TRUE>
+  {
+    typedef GLushort value_type;
+    static float decode(GLushort v) { return v / 65535.0f; }
+    static GLushort encode(float f) { return (GLushort)std::round(std::max(0.0f, std::min(1.0f, f)) * 65535.0f); }
+  };
+
+  // [0, 1]
+  template <> struct codec<GL_UNSIGNED_BYTE, GL_TRUE>
+  {
+    typedef GLubyte value_type;
+    static float decode(GLubyte v) { return v / 255.0f; }
+    static GLubyte encode(float f) { return (GLubyte)std::round(std::max(0.0f, std::min(1.0f, f)) * 255.0f); }
+  };
+
+  template <GLenum TYPE, GLboolean NORMALIZED, int N>
+  struct attribute
+  {
+    typedef codec<TYPE, NORMALIZED> codec_type;
+    typedef typename codec_type::value_type value_type;
+    static const GLenum type = TYPE;
+    static const GLboolean normalized = NORMALIZED;
+    static const int size = N;
+
+    float get(int i) const { return codec_type::decode(value[i]); }
+    void set(int i, float f) { value[i] = codec_type::encode(f); }
+
+    value_type value[N];
+  };
+
+  template <GLenum TYPE, GLboolean NORMALIZED, int N> const GLenum attribute<TYPE, NORMALIZED, N>::type;
+  template <GLenum TYPE, GLboolean NORMALIZED, int N> const GLboolean attribute<TYPE, NORMALIZED, N>::normalized;
+  template <GLenum TYPE, GLboolean NORMALIZED, int N> const int attribute<TYPE, NORMALIZED, N>::size;
+
+  typedef attribute<GL_FLOAT, GL_FALSE, 1> float1;
+  typedef attribute<GL_FLOAT, GL_FALSE, 2> float2;
+  typedef attribute<GL_FLOAT, GL_FALSE, 3> float3;
+  typedef attribute<GL_FLOAT, GL_FALSE, 4> float4;
+  typedef attribute<GL_HALF_FLOAT, GL_FALSE, 2> half2;
+  typedef attribute<GL_HALF_FLOAT, GL_FALSE, 4> half4;
+  typedef attribute<GL_SHORT, GL_TRUE, 2> short2n;
+  typedef attribute<GL_UNSIGNED_SHORT, GL_TRUE, 2> ushort2n;
+  typedef attribute<GL_UNSIGNED_BYTE, GL_TRUE, 4> ubyte4n;
+
+  // attributes are multiples of 4 bytes, so a layout has no padding
+  template <typename... A> struct layout;
+
+  template <typename A>
+  struct layout<A>
+  {
+    static_assert(sizeof(A) % 4 == 0, "vertex::layout: attributes must be 4-byte aligned");
+    static const size_t count = 1;
+    A head;
+  };
+
+  template <typename A, typename B, typename... R>
+  struct layout<A, B, R...>
+  {
+    static_assert(sizeof(A) % 4 == 0, "vertex::layout: attributes must be 4-byte aligned");
+    static const size_t count = 2 + sizeof...(R);
+    A head;
+    layout<B, R...> tail;
+  };
+
+  template <typename A> const size_t layout<A>::count;
+  template <typename A, typename B, typename... R> const size_t layout<A, B, R...>::count;
+
+  // the I-th attribute of a vertex
+  template <size_t I, typename L> struct element;
+
+  template <typename A, typename... R>
+  struct element<0, layout<A, R...>>
+  {
+    typedef A type;
+    static const size_t offset = 0;
+    static A& get(layout<A, R...>& v) { return v.head; }
+    static const A& get(const layout<A, R...>& v) { return v.head; }
+  };
+
+  template <size_t I, typename A, typename... R>
+  struct element<I, layout<A, R...>>
+  {
+    typedef layout<A, R...> vertex_type;
+    typedef element<I - 1, layout<R...>> next;
+    typedef typename next::type type;
+    static const size_t offset = offsetof(vertex_type, tail) + next::offset;
+    static type& get(layout<A, R...>& v) { return next::get(v.tail); }
+    static const type& get(const layout<A, R...>& v) { return next::get(v.tail); }
+  };
+
+  template <typename A, typename... R> const size_t element<0, layout<A, R...>>::offset;
+  template <size_t I, typename A, typename... R> const size_t element<I, layout<A, R...>>::offset;
+
+  template <size_t I, typename... A>
+  typename element<I, layout<A...>>::type& get(layout<A...>& v)
+  {
+    return element<I, layout<A...>>::get(v);
+  }
+
+  template <size_t I, typename... A>
+  const typename element<I, layout<A...>>::type& get(const layout<A...>& v)
+  {
+    return element<I, layout<A...>>::get(v);
+  }
+
+  template <typename... A>
+  glm::vec2 position(const layout<A...>& v)
+  {
+    static_assert(decltype(v.head)::size >= 2, "vertex::position: the first attribute is not a position");
+    return glm::vec2(v.head.get(0), v.head.get(1));
+  }
+
+  template <typename... A>
+  void set_position(layout<A...>& v, const glm::vec2& p)
+  {
+    v.head.set(0, p.x);
+    v.head.set(1, p.y);
+  }
+
+  // glVertexAttribPointer() for attributes [I, count) of the bound buffer
+  template <typename L, size_t I = 0, bool END = (I == L::count)>
+  struct attribute_pointers
+  {
+    static void enable()
+    {
+      typedef typename element<I, L>::type A;
+      glVertexAttribPointer(I, A::size, A::type, A::normalized, sizeof(L), (GLvoid*)element<I, L>::offset);
+      glEnableVertexAttribArray(I);
+      attribute_pointers<L, I + 1>::enable();
+    }
+  };
+
+  template <typename L, size_t I>
+  struct attribute_pointers<L, I, true>
+  {
+    static void enable() {}
+  };
+}
@@ -0,0 +1,298 @@
+#include "WorldBatch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Lane kernels: the same computation as ParticleSystem for one particle or
+// constraint across worlds [begin, end). Every array is distinct, which the
+// restrict qualifiers tell the compiler so that the loops vectorize.
+namespace {
+  // verlet integration, pinned particles don't move
+  void integrate_lanes(float* __restrict x, float* __restrict y,
+                       float* __restrict old_x, float* __restrict old_y,
+                       const float* __restrict inv_masses,
+                       const float* __restrict gravity_x, const float* __restrict gravity_y,
+                       const float* __restrict timesteps, size_t begin, size_t end)
+  {
+    for (size_t l = begin; l < end; ++l) {
+      const float dt2 = timesteps[l] * timesteps[l];
+      const float moving = (inv_masses[l] != 0 ? 1.0f : 0.0f);
+      const float cx = x[l];
+      const float cy = y[l];
+      x[l] = cx + moving * ((cx - old_x[l]) + dt2 * gravity_x[l]);
+      y[l] = cy + moving * ((cy - old_y[l]) + dt2 * gravity_y[l]);
+      old_x[l] = cx;
+      old_y[l] = cy;
+    }
+  }
+
+  void clamp_lanes(float* __restrict x, const float* __restrict min, const float* __restrict max,
+                   size_t begin, size_t end)
+  {
+    for (size_t l = begin; l < end; ++l) {
+      x[l] = std::max(min[l], std::min(max[l], x[l]));
+    }
+  }
+
+  void solve_distance_lanes(float* __restrict ax, float* __restrict ay,
+                            float* __restrict bx, float* __restrict by,
+                            const float* __restrict wa, const float* __restrict wb,
+                            const float* __restrict rest_lengths, const float* __restrict compliances,
+                            float* __restrict lambdas, const float* __restrict timesteps,
+                            size_t begin, size_t end)
+  {
+    for (size_t l = begin; l < end; ++l) {
+      const float w1 = wa[l];
+      const float w2 = wb[l];
+      const float rest = rest_lengths[l];
+      const float alpha = compliances[l] / (timesteps[l] * timesteps[l]);
+      const float denom = w1 + w2 + alpha;
+
+      const float dx = bx[l] - ax[l];
+      const float dy = by[l] - ay[l];
+      const float len = std::sqrt(dx * dx + dy * dy);
+      // the clamp of the relative stretch, written without branches
+      float diff = (len - rest) / (len + 0.001f);
+      diff = std::min(std::max(diff, -rest / 10.0f), rest / 10.0f);
+
+      // a rigid constraint between two pinned particles does nothing
+      const float active = (denom == 0 ? 0.0f : 1.0f);
+      const float dl = active * ((-diff * len - alpha * lambdas[l]) / (denom + (1.0f - active)));
+      lambdas[l] += dl;
+      const float nx = dx / (len + 0.001f);
+      const float ny = dy / (len + 0.001f);
+      ax[l] -= w1 * dl * nx;
+      ay[l] -= w1 * dl * ny;
+      bx[l] += w2 * dl * nx;
+      by[l] += w2 * dl * ny;
+    }
+  }
+}
+
+WorldBatch::WorldBatch(ThreadPool& pool)
+  : _pool(pool), _packed(false)
+{}
+
+int WorldBatch::add_world(const ParticleSystem& system)
+{
+  if (!system.rope_constraints().empty() || !system.angle_constraints().empty() ||
+      !system.area_constraints().empty()) {
+    throw std::runtime_error("WorldBatch::add_world(): only distance constraints can be batched");
+  }
+  if (_packed) unpack();
+
+  Topology topology;
+  topology.first = system.particles().size();
+  World world;
+  world.positions = system.particles();
+  world.old_positions = system.particles();
+  world.inv_masses = system.inv_masses();
+  for (const auto& c : system.constraints()) {
+    topology.second.push_back({ c.first, c.second });
+    world.rest_lengths.push_back(c.rest_length);
+    world.compliances.push_back(c.compliance);
+  }
+  world.gravity = system.gravity();
+  world.min = system.box_min();
+  world.max = system.box_max();
+  world.timestep = system.timestep();
+
+  auto it = _topologies.find(topology);
+  if (it == _topologies.end()) {
+    Group group;
+    group.nb_particles = topology.first;
+    group.constraints = topology.second;
+    _groups.push_back(group);
+    it = _topologies.insert({ topology, (int)_groups.size() - 1 }).first;
+  }
+  world.group = it->second;
+  world.lane = _groups[world.group].worlds.size();
+  _groups[world.group].worlds.push_back((int)_worlds.size());
+  _worlds.push_back(world);
+  return (int)_worlds.size() - 1;
+}
+
+size_t WorldBatch::nb_worlds() const
+{
+  return _worlds.size();
+}
+
+size_t WorldBatch::nb_groups() const
+{
+  return _groups.size();
+}
+
+void WorldBatch::set_gravity(int world, const glm::vec2& gravity)
+{
+  World& w = _worlds[world];
+  w.gravity = gravity;
+  if (_packed) {
+    const size_t l = _groups[w.group].lane_offset + w.lane;
+    _gravity_x[l] = gravity.x;
+    _gravity_y[l] = gravity.y;
+  }
+}
+
+void WorldBatch::set_timestep(int world, float timestep)
+{
+  World& w = _worlds[world];
+  w.timestep = timestep;
+  if (_packed) _timesteps[_groups[w.group].lane_offset + w.lane] = timestep;
+}
+
+void WorldBatch::set_rest_length(int world, int constraint, float rest_length)
+{
+  World& w = _worlds[world];
+  w.rest_lengths[constraint] = rest_length;
+  if (_packed) {
+    const Group& group = _groups[w.group];
+    _rest_lengths[group.constraint_offset + constraint * group.worlds.size() + w.lane] = rest_length;
+  }
+}
+
+std::vector<glm::vec2> WorldBatch::particles(int world) const
+{
+  const World& w = _worlds[world];
+  if (!_packed) return w.positions;
+
+  const Group& group = _groups[w.group];
+  const size_t n = group.worlds.size();
+  std::vector<glm::vec2> positions(group.nb_particles);
+  for (size_t p = 0; p < group.nb_particles; ++p) {
+    const size_t i = group.particle_offset + p * n + w.lane;
+    positions[p] = glm::vec2(_x[i], _y[i]);
+  }
+  return positions;
+}
+
+void WorldBatch::pack()
+{
+  size_t nb_particle_lanes = 0;
+  size_t nb_constraint_lanes = 0;
+  size_t nb_lanes = 0;
+  _tasks.clear();
+  for (size_t g = 0; g < _groups.size(); ++g) {
+    Group& group = _groups[g];
+    const size_t n = group.worlds.size();
+    group.particle_offset = nb_particle_lanes;
+    group.constraint_offset = nb_constraint_lanes;
+    group.lane_offset = nb_lanes;
+    nb_particle_lanes += group.nb_particles * n;
+    nb_constraint_lanes += group.constraints.size() * n;
+    nb_lanes += n;
+    for (size_t begin = 0; begin < n; begin += LANE_BLOCK) {
+      _tasks.push_back({ (int)g, begin, std::min(n, begin + LANE_BLOCK) });
+    }
+  }
+
+  _x.resize(nb_particle_lanes);
+  _y.resize(nb_particle_lanes);
+  _old_x.resize(nb_particle_lanes);
+  _old_y.resize(nb_particle_lanes);
+  _inv_masses.resize(nb_particle_lanes);
+  _rest_lengths.resize(nb_constraint_lanes);
+  _compliances.resize(nb_constraint_lanes);
+  _lambdas.resize(nb_constraint_lanes);
+  _gravity_x.resize(nb_lanes);
+  _gravity_y.resize(nb_lanes);
+  _timesteps.resize(nb_lanes);
+  _min_x.resize(nb_lanes);
+  _min_y.resize(nb_lanes);
+  _max_x.resize(nb_lanes);
+  _max_y.resize(nb_lanes);
+
+  for (const auto& world : _worlds) {
+    const Group& group = _groups[world.group];
+    const size_t n = group.worlds.size();
+    for (size_t p = 0; p < group.nb_particles; ++p) {
+      const size_t i = group.particle_offset + p * n + world.lane;
+      _x[i] = world.positions[p].x;
+      _y[i] = world.positions[p].y;
+      _old_x[i] = world.old_positions[p].x;
+      _old_y[i] = world.old_positions[p].y;
+      _inv_masses[i] = world.inv_masses[p];
+    }
+    for (size_t c = 0; c < group.constraints.size(); ++c) {
+      const size_t i = group.constraint_offset + c * n + world.lane;
+      _rest_lengths[i] = world.rest_lengths[c];
+      _compliances[i] = world.compliances[c];
+    }
+    const size_t l = group.lane_offset + world.lane;
+    _gravity_x[l] = world.gravity.x;
+    _gravity_y[l] = world.gravity.y;
+    _timesteps[l] = world.timestep;
+    _min_x[l] = world.min.x;
+    _min_y[l] = world.min.y;
+    _max_x[l] = world.max.x;
+    _max_y[l] = world.max.y;
+  }
+  _packed = true;
+}
+
+// the parameters are kept up to date in _worlds, only the state comes back
+void WorldBatch::unpack()
+{
+  for (auto& world : _worlds) {
+    const Group& group = _groups[world.group];
+    const size_t n = group.worlds.size();
+    for (size_t p = 0; p < group.nb_particles; ++p) {
+      const size_t i = group.particle_offset + p * n + world.lane;
+      world.positions[p] = glm::vec2(_x[i], _y[i]);
+      world.old_positions[p] = glm::vec2(_old_x[i], _old_y[i]);
+    }
+  }
+  _packed = false;
+}
+
+void WorldBatch::step()
+{
+  if (!_packed) pack();
+  _pool.parallel_for(_tasks.size(), _tasks.size(), [this] (size_t, size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      step_lanes(_groups[_tasks[t].group], _tasks[t].begin, _tasks[t].end);
+    }
+  });
+}
+
+// ParticleSystem::step() for lanes [begin, end) of a group, one lane per
+// world; the inner loops run over lanes and are free of branches
+void WorldBatch::step_lanes(const Group& group, size_t begin, size_t end)
+{
+  const size_t n = group.worlds.size();
+  float* x = _x.data() + group.particle_offset;
+  float* y = _y.data() + group.particle_offset;
+  float* old_x = _old_x.data() + group.particle_offset;
+  float* old_y = _old_y.data() + group.particle_offset;
+  const float* inv_masses = _inv_masses.data() + group.particle_offset;
+  const float* rest_lengths = _rest_lengths.data() + group.constraint_offset;
+  const float* compliances = _compliances.data() + group.constraint_offset;
+  float* lambdas = _lambdas.data() + group.constraint_offset;
+  const size_t l = group.lane_offset;
+
+  for (size_t p = 0; p < group.nb_particles; ++p) {
+    integrate_lanes(x + p * n, y + p * n, old_x + p * n, old_y + p * n, inv_masses + p * n,
+                    _gravity_x.data() + l, _gravity_y.data() + l, _timesteps.data() + l, begin, end);
+  }
+
+  for (size_t c = 0; c < group.constraints.size(); ++c) {
+    std::fill(lambdas + c * n + begin, lambdas + c * n + end, 0.0f);
+  }
+
+  for (int iter = 0; iter < 3; ++iter) {
+    // stay inside the box
+    for (size_t p = 0; p < group.nb_particles; ++p) {
+      clamp_lanes(x + p * n, _min_x.data() + l, _max_x.data() + l, begin, end);
+      clamp_lanes(y + p * n, _min_y.data() + l, _max_y.data() + l, begin, end);
+    }
+
+    // relax constraints
+    for (size_t c = 0; c < group.constraints.size(); ++c) {
+      const int a = group.constraints[c].first;
+      const int b = group.constraints[c].second;
+      if (a == b) continue;
+      solve_distance_lanes(x + a * n, y + a * n, x + b * n, y + b * n, inv_masses + a * n, inv_masses + b * n,
+                           rest_lengths + c * n, compliances + c * n, lambdas + c * n,
+                           _timesteps.data() + l, begin, end);
+    }
+  }
+}
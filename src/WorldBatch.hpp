@@ -0,0 +1,99 @@
+#pragma once
+#include "ParticleSystem.hpp"
+#include "ThreadPool.hpp"
+#include <glm/glm.hpp>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Steps many small independent particle systems at once, for parameter
+// sweeps. Worlds with the same topology (particle count and distance
+// constraints) form a group and are stored one lane per world: every
+// per-particle and per-constraint value is an array over the group's worlds,
+// so the solver runs the same constraint across all of them in a vectorizable
+// loop. All groups share the same arrays, at per-group offsets, and blocks of
+// lanes are spread over the thread pool.
+//
+// Only distance constraints are batched, and worlds never sleep.
+class WorldBatch
+{
+public:
+  static const size_t LANE_BLOCK = 256;
+
+public:
+  explicit WorldBatch(ThreadPool& pool = ThreadPool::global());
+
+  // copies the particles (at rest), inverse masses, distance constraints,
+  // gravity, timestep and box of system, and returns the new world's index
+  int add_world(const ParticleSystem& system);
+  size_t nb_worlds() const;
+  size_t nb_groups() const;
+
+  void set_gravity(int world, const glm::vec2& gravity);
+  void set_timestep(int world, float timestep);
+  void set_rest_length(int world, int constraint, float rest_length);
+
+  // one step of every world
+  void step();
+
+  std::vector<glm::vec2> particles(int world) const;
+
+private:
+  typedef std::pair<size_t, std::vector<std::pair<int, int>>> Topology;
+
+  struct World
+  {
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec2> old_positions;
+    std::vector<float> inv_masses;
+    std::vector<float> rest_lengths;
+    std::vector<float> compliances;
+    glm::vec2 gravity;
+    glm::vec2 min, max;
+    float timestep;
+    int group;
+    size_t lane;
+  };
+
+  struct Group
+  {
+    size_t nb_particles;
+    std::vector<std::pair<int, int>> constraints;
+    std::vector<int> worlds;
+    size_t particle_offset;    // into the [particle][lane] arrays
+    size_t constraint_offset;  // into the [constraint][lane] arrays
+    size_t lane_offset;        // into the [lane] arrays
+  };
+
+  struct Task
+  {
+    int group;
+    size_t begin, end;
+  };
+
+private:
+  void pack();
+  void unpack();
+  void step_lanes(const Group& group, size_t begin, size_t end);
+
+private:
+  ThreadPool& _pool;
+  std::vector<World> _worlds;
+  std::vector<Group> _groups;
+  std::map<Topology, int> _topologies;
+  std::vector<Task> _tasks;
+  bool _packed;
+
+  // [particle][lane]
+  std::vector<float> _x, _y;
+  std::vector<float> _old_x, _old_y;
+  std::vector<float> _inv_masses;
+  // [constraint][lane]
+  std::vector<float> _rest_lengths;
+  std::vector<float> _compliances;
+  std::vector<float> _lambdas;
+  // [lane]
+  std::vector<float> _gravity_x, _gravity_y;
+  std::vector<float> _timesteps;
+  std::vector<float> _min_x, _min_y, _max_x, _max_y;
+};
@@ -1,24 +1,62 @@
+#include "AssetLoader.hpp"
+#include "DrawList.hpp"
+#include "FramePacer.hpp"
 #include "Geometry.hpp"
+#include "GeometryPool.hpp"
+#include "GpuParticleSystem.hpp"
+#include "LightRenderer.hpp"
 #include "ParticleSystem.hpp"
 #include "Shader.hpp"
 #include "Shape.hpp"
+#include "Stats.hpp"
+#include "TransformHierarchy.hpp"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <thread>
 
 bool g_reset = true;
 bool g_pause = false;
 bool g_wireframe = false;
+bool g_emit = false;
+bool g_gpu_emit = false;
+bool g_lights = false;
+bool g_pace = true;
+int g_swap_interval = 1;
+bool g_swap_tear = false;
+float g_zoom = 1.0f;
+
+// every allocation of the process is counted for the stats page
+void* operator new(std::size_t size)
+{
+  stats::allocations().fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
 
 void main_loop(GLFWwindow* window);
-void update_title(GLFWwindow* window, double frametime);
+void set_swap_interval(int interval);
+void update_title(GLFWwindow* window, double frametime, const FramePacer& pacer);
+void publish_stats(stats::Writer& page, const ParticleSystem& ps, float frametime, bool paused, uint64_t allocations);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
 int main(int argc, char* argv[])
 {
@@ -40,14 +78,21 @@ int main(int argc, char* argv[])
 
   glfwMakeContextCurrent(window);
   glfwSetKeyCallback(window, key_callback);
+  glfwSetScrollCallback(window, scroll_callback);
   //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-  glfwSwapInterval(1);
 
   if (!gladLoadGL()) {
     glfwTerminate();
     return -1;
   }
 
+  // adaptive vsync tears instead of stalling a late frame for a whole period
+  g_swap_tear = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                glfwExtensionSupported("GLX_EXT_swap_control_tear");
+  if (argc > 1) g_swap_interval = std::atoi(argv[1]);
+  else if (g_swap_tear) g_swap_interval = -1;
+  set_swap_interval(g_swap_interval);
+
   try {
     main_loop(window);
   } catch (const std::runtime_error& re) {
@@ -70,79 +115,228 @@ void main_loop(GLFWwindow* window)
   const float ratio = (float)width / height;
   const glm::mat4 proj_matrix = glm::ortho<float>(-ratio, ratio, -1, 1);
 
-  Shape cursor(GL_POINTS, Shape::VEC2, { 0.0f, 0.0f });
+  Shape cursor(GL_POINTS, { glm::vec2(0.0f, 0.0f) });
 
-  Shape room(GL_LINE_LOOP, Shape::VEC2, {
-    -ratio, -1.0f, ratio, -1.0f, +ratio, +1.0f, -ratio, +1.0f
+  // static level geometry, drawn in one call
+  GeometryPool<vertex::layout<vertex::float2>> walls(GL_LINE_LOOP);
+  walls.add({
+    { { -ratio, -1.0f } }, { { ratio, -1.0f } }, { { +ratio, +1.0f } }, { { -ratio, +1.0f } }
   });
 
-  Shader shape_shader("assets/shaders/basic.vertex", "assets/shaders/basic.fragment");
-  shape_shader.attach();
-  shape_shader.set_uniform("proj", proj_matrix);
-  shape_shader.detach();
-
-  Shader cursor_shader("assets/shaders/cursor.vertex", "assets/shaders/cursor.fragment");
-  cursor_shader.attach();
-  cursor_shader.set_uniform("proj", proj_matrix);
-  cursor_shader.detach();
-
   double xpos, ypos, oldxpos, oldypos;
   xpos = ypos = oldxpos = oldypos = 0;
   glfwSetCursorPos(window, xpos, ypos);
 
   ParticleSystem ps({-ratio, -1.0f}, {ratio, 1.0f});
+  DrawList draw_list;
+  Shape points(GL_POINTS, std::vector<glm::vec2>());
+  Shape lines(GL_LINES, std::vector<glm::vec2>());
+
+  // the emitter spawns a batch per frame and retires the oldest one
+  const size_t EMIT_RATE = 64;
+  const size_t EMIT_FRAMES = 240;
+  std::deque<std::vector<ParticleHandle>> emitted;
+  std::vector<glm::vec2> spawns(EMIT_RATE);
+  const size_t capacity = 4096 + EMIT_RATE * EMIT_FRAMES;
+  ps.reserve(capacity);
+
+  // with G, the emitter spawns free particles that stay on the GPU instead
+  const size_t GPU_PARTICLES = 1 << 20;
+  GpuParticleSystem gpu_ps({-ratio, -1.0f}, {ratio, 1.0f}, 1 << 16);
+
+  // with K, lights at the cursor and in two corners, shadowed by the cloth
+  LightRenderer lights;
+
+  // the left button drags the nearest particle around
+  const float GRAB_RADIUS = 0.05f;
+  bool dragging = false;
+  glm::vec2 cursor_pos(0, 0);
+
+  // Frame pacing: the simulation steps on the input of the last frame, then
+  // the loop sleeps until a render time before the next vsync, and only then
+  // samples the cursor, draws and swaps.
+  FramePacer pacer;
+  const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+  if (mode && mode->refreshRate > 0) pacer.set_refresh_period(1.0 / mode->refreshRate);
+  double last_present = glfwGetTime();
+
+  // Assets are read and parsed on the loader's thread while the window keeps
+  // running; only the GL work happens here, once they are ready. A reset
+  // builds a whole new ParticleSystem there and swaps it in.
+  AssetLoader loader;
+  std::unique_ptr<Shader> shape_shader, cursor_shader;
+  auto load_shader = [&] (const std::string& name, std::unique_ptr<Shader>& shader) {
+    const std::string vertex_file = "assets/shaders/" + name + ".vertex";
+    const std::string fragment_file = "assets/shaders/" + name + ".fragment";
+    loader.load([vertex_file, fragment_file] () {
+      return std::make_pair(AssetLoader::read_text(vertex_file), AssetLoader::read_text(fragment_file));
+    }, [&shader, vertex_file, fragment_file, proj_matrix] (std::pair<std::string, std::string>& sources) {
+      shader.reset(new Shader(vertex_file, fragment_file, sources.first, sources.second));
+      shader->attach();
+      shader->set_uniform("proj", proj_matrix);
+      shader->detach();
+    });
+  };
+  load_shader("basic", shape_shader);
+  load_shader("cursor", cursor_shader);
+
+  const glm::vec2 world_min(-ratio, -1.0f), world_max(ratio, 1.0f);
+  bool loading = false;
+
+  // live metrics, read by simplegl-stat <pid>
+  stats::Writer stats_page(stats::page_name());
 
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
-    glfwGetCursorPos(window, &xpos, &ypos);
+    const uint64_t allocations = stats::allocations().load(std::memory_order_relaxed);
+    stats::frame_counters() = stats::FrameCounters();
 
+    glfwPollEvents();
     double frametime = glfwGetTime();
-    const float dx = (float)(2.0 * (xpos - oldxpos) / width);
-    const float dy = (float)(2.0 * (oldypos - ypos) / height);
+
+    if (g_reset && !loading) {
+      loader.load([world_min, world_max, capacity] () {
+        ParticleSystem scene(world_min, world_max);
+        scene.reserve(capacity);
+        scene.read("assets/particles.txt");
+        scene.reorder(ParticleSystem::CUTHILL_MCKEE);
+        return scene;
+      }, [&] (ParticleSystem& scene) {
+        ps = std::move(scene);
+        // handles and the grab belonged to the old system
+        emitted.clear();
+        gpu_ps.clear();
+        dragging = false;
+        loading = false;
+      });
+      loading = true;
+      g_reset = false;
+    }
+    loader.poll();
+
+    if (g_emit && !g_pause) {
+      for (auto& p : spawns) {
+        p = cursor_pos + 0.05f * glm::vec2(2.0f * std::rand() / RAND_MAX - 1.0f, 2.0f * std::rand() / RAND_MAX - 1.0f);
+      }
+      if (!g_gpu_emit) {
+        emitted.push_back(std::vector<ParticleHandle>());
+        emitted.back().reserve(EMIT_RATE);
+        ps.add_particles(spawns, 1.0f, emitted.back());
+      } else if (gpu_ps.nb_particles() + EMIT_RATE <= GPU_PARTICLES) {
+        gpu_ps.add_particles(spawns);
+      }
+    }
+    if (!emitted.empty() && (emitted.size() > EMIT_FRAMES || !g_emit)) {
+      ps.remove_particles(emitted.front());
+      emitted.pop_front();
+    }
+
+    const bool pressed = (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS);
+    if (pressed && !dragging) {
+      ps.grab(ps.pick(cursor_pos, GRAB_RADIUS / g_zoom), cursor_pos);
+    } else if (pressed) {
+      ps.drag(cursor_pos);
+    } else if (dragging) {
+      ps.release();
+    }
+    dragging = pressed;
+
+    if (!g_pause) {
+      ps.step();
+      gpu_ps.step();
+    }
+    frametime = glfwGetTime() - frametime;
+
+    if (g_pace && g_swap_interval != 0) {
+      const double wake = pacer.wake_time(last_present);
+      const double now = glfwGetTime();
+      if (wake > now) std::this_thread::sleep_for(std::chrono::duration<double>(wake - now));
+      glfwPollEvents();
+    }
+
+    // late-latched: the cursor as fresh as possible, drawn where it is now
+    const double input_time = glfwGetTime();
+    glfwGetCursorPos(window, &xpos, &ypos);
+    const float dx = (float)(2.0 * (xpos - oldxpos) / width) / g_zoom;
+    const float dy = (float)(2.0 * (oldypos - ypos) / height) / g_zoom;
     oldxpos = xpos; oldypos = ypos;
 
     cursor.translate(dx, dy);
     cursor.clamp_position(-ratio, ratio, -1.0f, 1.0f);
-    const glm::mat4 cursor_model = cursor.get_transform();
-    const glm::vec2 cursor_pos(cursor_model[3][0], cursor_model[3][1]);
-
-    if (g_reset) {
-      ps.read("assets/particles.txt");
-      g_reset = false;
-    }
+    // the world transforms of every shape, in one pass
+    TransformHierarchy::global().update();
+    const affine2 cursor_world = TransformHierarchy::global().world(cursor.node());
+    cursor_pos = glm::vec2(cursor_world.tx, cursor_world.ty);
+    if (dragging) ps.drag(cursor_pos);
 
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    cursor_shader.attach();
+    if (!cursor_shader) {
+      glfwSwapBuffers(window);
+      last_present = glfwGetTime();
+      continue;
+    }
+
+    const glm::vec2 view_max(ratio / g_zoom, 1.0f / g_zoom);
+    const glm::mat4 view_proj = glm::ortho<float>(-view_max.x, view_max.x, -view_max.y, view_max.y);
+    draw_list.build(ps.particles(), ps.constraints(), -view_max, view_max, width, height);
+
+    if (g_lights) {
+      lights.set_lights({
+        { cursor_pos, { 1.0f, 0.9f, 0.7f, 1.0f }, 2.0f },
+        { { -0.9f * ratio, 0.9f }, { 0.3f, 0.5f, 1.0f, 1.0f }, 3.0f },
+        { { 0.9f * ratio, 0.9f }, { 1.0f, 0.3f, 0.3f, 1.0f }, 3.0f }
+      });
+      lights.set_occluders(draw_list.lines());
+      lights.render_shadows();
+      lights.render_light(-view_max, view_max);
+    }
+
+    cursor_shader->attach();
+    cursor_shader->set_uniform("proj", view_proj);
 
-    const std::vector<glm::vec2>& particles = ps.particles();
-    Shape points(GL_POINTS, particles);
-    cursor_shader.set_uniform("model", points.get_transform());
+    points.update(draw_list.points());
+    cursor_shader->set_uniform("model", points.get_transform());
     points.draw();
 
-    std::vector<glm::vec2> vertices;
-    for (const auto& c : ps.constraints()) {
-      vertices.push_back(particles[c.first]);
-      vertices.push_back(particles[c.second]);
-    }
-    Shape lines(GL_LINES, vertices);
-    cursor_shader.set_uniform("model", lines.get_transform());
+    lines.update(draw_list.lines());
+    cursor_shader->set_uniform("model", lines.get_transform());
     lines.draw();
 
-    //cursor_shader.set_uniform("model", cursor.get_transform());
-    //cursor.draw();
+    cursor_shader->set_uniform("model", glm::mat4());
+    walls.draw();
+    gpu_ps.draw();
 
-    if (!g_pause) ps.step();
-    frametime = glfwGetTime() - frametime;
+    cursor_shader->set_uniform("model", cursor.get_transform());
+    cursor.draw();
 
+    // waiting for the GPU times the rendering, and makes the swap return
+    // close to the actual present instead of queueing frames ahead
+    if (g_pace) glFinish();
+    const double render_end = glfwGetTime();
     glfwSwapBuffers(window);
+    if (g_pace) glFinish();
+    last_present = glfwGetTime();
+
+    pacer.add_render_time(render_end - input_time);
+    pacer.add_latency(last_present - input_time);
+    frametime += render_end - input_time;
 
-    update_title(window, frametime);
+    update_title(window, frametime, pacer);
+    publish_stats(stats_page, ps, (float)frametime, g_pause,
+                  stats::allocations().load(std::memory_order_relaxed) - allocations);
   }
 }
 
-void update_title(GLFWwindow* window, double frametime)
+// 1 waits for vsync, 0 does not, -1 waits unless the frame is late
+void set_swap_interval(int interval)
+{
+  if (interval < 0 && !g_swap_tear) interval = 1;
+  g_swap_interval = interval;
+  glfwSwapInterval(interval);
+}
+
+void update_title(GLFWwindow* window, double frametime, const FramePacer& pacer)
 {
   static char title[256];
   static int frames = 0;
@@ -159,11 +353,38 @@ void update_title(GLFWwindow* window, double frametime)
     ftime = 0;
     tlast = now;
 
-    sprintf(title, "SimpleGL - fps=%.0f tpf=%.3fms", fps, tpf);
+    sprintf(title, "SimpleGL - fps=%.0f tpf=%.3fms latency=%.1fms swap=%d%s", fps, tpf,
+            1000 * pacer.latency(), g_swap_interval, (g_pace && g_swap_interval != 0 ? " paced" : ""));
     glfwSetWindowTitle(window, title);
   }
 }
 
+void publish_stats(stats::Writer& page, const ParticleSystem& ps, float frametime, bool paused, uint64_t allocations)
+{
+  const SolverMetrics& metrics = ps.metrics();
+  const stats::FrameCounters& counters = stats::frame_counters();
+
+  stats::Snapshot& data = page.begin();
+  ++data.frame;
+  data.nb_particles = ps.nb_particles();
+  data.nb_active_particles = ps.nb_active_particles();
+  data.nb_constraints = ps.constraints().size() + ps.rope_constraints().size() +
+                        ps.angle_constraints().size() + ps.area_constraints().size();
+  if (!paused) {
+    data.step_ms = 1000 * metrics.step_time;
+    data.iterations = metrics.iterations;
+    data.max_residual = metrics.max_residual;
+    data.rms_residual = metrics.rms_residual;
+    ++data.step_histogram[stats::bucket(data.step_ms)];
+  }
+  data.frame_ms = 1000 * frametime;
+  data.upload_bytes = (uint32_t)counters.upload_bytes;
+  data.draw_calls = (uint32_t)counters.draw_calls;
+  data.allocations = (uint32_t)allocations;
+  ++data.frame_histogram[stats::bucket(data.frame_ms)];
+  page.end();
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
@@ -179,7 +400,35 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     g_pause = !g_pause;
   }
 
+  if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+    g_emit = !g_emit;
+  }
+
+  if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+    g_gpu_emit = !g_gpu_emit;
+  }
+
+  if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+    g_lights = !g_lights;
+  }
+
+  if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+    g_pace = !g_pace;
+  }
+
+  // cycles the swap interval through 1, 0 and -1 when supported
+  if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+    set_swap_interval(g_swap_interval == 1 ? 0 : g_swap_interval == 0 && g_swap_tear ? -1 : 1);
+  }
+
   if (key == GLFW_KEY_SPACE && action == GLFW_PRESS && action != GLFW_REPEAT) {
     g_reset = true;
   }
 }
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+  // beyond that a pixel is a few float steps of the box wide
+  const float MAX_ZOOM = 1000.0f;
+  g_zoom = std::min(MAX_ZOOM, std::max(1.0f, g_zoom * (float)std::pow(1.1, yoffset)));
+}
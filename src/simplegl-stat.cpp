@@ -0,0 +1,101 @@
+// Prints the live metrics of a running simple, read from its stats page:
+//
+//   simplegl-stat [pid] [interval]
+//
+// Without a pid, the first page found in /dev/shm is read. With an interval
+// in seconds, the metrics are printed again at that rate until interrupted.
+#include "Stats.hpp"
+
+#include <dirent.h>
+#include <signal.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+  // the pid of the first stats page of a live process, 0 if there is none;
+  // a crashed simple leaves its page behind
+  int find_pid()
+  {
+    int pid = 0;
+    if (DIR* dir = opendir("/dev/shm")) {
+      while (dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "simplegl.", 9) == 0) {
+          pid = std::atoi(entry->d_name + 9);
+          if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) break;
+          pid = 0;
+        }
+      }
+      closedir(dir);
+    }
+    return pid;
+  }
+
+  void print_histogram(const char* name, const uint64_t (&histogram)[stats::NB_BUCKETS])
+  {
+    uint64_t total = 0;
+    for (const uint64_t n : histogram) total += n;
+    std::printf("%s (%llu)\n", name, (unsigned long long)total);
+    for (int i = 0; i < stats::NB_BUCKETS; ++i) {
+      char label[32];
+      if (i == 0) std::snprintf(label, sizeof(label), "< %.1f", stats::BUCKET_LIMITS[0]);
+      else if (i == stats::NB_BUCKETS - 1) std::snprintf(label, sizeof(label), ">= %.1f", stats::BUCKET_LIMITS[i - 1]);
+      else std::snprintf(label, sizeof(label), "%.1f - %.1f", stats::BUCKET_LIMITS[i - 1], stats::BUCKET_LIMITS[i]);
+      const int width = total ? (int)(40 * histogram[i] / total) : 0;
+      std::printf("  %13s ms %10llu %s\n", label, (unsigned long long)histogram[i], std::string(width, '#').c_str());
+    }
+  }
+
+  void print(const stats::Snapshot& s)
+  {
+    std::printf("pid %u, frame %llu\n", s.pid, (unsigned long long)s.frame);
+    std::printf("particles    %llu (%llu awake), constraints %llu\n", (unsigned long long)s.nb_particles,
+                (unsigned long long)s.nb_active_particles, (unsigned long long)s.nb_constraints);
+    std::printf("step         %.3f ms, %d iterations, residual %.3g max %.3g rms\n",
+                s.step_ms, s.iterations, s.max_residual, s.rms_residual);
+    std::printf("frame        %.3f ms, %u draw calls, %.1f KiB uploaded, %u allocations\n",
+                s.frame_ms, s.draw_calls, s.upload_bytes / 1024.0, s.allocations);
+    print_histogram("frame times", s.frame_histogram);
+    print_histogram("step times", s.step_histogram);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const int pid = (argc > 1 ? std::atoi(argv[1]) : find_pid());
+  const double interval = (argc > 2 ? std::atof(argv[2]) : 0);
+  if (pid <= 0) {
+    std::fprintf(stderr, "simplegl-stat: no running simple found\n");
+    return 1;
+  }
+
+  std::unique_ptr<stats::Reader> reader;
+  try {
+    reader.reset(new stats::Reader(stats::page_name(pid)));
+  } catch (const std::runtime_error& re) {
+    std::fprintf(stderr, "%s\n", re.what());
+    return 1;
+  }
+
+  do {
+    stats::Snapshot snapshot;
+    if (!reader->read(snapshot)) {
+      std::fprintf(stderr, "simplegl-stat: cannot read a consistent page\n");
+      return 1;
+    }
+    print(snapshot);
+    if (interval > 0) {
+      std::printf("\n");
+      std::fflush(stdout);
+      std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+  } while (interval > 0);
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "AssetLoader.hpp"
+#include "ParticleSystem.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+  const char* SCENE = "asset_loader_test.txt";
+
+  void write_scene()
+  {
+    std::ofstream ofs(SCENE);
+    ofs << "3\n0.0 0.0\n0.1 0.0\n0.2 0.0\n2\n0 1 0.1\n1 2 0.1\n";
+  }
+}
+
+TEST(AssetLoaderTest, CompletesOnThePollingThread)
+{
+  AssetLoader loader;
+  std::thread::id worker, completion;
+  int result = 0;
+  loader.load([&worker] { worker = std::this_thread::get_id(); return 42; },
+              [&] (int& r) { completion = std::this_thread::get_id(); result = r; });
+
+  loader.wait();
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(1u, loader.nb_pending());
+  ASSERT_EQ(1u, loader.poll());
+  ASSERT_EQ(42, result);
+  ASSERT_EQ(0u, loader.nb_pending());
+  ASSERT_NE(std::this_thread::get_id(), worker);
+  ASSERT_EQ(std::this_thread::get_id(), completion);
+}
+
+TEST(AssetLoaderTest, CompletesInOrder)
+{
+  AssetLoader loader;
+  std::vector<int> order;
+  for (int i = 0; i < 8; ++i) {
+    loader.load([i] { return i; }, [&order] (int& i) { order.push_back(i); });
+  }
+  loader.wait();
+  loader.poll();
+  ASSERT_EQ((std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 }), order);
+}
+
+TEST(AssetLoaderTest, ErrorsRethrowFromPoll)
+{
+  AssetLoader loader;
+  bool done = false;
+  loader.load_text("does/not/exist", [&done] (std::string&) { done = true; });
+  loader.load([] { return 1; }, [&done] (int&) { done = true; });
+  loader.wait();
+  ASSERT_THROW(loader.poll(), std::runtime_error);
+  ASSERT_FALSE(done);
+  // the next job still completes
+  ASSERT_EQ(1u, loader.poll());
+  ASSERT_TRUE(done);
+}
+
+TEST(AssetLoaderTest, LoadsASceneToSwapIn)
+{
+  write_scene();
+  ParticleSystem ps({ -1, -1 }, { 1, 1 });
+  AssetLoader loader;
+  loader.load([] {
+    ParticleSystem scene({ -1, -1 }, { 1, 1 });
+    scene.read(SCENE);
+    return scene;
+  }, [&ps] (ParticleSystem& scene) { ps = std::move(scene); });
+
+  loader.wait();
+  ASSERT_EQ(0u, ps.particles().size());
+  loader.poll();
+  ASSERT_EQ(3u, ps.particles().size());
+  ASSERT_EQ(2u, ps.constraints().size());
+  ps.step();
+  std::remove(SCENE);
+}
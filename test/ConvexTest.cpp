@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include "Convex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+  float area(const geometry::polygon2& polygon)
+  {
+    double a = 0;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+      a += (double)polygon[j].x * polygon[i].y - (double)polygon[i].x * polygon[j].y;
+    }
+    return (float)(a / 2);
+  }
+
+  bool is_convex(const geometry::polygon2& polygon)
+  {
+    const size_t n = polygon.size();
+    for (size_t i = 0; i < n; ++i) {
+      if (geometry::orient2D_sign(polygon[i], polygon[(i + 1) % n], polygon[(i + 2) % n]) < 0) return false;
+    }
+    return n >= 3;
+  }
+
+  geometry::polygon2 regular(size_t n, const glm::vec2& center, float radius, float phase)
+  {
+    geometry::polygon2 polygon;
+    for (size_t i = 0; i < n; ++i) {
+      const float angle = phase + 6.2831853f * i / n;
+      polygon.push_back(center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+    }
+    return polygon;
+  }
+
+  // inside a counterclockwise convex polygon
+  bool contains(const geometry::polygon2& polygon, const glm::vec2& p)
+  {
+    for (size_t i = 0; i < polygon.size(); ++i) {
+      if (geometry::orient2D_sign(polygon[i], polygon[(i + 1) % polygon.size()], p) <= 0) return false;
+    }
+    return true;
+  }
+}
+
+TEST(ConvexTest, ConvexPolygonIsOnePiece)
+{
+  // clockwise, with a vertex in the middle of an edge
+  const geometry::polygon2 square = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0.5f }, { 1, 0 } };
+  std::vector<geometry::polygon2> pieces;
+  ASSERT_TRUE(geometry::decompose_convex(square, pieces));
+  ASSERT_EQ(1u, pieces.size());
+  ASSERT_TRUE(is_convex(pieces[0]));
+  ASSERT_FLOAT_EQ(1.0f, area(pieces[0]));
+}
+
+TEST(ConvexTest, ConcavePiecesAreConvexAndCoverThePolygon)
+{
+  const geometry::polygon2 l_shape = { { 0, 0 }, { 2, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 2 } };
+  std::vector<geometry::polygon2> pieces;
+  ASSERT_TRUE(geometry::decompose_convex(l_shape, pieces));
+  ASSERT_EQ(2u, pieces.size());
+
+  // a star: each of its 8 reflex vertices needs a piece of its own at most
+  geometry::polygon2 star;
+  for (int i = 0; i < 16; ++i) {
+    const float angle = 6.2831853f * i / 16, radius = (i % 2 ? 0.4f : 1.0f);
+    star.push_back(radius * glm::vec2(std::cos(angle), std::sin(angle)));
+  }
+  ASSERT_TRUE(geometry::decompose_convex(star, pieces));
+  ASSERT_GE(9u, pieces.size());
+  float total = 0;
+  for (const auto& piece : pieces) {
+    ASSERT_TRUE(is_convex(piece));
+    total += area(piece);
+  }
+  ASSERT_NEAR(area(star), total, 1e-5f);
+}
+
+TEST(ConvexTest, RejectsPolygonsThatAreNotSimple)
+{
+  std::vector<geometry::polygon2> pieces;
+  const geometry::polygon2 bowtie = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+  ASSERT_FALSE(geometry::decompose_convex(bowtie, pieces));
+  const geometry::polygon2 flat = { { 0, 0 }, { 1, 1 }, { 2, 2 } };
+  ASSERT_FALSE(geometry::decompose_convex(flat, pieces));
+  ASSERT_TRUE(pieces.empty());
+}
+
+TEST(ConvexTest, MergesTrianglesAcrossSharedEdges)
+{
+  // a hexagon as triangles from one of its vertices is a single piece
+  const geometry::polygon2 hexagon = regular(6, glm::vec2(1, 2), 1.0f, 0.3f);
+  std::vector<geometry::polygon2> pieces;
+  for (size_t i = 1; i + 1 < hexagon.size(); ++i) pieces.push_back({ hexagon[0], hexagon[i], hexagon[i + 1] });
+  geometry::merge_convex(pieces);
+  ASSERT_EQ(1u, pieces.size());
+  ASSERT_TRUE(is_convex(pieces[0]));
+  ASSERT_EQ(6u, pieces[0].size());
+  ASSERT_NEAR(area(hexagon), area(pieces[0]), 1e-5f);
+
+  // triangles that overlap, or only share a corner, stay apart
+  pieces = { { { 0, 0 }, { 1, 0 }, { 0, 1 } }, { { 0, 0 }, { 1, 0 }, { 0, 1 } }, { { 1, 0 }, { 2, 0 }, { 2, 1 } } };
+  geometry::merge_convex(pieces);
+  ASSERT_EQ(3u, pieces.size());
+
+  // so do pieces along two edges of a straight line, which would repeat
+  // a vertex
+  pieces = { { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 1, 1 } }, { { 2, 0 }, { 1, 0 }, { 0, 0 }, { 1, -1 } } };
+  geometry::merge_convex(pieces);
+  ASSERT_EQ(2u, pieces.size());
+  for (const auto& piece : pieces) ASSERT_EQ(4u, piece.size());
+}
+
+TEST(ConvexTest, ProjectionMatchesTheScalarLoop)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+  for (size_t n = 1; n < 20; ++n) {
+    std::vector<glm::vec2> points(n);
+    for (auto& p : points) p = glm::vec2(coord(rng), coord(rng));
+    const glm::vec2 axis = glm::normalize(glm::vec2(coord(rng), coord(rng)));
+
+    float min, max;
+    geometry::project(points.data(), n, axis, min, max);
+    float expected_min = points[0].x * axis.x + points[0].y * axis.y, expected_max = expected_min;
+    for (const auto& p : points) {
+      expected_min = std::min(expected_min, p.x * axis.x + p.y * axis.y);
+      expected_max = std::max(expected_max, p.x * axis.x + p.y * axis.y);
+    }
+    ASSERT_EQ(expected_min, min) << n;
+    ASSERT_EQ(expected_max, max) << n;
+  }
+}
+
+TEST(ConvexTest, MinimumTranslationSeparates)
+{
+  const geometry::polygon2 a = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+  geometry::polygon2 b = a;
+  for (auto& p : b) p += glm::vec2(0.75f, 0.1f);
+
+  glm::vec2 mtv;
+  int axis = -1;
+  ASSERT_TRUE(geometry::collide_convex(a.data(), a.size(), b.data(), b.size(), mtv, axis));
+  ASSERT_NEAR(-0.25f, mtv.x, 1e-6f);
+  ASSERT_NEAR(0.0f, mtv.y, 1e-6f);
+
+  // touching is apart, and the separating axis is kept for next time
+  geometry::polygon2 moved = a;
+  for (auto& p : moved) p += mtv;
+  ASSERT_FALSE(geometry::collide_convex(moved.data(), moved.size(), b.data(), b.size(), mtv, axis));
+  ASSERT_LE(0, axis);
+  const int separating = axis;
+  ASSERT_FALSE(geometry::collide_convex(moved.data(), moved.size(), b.data(), b.size(), mtv, axis));
+  ASSERT_EQ(separating, axis);
+}
+
+TEST(ConvexTest, AgreesWithEdgeIntersections)
+{
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 0.6f);
+  std::uniform_int_distribution<int> sides(3, 9);
+  int hits = 0;
+  for (int test = 0; test < 500; ++test) {
+    const geometry::polygon2 a = regular(sides(rng), glm::vec2(coord(rng), coord(rng)), radius(rng), coord(rng));
+    const geometry::polygon2 b = regular(sides(rng), glm::vec2(coord(rng), coord(rng)), radius(rng), coord(rng));
+
+    bool expected = contains(a, b[0]) || contains(b, a[0]);
+    glm::vec2 p;
+    for (size_t i = 0; i < a.size() && !expected; ++i) {
+      for (size_t j = 0; j < b.size() && !expected; ++j) {
+        expected = geometry::intersect_seg_seg(a[i], a[(i + 1) % a.size()], b[j], b[(j + 1) % b.size()], p);
+      }
+    }
+
+    glm::vec2 mtv;
+    int axis = -1;
+    ASSERT_EQ(expected, geometry::collide_convex(a.data(), a.size(), b.data(), b.size(), mtv, axis)) << test;
+    if (!expected) continue;
+    ++hits;
+    // pushed out a little further, they are apart
+    geometry::polygon2 moved = a;
+    for (auto& v : moved) v += 1.001f * mtv;
+    ASSERT_FALSE(geometry::collide_convex(moved.data(), moved.size(), b.data(), b.size(), mtv, axis)) << test;
+  }
+  ASSERT_LT(50, hits);
+}
+
+TEST(ConvexTest, SatCacheKeepsAnAxisPerPair)
+{
+  geometry::SatCache cache;
+  int a = 0, b = 0;
+  ASSERT_EQ(-1, cache.axis(&a, 0, &b, 0));
+  cache.axis(&a, 0, &b, 0) = 3;
+  cache.axis(&a, 1, &b, 0) = 5;
+  ASSERT_EQ(3, cache.axis(&a, 0, &b, 0));
+  ASSERT_EQ(5, cache.axis(&a, 1, &b, 0));
+  ASSERT_EQ(-1, cache.axis(&b, 0, &a, 0));
+  ASSERT_EQ(3u, cache.size());
+  cache.clear();
+  ASSERT_EQ(0u, cache.size());
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "DrawList.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+class DrawListTest : public ::testing::Test
+{
+public:
+  DrawListTest()
+    : view_min(-1, -1), view_max(1, 1), width(200), height(200)
+  {}
+
+  void build(DrawList& draw_list)
+  {
+    draw_list.build(particles, constraints, view_min, view_max, width, height);
+  }
+
+  const glm::vec2 view_min;
+  const glm::vec2 view_max;
+  const int width;
+  const int height;
+  std::vector<glm::vec2> particles;
+  std::vector<Constraint> constraints;
+};
+
+TEST_F(DrawListTest, CullsOutsideView)
+{
+  particles = { { 0.5f, 0.5f }, { 1.5f, 0.0f }, { 0.0f, -3.0f }, { -0.5f, 0.25f } };
+  DrawList draw_list;
+  build(draw_list);
+  ASSERT_EQ(2u, draw_list.points().size());
+}
+
+TEST_F(DrawListTest, CullsFarOutsideAZoomedView)
+{
+  // pixel coordinates past the range of int, and NaN
+  particles = { { 0.5f, 0.5f }, { 1e30f, 0.5f }, { 0.5f, -1e30f }, { std::nan(""), 0.5f }, { 0.5f + 1e-6f, 0.5f } };
+  constraints = { Constraint(0, 1, 1e30f), Constraint(1, 2, 1e30f) };
+  DrawList draw_list;
+  draw_list.build(particles, constraints, { 0.5f - 1e-5f, 0.5f - 1e-5f }, { 0.5f + 1e-5f, 0.5f + 1e-5f }, width, height);
+  ASSERT_EQ(2u, draw_list.points().size());
+  // the bounds of both lines meet the view
+  ASSERT_EQ(4u, draw_list.lines().size());
+}
+
+TEST_F(DrawListTest, SparseTilesKeepParticles)
+{
+  particles = { { 0.5f, 0.5f }, { 0.51f, 0.5f }, { -0.5f, 0.25f } };
+  DrawList draw_list;
+  build(draw_list);
+  ASSERT_EQ(3u, draw_list.points().size());
+  for (const auto& p : particles) {
+    ASSERT_NE(draw_list.points().end(), std::find(draw_list.points().begin(), draw_list.points().end(), p));
+  }
+}
+
+TEST_F(DrawListTest, DenseTileIsAggregated)
+{
+  // 10000 particles over 2x2 pixels
+  for (int i = 0; i < 10000; ++i) {
+    particles.push_back({ 0.019f * std::rand() / RAND_MAX, 0.019f * std::rand() / RAND_MAX });
+  }
+  DrawList draw_list;
+  build(draw_list);
+  ASSERT_GE(4u, draw_list.points().size());
+  ASSERT_LT(0u, draw_list.points().size());
+}
+
+TEST_F(DrawListTest, CullsLines)
+{
+  particles = { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 2.0f, 2.0f }, { 3.0f, 2.0f }, { 0.001f, 0.001f } };
+  constraints = { Constraint(0, 1, 0.5f), Constraint(2, 3, 1.0f), Constraint(1, 2, 2.0f), Constraint(0, 4, 0.0f) };
+  DrawList draw_list;
+  build(draw_list);
+  // (2, 3) is off-screen and (0, 4) is sub-pixel
+  ASSERT_EQ(4u, draw_list.lines().size());
+}
+
+TEST_F(DrawListTest, ParallelMatchesSerial)
+{
+  for (int i = 0; i < 100000; ++i) {
+    particles.push_back({ 3.0f * std::rand() / RAND_MAX - 1.5f, 0.3f * std::rand() / RAND_MAX });
+  }
+  for (int i = 0; i + 1 < 100000; i += 2) {
+    constraints.push_back(Constraint(i, i + 1, 0.0f));
+  }
+
+  ThreadPool serial(1), parallel(4);
+  DrawList serial_list(serial), parallel_list(parallel);
+  build(serial_list);
+  build(parallel_list);
+  ASSERT_EQ(serial_list.points(), parallel_list.points());
+  ASSERT_EQ(serial_list.lines(), parallel_list.lines());
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <iostream>
+
+// A headless GL 3.3 core context through EGL, Mesa's llvmpipe on a machine
+// without a GPU, current on the creating thread. Tests that need GL pass
+// without running when there is none (see has_context()).
+class EglContext
+{
+public:
+  EglContext()
+    : _display(EGL_NO_DISPLAY), _context(EGL_NO_CONTEXT), _framebuffer(0), _renderbuffer(0)
+  {
+    // surfaceless when available, so that no display server is needed
+    typedef EGLDisplay (*GetPlatformDisplay)(EGLenum, void*, const EGLint*);
+    GetPlatformDisplay get_platform_display = (GetPlatformDisplay)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) _display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (_display == EGL_NO_DISPLAY) _display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API)) {
+      return;
+    }
+
+    const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+    };
+    _context = eglCreateContext(_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+    if (_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context) ||
+        !gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+      _context = EGL_NO_CONTEXT;
+      return;
+    }
+
+    // drawing, even with the rasterizer off, wants a complete framebuffer,
+    // and a surfaceless context has none
+    glGenRenderbuffers(1, &_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _renderbuffer);
+    glViewport(0, 0, 1, 1);
+  }
+
+  EglContext(const EglContext&) = delete;
+  EglContext& operator=(const EglContext&) = delete;
+
+  ~EglContext()
+  {
+    if (_context != EGL_NO_CONTEXT) {
+      glDeleteFramebuffers(1, &_framebuffer);
+      glDeleteRenderbuffers(1, &_renderbuffer);
+      eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      eglDestroyContext(_display, _context);
+    }
+    if (_display != EGL_NO_DISPLAY) eglTerminate(_display);
+  }
+
+  // the bundled gtest has no GTEST_SKIP
+  bool has_context() const
+  {
+    if (_context == EGL_NO_CONTEXT) std::cout << "[  SKIPPED ] no GL 3.3 context through EGL" << std::endl;
+    return _context != EGL_NO_CONTEXT;
+  }
+
+private:
+  EGLDisplay _display;
+  EGLContext _context;
+  GLuint _framebuffer;
+  GLuint _renderbuffer;
+};
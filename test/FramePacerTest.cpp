@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "FramePacer.hpp"
+
+TEST(FramePacerTest, DoesNotSleepWithoutHistory)
+{
+  FramePacer pacer;
+  pacer.set_refresh_period(0.016);
+  ASSERT_DOUBLE_EQ(1.0, pacer.wake_time(1.0));
+}
+
+TEST(FramePacerTest, WakesARenderTimeBeforeVsync)
+{
+  FramePacer pacer;
+  pacer.set_refresh_period(0.016);
+  pacer.set_margin(0.001);
+  for (int i = 0; i < 10; ++i) pacer.add_render_time(0.004);
+  ASSERT_NEAR(0.004, pacer.render_time(), 1e-12);
+  ASSERT_NEAR(1.011, pacer.wake_time(1.0), 1e-9);
+}
+
+TEST(FramePacerTest, RenderTimeIgnoresRareSpikes)
+{
+  FramePacer pacer;
+  for (size_t i = 0; i < FramePacer::HISTORY; ++i) pacer.add_render_time(i % 20 == 0 ? 0.050 : 0.002);
+  ASSERT_DOUBLE_EQ(0.002, pacer.render_time());
+  // but not frequent ones
+  for (size_t i = 0; i < FramePacer::HISTORY; ++i) pacer.add_render_time(i % 5 == 0 ? 0.050 : 0.002);
+  ASSERT_DOUBLE_EQ(0.050, pacer.render_time());
+}
+
+TEST(FramePacerTest, SlowFramesDoNotSleep)
+{
+  FramePacer pacer;
+  pacer.set_refresh_period(0.016);
+  for (int i = 0; i < 10; ++i) pacer.add_render_time(0.030);
+  ASSERT_DOUBLE_EQ(1.0, pacer.wake_time(1.0));
+}
+
+TEST(FramePacerTest, AveragesRecentLatencies)
+{
+  FramePacer pacer;
+  ASSERT_EQ(0, pacer.latency());
+  for (size_t i = 0; i < FramePacer::HISTORY; ++i) pacer.add_latency(0.100);
+  for (size_t i = 0; i < FramePacer::HISTORY; ++i) pacer.add_latency(0.010);
+  ASSERT_NEAR(0.010, pacer.latency(), 1e-12);
+}
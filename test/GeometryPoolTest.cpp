@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include "GeometryPool.hpp"
+#include "Shader.hpp"
+#include "EglContext.hpp"
+#include <memory>
+#include <stdexcept>
+
+namespace {
+  typedef GeometryPool<vertex::layout<vertex::float2>> PointPool;
+
+  const char* CAPTURE_GLSL = R"(#version 330 core
+layout (location = 0) in vec2 position;
+out vec2 out_position;
+void main()
+{
+    out_position = position;
+}
+)";
+}
+
+class GeometryPoolTest : public ::testing::Test
+{
+public:
+  static void SetUpTestCase() { s_gl.reset(new EglContext()); }
+  static void TearDownTestCase() { s_gl.reset(); }
+  static bool has_context() { return s_gl->has_context(); }
+
+  // shape k as n points (k, i), told apart once drawn
+  static std::vector<PointPool::Vertex> make_points(int k, int n)
+  {
+    std::vector<PointPool::Vertex> vertices(n);
+    for (int i = 0; i < n; ++i) {
+      vertices[i].head.set(0, (float)k);
+      vertices[i].head.set(1, (float)i);
+    }
+    return vertices;
+  }
+
+  // the vertices one draw() submits, in order, caught by transform feedback
+  static std::vector<glm::vec2> drawn(const PointPool& pool)
+  {
+    Shader capture("GeometryPoolTest::capture", CAPTURE_GLSL, { "out_position" });
+    GLuint buffer, query;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, pool.capacity() * sizeof(glm::vec2), nullptr, GL_STATIC_READ);
+    glGenQueries(1, &query);
+
+    capture.attach();
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+    glBeginTransformFeedback(GL_POINTS);
+    pool.draw();
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glDisable(GL_RASTERIZER_DISCARD);
+    capture.detach();
+
+    GLuint count = 0;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &count);
+    std::vector<glm::vec2> vertices(count);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
+    if (count) glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, count * sizeof(glm::vec2), vertices.data());
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDeleteQueries(1, &query);
+    glDeleteBuffers(1, &buffer);
+    return vertices;
+  }
+
+  // the points of shapes (k, n), one after the other
+  static std::vector<glm::vec2> expected(const std::vector<std::pair<int, int>>& shapes)
+  {
+    std::vector<glm::vec2> vertices;
+    for (const auto& shape : shapes) {
+      for (int i = 0; i < shape.second; ++i) vertices.push_back(glm::vec2(shape.first, i));
+    }
+    return vertices;
+  }
+
+  static std::unique_ptr<EglContext> s_gl;
+};
+
+std::unique_ptr<EglContext> GeometryPoolTest::s_gl;
+
+TEST_F(GeometryPoolTest, GrowingKeepsTheShapes)
+{
+  if (!has_context()) return;
+
+  PointPool pool(GL_POINTS, 4);
+  ASSERT_EQ(4u, pool.capacity());
+  ASSERT_TRUE(drawn(pool).empty());
+  // each new buffer gets a copy of the old one
+  std::vector<std::pair<int, int>> shapes;
+  for (int k = 0; k < 5; ++k) {
+    pool.add(make_points(k, 3));
+    shapes.push_back(std::make_pair(k, 3));
+    ASSERT_EQ(expected(shapes), drawn(pool)) << k;
+  }
+  ASSERT_EQ(5u, pool.nb_shapes());
+  ASSERT_EQ(16u, pool.capacity());
+  // larger than twice the capacity at once
+  pool.add(make_points(5, 40));
+  shapes.push_back(std::make_pair(5, 40));
+  ASSERT_EQ(56u, pool.capacity());
+  ASSERT_EQ(expected(shapes), drawn(pool));
+}
+
+TEST_F(GeometryPoolTest, RemovedRangesAreReused)
+{
+  if (!has_context()) return;
+
+  PointPool pool(GL_POINTS, 16);
+  const int a = pool.add(make_points(0, 3));
+  const int b = pool.add(make_points(1, 4));
+  pool.add(make_points(2, 3));
+  pool.remove(b);
+  ASSERT_EQ(2u, pool.nb_shapes());
+  ASSERT_FALSE(pool.is_visible(b));
+  ASSERT_THROW(pool.remove(b), std::runtime_error);
+  ASSERT_EQ(expected({ { 0, 3 }, { 2, 3 } }), drawn(pool));
+
+  // the hole left by b fits d, its id too; e goes after the last shape
+  const int d = pool.add(make_points(3, 2));
+  ASSERT_EQ(b, d);
+  pool.add(make_points(4, 3));
+  ASSERT_EQ(16u, pool.capacity());
+  // by position in the buffer, not by id or order of addition
+  ASSERT_EQ(expected({ { 0, 3 }, { 3, 2 }, { 2, 3 }, { 4, 3 } }), drawn(pool));
+
+  pool.remove(a);
+  pool.add(make_points(5, 3));
+  ASSERT_EQ(expected({ { 5, 3 }, { 3, 2 }, { 2, 3 }, { 4, 3 } }), drawn(pool));
+  ASSERT_THROW(pool.add(std::vector<PointPool::Vertex>()), std::runtime_error);
+}
+
+TEST_F(GeometryPoolTest, HiddenShapesAreLeftOut)
+{
+  if (!has_context()) return;
+
+  PointPool pool(GL_POINTS, 16);
+  pool.add(make_points(0, 2));
+  const int b = pool.add(make_points(1, 3));
+  pool.add(make_points(2, 2));
+  pool.set_visible(b, false);
+  ASSERT_FALSE(pool.is_visible(b));
+  ASSERT_EQ(expected({ { 0, 2 }, { 2, 2 } }), drawn(pool));
+  pool.set_visible(b, true);
+  ASSERT_EQ(expected({ { 0, 2 }, { 1, 3 }, { 2, 2 } }), drawn(pool));
+  for (int k = 0; k < 3; ++k) pool.set_visible(k, false);
+  ASSERT_TRUE(drawn(pool).empty());
+}
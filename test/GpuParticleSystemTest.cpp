@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "GpuParticleSystem.hpp"
+#include "ParticleSystem.hpp"
+#include "EglContext.hpp"
+#include <memory>
+#include <random>
+
+class GpuParticleSystemTest : public ::testing::Test
+{
+public:
+  static void SetUpTestCase() { s_gl.reset(new EglContext()); }
+  static void TearDownTestCase() { s_gl.reset(); }
+  static bool has_context() { return s_gl->has_context(); }
+
+  static std::unique_ptr<EglContext> s_gl;
+};
+
+std::unique_ptr<EglContext> GpuParticleSystemTest::s_gl;
+
+TEST_F(GpuParticleSystemTest, MatchesTheCpuIntegration)
+{
+  if (!has_context()) return;
+
+  // falling and sliding into the walls of the box
+  const glm::vec2 min(-1, -1), max(1, 1), gravity(1.5f, -4.81f);
+  ParticleSystem cpu(min, max);
+  GpuParticleSystem gpu(min, max, 16);
+  cpu.set_gravity(gravity);
+  gpu.set_gravity(gravity);
+  cpu.set_sleep_threshold(0, 1 << 30);
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(-1, 1);
+  std::vector<glm::vec2> positions(1000);
+  for (auto& p : positions) p = glm::vec2(coord(rng), coord(rng));
+  for (const auto& p : positions) cpu.add_particle(p);
+  gpu.add_particles(positions);
+  cpu.add_particle({ 0.5f, 0.5f }, 0.0f);
+  gpu.add_particle({ 0.5f, 0.5f }, 0.0f);
+  ASSERT_LE(cpu.nb_particles(), gpu.capacity());
+
+  for (int s = 0; s < 300; ++s) {
+    cpu.step();
+    gpu.step();
+  }
+
+  const std::vector<glm::vec2>& p = gpu.read_particles();
+  ASSERT_EQ(cpu.nb_particles(), p.size());
+  // llvmpipe matches bit for bit; GPUs that fuse the multiply-add may not
+  int on_floor = 0;
+  for (size_t i = 0; i < p.size(); ++i) {
+    ASSERT_NEAR(cpu.particles()[i].x, p[i].x, 1e-5f) << i;
+    ASSERT_NEAR(cpu.particles()[i].y, p[i].y, 1e-5f) << i;
+    on_floor += (p[i].y == min.y);
+  }
+  ASSERT_GT(on_floor, 0);
+  ASSERT_EQ(glm::vec2(0.5f, 0.5f), p.back());
+}
+
+TEST_F(GpuParticleSystemTest, PicksFromAReadback)
+{
+  if (!has_context()) return;
+
+  GpuParticleSystem gpu({ -1, -1 }, { 1, 1 });
+  gpu.set_gravity({ 0, 0 });
+  gpu.add_particle({ 0.0f, 0.0f });
+  gpu.add_particle({ 0.5f, 0.0f });
+  gpu.step();
+  ASSERT_EQ(1, gpu.pick({ 0.4f, 0.0f }, 0.2f));
+  ASSERT_EQ(-1, gpu.pick({ 0.25f, 0.5f }, 0.2f));
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "LightRenderer.hpp"
+#include "EglContext.hpp"
+#include <cmath>
+#include <memory>
+
+class LightRendererTest : public ::testing::Test
+{
+public:
+  static void SetUpTestCase() { s_gl.reset(new EglContext()); }
+  static void TearDownTestCase() { s_gl.reset(); }
+  static bool has_context() { return s_gl->has_context(); }
+
+  // the shadow map entry at angle
+  static float at(const std::vector<float>& map, float angle)
+  {
+    const int n = (int)map.size();
+    return map[(int)std::floor((angle + M_PI) / (2 * M_PI) * n) % n];
+  }
+
+  static std::unique_ptr<EglContext> s_gl;
+};
+
+std::unique_ptr<EglContext> LightRendererTest::s_gl;
+
+TEST_F(LightRendererTest, ShadowMapHoldsTheNearestOccluder)
+{
+  if (!has_context()) return;
+
+  LightRenderer lights(360);
+  lights.set_lights({ { { 0, 0 }, { 1, 1, 1, 1 }, 2.0f } });
+  // a wall in front of another one to the right, and a wall to the left
+  // across the angle -pi == pi
+  lights.set_occluders(std::vector<geometry::segment2>{
+    { { 0.5f, -0.5f }, { 0.5f, 0.5f } },
+    { { 1.0f, -0.25f }, { 1.0f, 0.25f } },
+    { { -0.5f, -0.5f }, { -0.5f, 0.5f } }
+  });
+  lights.render_shadows();
+  const std::vector<float> map = lights.read_shadow_map(0);
+  ASSERT_EQ(360u, map.size());
+
+  for (float a = -0.7f; a <= 0.7f; a += 0.1f) {
+    ASSERT_NEAR(0.5f / std::cos(a), at(map, a), 0.01f) << a;
+  }
+  ASSERT_NEAR(0.5f, at(map, (float)M_PI - 0.01f), 0.01f);
+  ASSERT_NEAR(0.5f, at(map, (float)-M_PI + 0.01f), 0.01f);
+  ASSERT_NEAR(2.0f, at(map, (float)M_PI / 2), 1e-6f);
+  ASSERT_NEAR(2.0f, at(map, (float)-M_PI / 2), 1e-6f);
+}
+
+TEST_F(LightRendererTest, LightsHaveTheirOwnRows)
+{
+  if (!has_context()) return;
+
+  LightRenderer lights(256);
+  std::vector<Light> many;
+  for (int i = 0; i < LightRenderer::MAX_LIGHTS; ++i) {
+    many.push_back({ { 0.0f, -0.01f * i }, { 1, 1, 1, 1 }, 4.0f });
+  }
+  lights.set_lights(many);
+  lights.set_occluders(std::vector<geometry::segment2>{ { { -1.0f, 1.0f }, { 1.0f, 1.0f } } });
+  lights.render_shadows();
+
+  for (int i = 0; i < LightRenderer::MAX_LIGHTS; i += 9) {
+    const std::vector<float> map = lights.read_shadow_map(i);
+    ASSERT_NEAR(1.0f + 0.01f * i, at(map, (float)M_PI / 2), 1e-3f) << i;
+    ASSERT_NEAR(4.0f, at(map, (float)-M_PI / 2), 1e-6f) << i;
+  }
+  ASSERT_THROW(lights.set_lights(std::vector<Light>(LightRenderer::MAX_LIGHTS + 1)), std::runtime_error);
+}
+
+TEST_F(LightRendererTest, OccludersCastShadows)
+{
+  if (!has_context()) return;
+
+  const int size = 64;
+  GLuint renderbuffer, framebuffer;
+  GLint previous;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+  glGenRenderbuffers(1, &renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA32F, size, size);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+  glViewport(0, 0, size, size);
+
+  // a light on the left of a wall down the middle of [-1, 1]^2
+  LightRenderer lights;
+  lights.set_lights({ { { -0.5f, 0.0f }, { 1, 1, 1, 1 }, 3.0f } });
+  lights.set_occluders(std::vector<glm::vec2>{ { 0.0f, -1.0f }, { 0.0f, 1.0f } });
+  lights.render_shadows();
+  lights.render_light({ -1, -1 }, { 1, 1 });
+
+  std::vector<glm::vec4> pixels(size * size);
+  glReadPixels(0, 0, size, size, GL_RGBA, GL_FLOAT, pixels.data());
+  for (int y = 0; y < size; ++y) {
+    ASSERT_GT(pixels[y * size + size / 4].x, 0.1f) << y;
+    ASSERT_EQ(0.0f, pixels[y * size + 3 * size / 4].x) << y;
+  }
+  // brighter near the light
+  ASSERT_GT(pixels[size / 2 * size + size / 4].x, pixels[size / 2 * size + 1].x);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, previous);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &renderbuffer);
+}
@@ -0,0 +1,472 @@
+#include <gtest/gtest.h>
+#include "ParticleSystem.hpp"
+#include "Scenes.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+class ParticleSystemTest : public ::testing::Test
+{
+public:
+  ParticleSystemTest()
+    : ps({ -10, -10 }, { 10, 10 })
+  {}
+
+  void run(int steps)
+  {
+    for (int i = 0; i < steps; ++i) ps.step();
+  }
+
+  float distance(int a, int b) const
+  {
+    return glm::distance(ps.particles()[a], ps.particles()[b]);
+  }
+
+  ParticleSystem ps;
+};
+
+TEST_F(ParticleSystemTest, PinnedParticleStays)
+{
+  ps.add_particle({ 1, 2 }, 0.0f);
+  ps.add_particle({ 1, 1 });
+  ps.add_constraint(Constraint(0, 1, 1.0f));
+  run(500);
+  ASSERT_EQ(glm::vec2(1, 2), ps.particles()[0]);
+}
+
+TEST_F(ParticleSystemTest, DistanceConstraintHolds)
+{
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 0.5f, 0 });
+  ps.add_constraint(Constraint(0, 1, 0.5f));
+  run(500);
+  ASSERT_NEAR(0.5f, distance(0, 1), 0.01f);
+}
+
+TEST_F(ParticleSystemTest, RopeIsSlackThenTaut)
+{
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 0, -0.1f });
+  ps.add_constraint(RopeConstraint(0, 1, 0.0f, 1.0f));
+  run(50);
+  ASSERT_LT(distance(0, 1), 0.5f);
+  run(2000);
+  ASSERT_NEAR(1.0f, distance(0, 1), 0.01f);
+}
+
+TEST_F(ParticleSystemTest, AngleConstraintHolds)
+{
+  const float half_pi = 1.57079632679f;
+  ps.add_particle({ 1, 0 }, 0.0f);
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 0, 1 });
+  ps.add_constraint(Constraint(1, 2, 1.0f));
+  ps.add_constraint(AngleConstraint(0, 1, 2, half_pi));
+  run(500);
+  const glm::vec2 p = ps.particles()[2];
+  ASSERT_NEAR(half_pi, std::atan2(p.y, p.x), 0.05f);
+}
+
+TEST_F(ParticleSystemTest, AreaConstraintHolds)
+{
+  ps.add_particle({ -1, 0 }, 0.0f);
+  ps.add_particle({ 1, 0 }, 0.0f);
+  ps.add_particle({ 0, -1 });
+  // clockwise triangle, negative signed area
+  ps.add_constraint(AreaConstraint(0, 1, 2, -1.0f));
+  run(500);
+  ASSERT_NEAR(-1.0f, ps.particles()[2].y, 0.05f);
+}
+
+TEST_F(ParticleSystemTest, SettledIslandFallsAsleep)
+{
+  ParticleSystem box({ -1, -1 }, { 1, 1 });
+  box.set_sleep_threshold(1e-6f, 10);
+  box.add_particle({ 0, -0.9f });
+  box.add_particle({ 0.1f, -0.9f });
+  box.add_constraint(Constraint(0, 1, 0.1f));
+  box.add_particle({ 0.5f, 0.5f }, 0.0f);
+  box.add_particle({ 0.5f, 0.3f });
+  box.add_constraint(Constraint(2, 3, 0.2f));
+
+  box.step();
+  ASSERT_EQ(4u, box.nb_active_particles());
+  for (int i = 0; i < 2000; ++i) box.step();
+  ASSERT_EQ(0u, box.nb_active_particles());
+
+  const glm::vec2 resting = box.particles()[3];
+  box.add_force(3, { 100.0f, 0.0f });
+  box.step();
+  ASSERT_EQ(2u, box.nb_active_particles());
+  ASSERT_NE(resting, box.particles()[3]);
+}
+
+namespace {
+  int bandwidth(const std::vector<Constraint>& constraints)
+  {
+    int b = 0;
+    for (const auto& c : constraints) b = std::max(b, std::abs(c.second - c.first));
+    return b;
+  }
+
+  float mean_span(const std::vector<Constraint>& constraints)
+  {
+    float sum = 0;
+    for (const auto& c : constraints) sum += std::abs(c.second - c.first);
+    return sum / constraints.size();
+  }
+}
+
+TEST_F(ParticleSystemTest, ReorderKeepsExternalIndices)
+{
+  scenes::make_shuffled_cloth(ps, 16, false);
+  const std::vector<glm::vec2> before = ps.particles();
+  std::vector<std::pair<glm::vec2, glm::vec2>> segments;
+  for (const auto& c : ps.constraints()) segments.push_back({ before[c.first], before[c.second] });
+
+  const ParticleSystem::Ordering orderings[] = { ParticleSystem::MORTON, ParticleSystem::HILBERT, ParticleSystem::CUTHILL_MCKEE };
+  for (const auto ordering : orderings) {
+    ps.reorder(ordering);
+    for (int i = 0; i < 256; ++i) {
+      ASSERT_EQ(i, ps.external_index(ps.internal_index(i)));
+      ASSERT_EQ(before[i], ps.particles()[ps.internal_index(i)]);
+    }
+    // same constraints, now sorted by their first particle
+    ASSERT_EQ(segments.size(), ps.constraints().size());
+    for (size_t k = 0; k < ps.constraints().size(); ++k) {
+      const Constraint& c = ps.constraints()[k];
+      ASSERT_LT(c.first, c.second);
+      if (k > 0) {
+        ASSERT_LE(ps.constraints()[k - 1].first, c.first);
+      }
+      const auto s = std::make_pair(ps.particles()[c.first], ps.particles()[c.second]);
+      const auto r = std::make_pair(s.second, s.first);
+      ASSERT_TRUE(std::find(segments.begin(), segments.end(), s) != segments.end() ||
+                  std::find(segments.begin(), segments.end(), r) != segments.end());
+    }
+  }
+
+  // the API still takes the original indices
+  ps.set_inv_mass(5, 0.0f);
+  ASSERT_EQ(0.0f, ps.inv_masses()[ps.internal_index(5)]);
+  run(100);
+  ASSERT_EQ(before[5], ps.particles()[ps.internal_index(5)]);
+}
+
+TEST_F(ParticleSystemTest, ReorderShrinksBandwidth)
+{
+  scenes::make_shuffled_cloth(ps, 32, false);
+  const float shuffled = mean_span(ps.constraints());
+  // space-filling curves keep most neighbours close, not all of them
+  ps.reorder(ParticleSystem::MORTON);
+  ASSERT_LT(mean_span(ps.constraints()) * 10, shuffled);
+  ps.reorder(ParticleSystem::HILBERT);
+  ASSERT_LT(mean_span(ps.constraints()) * 10, shuffled);
+  ps.reorder(ParticleSystem::CUTHILL_MCKEE);
+  // a breadth-first front of an n x n grid is at most about 2n wide
+  ASSERT_GE(2 * 32 + 1, bandwidth(ps.constraints()));
+}
+
+TEST_F(ParticleSystemTest, RemovedHandleGoesStale)
+{
+  const ParticleHandle a = ps.add_particle({ 1, 0 });
+  const ParticleHandle b = ps.add_particle({ 2, 0 });
+  const ParticleHandle c = ps.add_particle({ 3, 0 });
+  ps.remove_particle(a);
+  ASSERT_FALSE(ps.is_alive(a));
+  ASSERT_EQ(-1, ps.internal_index(a));
+  ASSERT_EQ(2u, ps.nb_particles());
+  ASSERT_EQ(glm::vec2(2, 0), ps.particles()[ps.internal_index(b)]);
+  ASSERT_EQ(glm::vec2(3, 0), ps.particles()[ps.internal_index(c)]);
+
+  // the slot is reused with a new generation
+  const ParticleHandle d = ps.add_particle({ 4, 0 });
+  ASSERT_EQ(a.slot, d.slot);
+  ASSERT_FALSE(ps.is_alive(a));
+  ASSERT_TRUE(ps.is_alive(d));
+  ps.remove_particle(a);
+  ASSERT_EQ(3u, ps.nb_particles());
+  ASSERT_EQ(glm::vec2(4, 0), ps.particles()[ps.internal_index(d)]);
+}
+
+TEST_F(ParticleSystemTest, RemovingDropsItsConstraints)
+{
+  std::vector<ParticleHandle> chain;
+  for (int i = 0; i < 5; ++i) chain.push_back(ps.add_particle({ 0.5f * i, 0 }, i == 0 ? 0.0f : 1.0f));
+  for (int i = 0; i + 1 < 5; ++i) ps.add_constraint(Constraint(chain[i].slot, chain[i + 1].slot, 0.5f));
+  const ParticleHandle loose = ps.add_particle({ 5, 5 });
+
+  ps.remove_particle(chain[2]);
+  ASSERT_EQ(2u, ps.constraints().size());
+  for (const auto& c : ps.constraints()) {
+    ASSERT_NEAR(0.5f, glm::distance(ps.particles()[c.first], ps.particles()[c.second]), 1e-6f);
+  }
+  ASSERT_TRUE(ps.is_alive(loose));
+  ASSERT_EQ(glm::vec2(5, 5), ps.particles()[ps.internal_index(loose)]);
+
+  // what is left of the chain still hangs from its pinned end
+  run(500);
+  ASSERT_EQ(glm::vec2(0, 0), ps.particles()[ps.internal_index(chain[0])]);
+  ASSERT_NEAR(0.5f, glm::distance(ps.particles()[ps.internal_index(chain[0])],
+                                  ps.particles()[ps.internal_index(chain[1])]), 0.01f);
+}
+
+TEST_F(ParticleSystemTest, EmitterDoesNotReallocate)
+{
+  ps.reserve(10000);
+  const glm::vec2* data = ps.particles().data();
+  std::vector<std::vector<ParticleHandle>> batches(10);
+  for (int frame = 0; frame < 100; ++frame) {
+    std::vector<ParticleHandle>& batch = batches[frame % 10];
+    ps.remove_particles(batch);
+    batch.clear();
+    ps.add_particles(std::vector<glm::vec2>(500, glm::vec2(0.01f * frame, 0)), 1.0f, batch);
+    ps.step();
+  }
+  ASSERT_EQ(5000u, ps.nb_particles());
+  ASSERT_EQ(data, ps.particles().data());
+  for (const auto& batch : batches) {
+    for (const auto& h : batch) ASSERT_TRUE(ps.is_alive(h));
+  }
+}
+
+TEST_F(ParticleSystemTest, EmitterMatchesFullRebuilds)
+{
+  // a swinging chain among free particles that come, settle on the floor,
+  // fall asleep and go; the other system rebuilds its islands every frame
+  for (const auto solver : { ParticleSystem::GAUSS_SEIDEL, ParticleSystem::JACOBI }) {
+    ParticleSystem patched({ -1, -1 }, { 1, 1 }), rebuilt({ -1, -1 }, { 1, 1 });
+    std::vector<std::vector<ParticleHandle>> patched_batches(20), rebuilt_batches(20);
+    for (ParticleSystem* system : { &patched, &rebuilt }) {
+      system->set_solver(solver);
+      system->set_sleep_threshold(1e-3f, 10);
+      for (int i = 0; i < 8; ++i) system->add_particle({ 0.1f * i, 0.5f }, i == 0 ? 0.0f : 1.0f);
+      for (int i = 0; i + 1 < 8; ++i) system->add_constraint(Constraint(i, i + 1, 0.1f));
+    }
+    for (int frame = 0; frame < 200; ++frame) {
+      std::vector<glm::vec2> spawns;
+      for (int i = 0; i < 10; ++i) spawns.push_back(glm::vec2(-0.9f + 0.01f * (frame % 20) + 0.1f * i, -0.999f));
+      patched.remove_particles(patched_batches[frame % 20]);
+      rebuilt.remove_particles(rebuilt_batches[frame % 20]);
+      patched_batches[frame % 20].clear();
+      rebuilt_batches[frame % 20].clear();
+      patched.add_particles(spawns, 1.0f, patched_batches[frame % 20]);
+      rebuilt.add_particles(spawns, 1.0f, rebuilt_batches[frame % 20]);
+      if (frame % 50 == 49) {
+        patched.wake(patched_batches[(frame + 1) % 20][0].slot);
+        rebuilt.wake(rebuilt_batches[(frame + 1) % 20][0].slot);
+      }
+      rebuilt.set_solver(solver);
+      patched.step();
+      rebuilt.step();
+      ASSERT_EQ(rebuilt.nb_active_particles(), patched.nb_active_particles()) << frame;
+    }
+    ASSERT_GT(patched.nb_particles(), patched.nb_active_particles());
+    ASSERT_EQ(rebuilt.particles(), patched.particles());
+  }
+}
+
+TEST_F(ParticleSystemTest, ResidualsAreMeasured)
+{
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 2, 0 });
+  ps.add_constraint(Constraint(0, 1, 1.0f));
+  ps.step();
+  ASSERT_EQ(3, ps.metrics().iterations);
+  // stretched twice its length, the stretch clamp only recovers part of it in one step
+  ASSERT_LT(0.5f, ps.metrics().max_residual);
+  ASSERT_GT(1.0f, ps.metrics().max_residual);
+  ASSERT_FLOAT_EQ(ps.metrics().max_residual, ps.metrics().rms_residual);
+  ASSERT_LT(0.0f, ps.metrics().kinetic_energy);
+}
+
+TEST_F(ParticleSystemTest, IterationsFollowTheResidual)
+{
+  ps.set_solver_iterations(1, 50, 1e-3f);
+  ps.add_particle({ 0, 0 }, 0.0f);
+  for (int i = 1; i < 10; ++i) {
+    ps.add_particle({ 0.15f * i, 0 });
+    ps.add_constraint(Constraint(i - 1, i, 0.1f));
+  }
+
+  // a stretched chain takes every iteration it is allowed
+  ps.step();
+  ASSERT_EQ(50, ps.metrics().iterations);
+  ASSERT_LT(1e-3f, ps.metrics().max_residual);
+
+  // once hanging still, one iteration is enough
+  ps.set_gravity({ 0, 0 });
+  run(2000);
+  ASSERT_EQ(1, ps.metrics().iterations);
+  ASSERT_GE(1e-3f, ps.metrics().max_residual);
+  ASSERT_GE(ps.metrics().max_residual, ps.metrics().rms_residual);
+}
+
+TEST_F(ParticleSystemTest, EnergyIsTracked)
+{
+  ps.set_sleep_threshold(-1.0f, 1);
+  ps.add_particle({ 0, 0 });
+  ps.step();
+  const float total = ps.metrics().kinetic_energy + ps.metrics().potential_energy;
+  run(100);
+  ASSERT_LT(0.5f, ps.metrics().kinetic_energy);
+  // verlet conserves the energy of a free fall closely
+  ASSERT_NEAR(total, ps.metrics().kinetic_energy + ps.metrics().potential_energy, 0.05f);
+}
+
+namespace {
+  // n x n cloth at rest length 0.1, stretched by 1% along x, left column pinned
+  void make_stretched_cloth(ParticleSystem& ps, int n)
+  {
+    ps.set_gravity({ 0, 0 });
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) ps.add_particle({ 0.101f * x - 5, 0.1f * y - 5 }, x == 0 ? 0.0f : 1.0f);
+    }
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        if (x + 1 < n) ps.add_constraint(Constraint(y * n + x, y * n + x + 1, 0.1f));
+        if (y + 1 < n) ps.add_constraint(Constraint(y * n + x, (y + 1) * n + x, 0.1f));
+      }
+    }
+  }
+}
+
+TEST_F(ParticleSystemTest, JacobiHoldsADistanceConstraint)
+{
+  ps.set_solver(ParticleSystem::JACOBI);
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 0.5f, 0 });
+  ps.add_constraint(Constraint(0, 1, 0.5f));
+  run(500);
+  ASSERT_NEAR(0.5f, distance(0, 1), 0.01f);
+  ASSERT_EQ(glm::vec2(0, 0), ps.particles()[0]);
+}
+
+TEST_F(ParticleSystemTest, JacobiDoesNotDependOnThreads)
+{
+  ThreadPool one(1), four(4);
+  ParticleSystem a({ -10, -10 }, { 10, 10 }, one);
+  ParticleSystem b({ -10, -10 }, { 10, 10 }, four);
+  for (ParticleSystem* p : { &a, &b }) {
+    make_stretched_cloth(*p, 100);
+    p->set_gravity({ 0, -9.8f });
+    p->set_solver(ParticleSystem::JACOBI, 0.95f);
+    for (int i = 0; i < 20; ++i) p->step();
+  }
+  ASSERT_EQ(a.particles(), b.particles());
+  ASSERT_EQ(a.metrics().max_residual, b.metrics().max_residual);
+}
+
+TEST_F(ParticleSystemTest, ChebyshevConvergesFaster)
+{
+  int iterations[2];
+  for (int k = 0; k < 2; ++k) {
+    ParticleSystem cloth({ -10, -10 }, { 10, 10 });
+    make_stretched_cloth(cloth, 16);
+    cloth.set_solver(ParticleSystem::JACOBI, k == 0 ? 0.0f : 0.99f);
+    cloth.set_solver_iterations(1, 5000, 1e-3f);
+    cloth.step();
+    ASSERT_GE(1e-3f, cloth.metrics().max_residual);
+    iterations[k] = cloth.metrics().iterations;
+  }
+  ASSERT_LT(iterations[1], iterations[0] / 2);
+}
+
+TEST_F(ParticleSystemTest, PicksTheNearestParticle)
+{
+  const ParticleHandle a = ps.add_particle({ 0, 0 });
+  const ParticleHandle b = ps.add_particle({ 1, 0 });
+  // picks leave the cells as they are
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(b.slot, ps.pick({ 0.8f, 0.1f }, 0.5f).slot);
+    ASSERT_EQ(a.slot, ps.pick({ 0.5f, 0.0f }, 0.5f).slot);
+    ASSERT_FALSE(ps.is_alive(ps.pick({ 0.5f, 2.0f }, 0.5f)));
+  }
+
+  // the next pick sees where the particles moved
+  ps.set_gravity({ 0, 0 });
+  ps.add_force(a.slot, { 0, 1e4f });
+  run(10);
+  ASSERT_FALSE(ps.is_alive(ps.pick({ 0, 0 }, 0.1f)));
+  ASSERT_EQ(a.slot, ps.pick(ps.particles()[ps.internal_index(a)], 0.1f).slot);
+
+  ps.remove_particle(a);
+  ASSERT_FALSE(ps.is_alive(ps.pick(ps.particles()[0] + glm::vec2(0, 5), 0.1f)));
+  ASSERT_EQ(b.slot, ps.pick({ 1, 0 }, 0.1f).slot);
+}
+
+TEST_F(ParticleSystemTest, PicksMatchBruteForceWhileRunning)
+{
+  // particles spawned and removed among moving ones, picked between steps
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  std::vector<ParticleHandle> handles;
+  for (int i = 0; i < 2000; ++i) handles.push_back(ps.add_particle({ uniform(rng), uniform(rng) }));
+  ps.set_gravity({ 0, -0.5f });
+
+  for (int frame = 0; frame < 200; ++frame) {
+    ps.step();
+    glm::vec2 p(uniform(rng), uniform(rng));
+    if (frame % 5 == 0) {
+      const size_t k = (size_t)(rng() % handles.size());
+      ps.remove_particle(handles[k]);
+      handles.erase(handles.begin() + k);
+    }
+    // next to a spawned particle, whose cell no step has set yet
+    if (frame % 3 == 0) handles.push_back(ps.add_particle(p + glm::vec2(0.01f, 0)));
+    const float radius = (frame % 2 ? 0.02f : 0.2f);
+    int expected = -1;
+    float best = radius * radius;
+    for (size_t i = 0; i < ps.nb_particles(); ++i) {
+      const glm::vec2 d = ps.particles()[i] - p;
+      if (glm::dot(d, d) < best || (glm::dot(d, d) == best && expected < 0)) {
+        expected = (int)i;
+        best = glm::dot(d, d);
+      }
+    }
+    const ParticleHandle h = ps.pick(p, radius);
+    ASSERT_EQ(expected, ps.is_alive(h) ? ps.internal_index(h) : -1) << frame;
+  }
+}
+
+TEST_F(ParticleSystemTest, PicksOutsideTheBox)
+{
+  // particles outside the box share its border cells until a step clamps them
+  const ParticleHandle a = ps.add_particle({ 12, 0 });
+  const ParticleHandle b = ps.add_particle({ 9.99f, 0 });
+  const ParticleHandle c = ps.add_particle({ -10, -10 });
+  ASSERT_EQ(a.slot, ps.pick({ 11.5f, 0 }, 1.0f).slot);
+  ASSERT_EQ(b.slot, ps.pick({ 10.5f, 0 }, 1.0f).slot);
+  ASSERT_EQ(c.slot, ps.pick({ -30, -30 }, 30.0f).slot);
+  ASSERT_FALSE(ps.is_alive(ps.pick({ 11.5f, 5 }, 1.0f)));
+  // wider than the box
+  ASSERT_EQ(b.slot, ps.pick({ 0, 0 }, 100.0f).slot);
+}
+
+TEST_F(ParticleSystemTest, GrabbedParticleFollowsTheTarget)
+{
+  ps.add_particle({ 0, 0 }, 0.0f);
+  ps.add_particle({ 0, -0.5f });
+  ps.add_constraint(Constraint(0, 1, 0.5f));
+  run(1000);
+  ASSERT_EQ(0u, ps.nb_active_particles());
+
+  // a sleeping island wakes and stays awake while held
+  const ParticleHandle h = ps.pick({ 0, -0.45f }, 0.1f);
+  ps.grab(h, { 0.5f, 0 });
+  run(1000);
+  ASSERT_EQ(2u, ps.nb_active_particles());
+  ASSERT_NEAR(0.5f, ps.particles()[1].x, 0.01f);
+  ASSERT_NEAR(0.0f, ps.particles()[1].y, 0.01f);
+
+  ps.drag({ -0.5f, 0 });
+  run(1000);
+  ASSERT_NEAR(-0.5f, ps.particles()[1].x, 0.01f);
+
+  // it swings down once released
+  ps.release();
+  ASSERT_FALSE(ps.is_alive(ps.grabbed()));
+  run(50);
+  ASSERT_GT(-0.05f, ps.particles()[1].y);
+  ASSERT_NEAR(0.5f, distance(0, 1), 0.01f);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include "RangeAllocator.hpp"
+#include <random>
+#include <vector>
+
+TEST(RangeAllocatorTest, AllocatesUntilFull)
+{
+  RangeAllocator allocator(10);
+  ASSERT_EQ(0, allocator.allocate(4));
+  ASSERT_EQ(4, allocator.allocate(6));
+  ASSERT_EQ(-1, allocator.allocate(1));
+  ASSERT_EQ(0, allocator.nb_free());
+  allocator.grow(12);
+  ASSERT_EQ(10, allocator.allocate(2));
+}
+
+TEST(RangeAllocatorTest, PicksTheBestFit)
+{
+  RangeAllocator allocator(20);
+  const int a = allocator.allocate(5);
+  allocator.allocate(1);
+  const int b = allocator.allocate(2);
+  allocator.allocate(1);
+  allocator.free(a, 5);
+  allocator.free(b, 2);
+  // the 2-hole rather than the first or the tail
+  ASSERT_EQ(b, allocator.allocate(2));
+  ASSERT_EQ(a, allocator.allocate(4));
+}
+
+TEST(RangeAllocatorTest, MergesNeighbours)
+{
+  RangeAllocator allocator(9);
+  const int a = allocator.allocate(3);
+  const int b = allocator.allocate(3);
+  const int c = allocator.allocate(3);
+  allocator.free(a, 3);
+  allocator.free(c, 3);
+  ASSERT_EQ(2u, allocator.nb_free_ranges());
+  allocator.free(b, 3);
+  ASSERT_EQ(1u, allocator.nb_free_ranges());
+  ASSERT_EQ(0, allocator.allocate(9));
+}
+
+TEST(RangeAllocatorTest, RandomChurnKeepsRangesDisjoint)
+{
+  std::mt19937 rng(42);
+  RangeAllocator allocator(1000);
+  std::vector<std::pair<int, int>> live;
+  std::vector<int> owner(1000, -1);
+  for (int step = 0; step < 10000; ++step) {
+    if (!live.empty() && rng() % 2) {
+      const size_t k = rng() % live.size();
+      for (int i = 0; i < live[k].second; ++i) owner[live[k].first + i] = -1;
+      allocator.free(live[k].first, live[k].second);
+      live[k] = live.back();
+      live.pop_back();
+    } else {
+      const int count = 1 + rng() % 40;
+      const int first = allocator.allocate(count);
+      if (first < 0) continue;
+      for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(-1, owner[first + i]);
+        owner[first + i] = step;
+      }
+      live.push_back({ first, count });
+    }
+  }
+  for (const auto& r : live) allocator.free(r.first, r.second);
+  ASSERT_EQ(1000, allocator.nb_free());
+  ASSERT_EQ(1u, allocator.nb_free_ranges());
+}
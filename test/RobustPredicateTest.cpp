@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "Geometry.hpp"
+#include <cstdint>
+#include <random>
+
+// Reference predicates in exact rational arithmetic: every coordinate is
+// generated as k / 2^GRID_BITS with |k| < 2^COORD_BITS, so scaling by
+// 2^GRID_BITS turns them into integers whose products fit in 64 bits.
+namespace {
+  const int GRID_BITS = 10;
+  const int COORD_BITS = 20;
+
+  int64_t to_int(float x)
+  {
+    return (int64_t)std::ldexp((double)x, GRID_BITS);
+  }
+
+  int ref_orient2D(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+  {
+    const int64_t det = (to_int(a.x) - to_int(c.x)) * (to_int(b.y) - to_int(c.y))
+                      - (to_int(a.y) - to_int(c.y)) * (to_int(b.x) - to_int(c.x));
+    return (det > 0) - (det < 0);
+  }
+
+  bool ref_intersect_seg_seg(const glm::vec2& a, const glm::vec2& b,
+                             const glm::vec2& c, const glm::vec2& d)
+  {
+    const int o1 = ref_orient2D(a, b, c);
+    const int o2 = ref_orient2D(a, b, d);
+    if (o1 == 0 && o2 == 0) return false;
+    if (o1 == 0 && geometry::box_has_point(a, b, c)) return true;
+    if (o2 == 0 && geometry::box_has_point(a, b, d)) return true;
+    const int o3 = ref_orient2D(c, d, a);
+    const int o4 = ref_orient2D(c, d, b);
+    if (o3 == 0 && o4 == 0) return false;
+    if (o3 == 0 && geometry::box_has_point(c, d, a)) return true;
+    if (o4 == 0 && geometry::box_has_point(c, d, b)) return true;
+    return o1 * o2 < 0 && o3 * o4 < 0;
+  }
+}
+
+class RobustPredicateTest : public ::testing::Test
+{
+public:
+  RobustPredicateTest()
+    : rng(42), coord(-(1 << COORD_BITS) + 1, (1 << COORD_BITS) - 1), offset(-2, 2)
+  {}
+
+  glm::vec2 random_point()
+  {
+    return glm::vec2(std::ldexp((float)coord(rng), -GRID_BITS), std::ldexp((float)coord(rng), -GRID_BITS));
+  }
+
+  // a grid point within a few grid steps of the line through a and b
+  glm::vec2 near_collinear(const glm::vec2& a, const glm::vec2& b)
+  {
+    const float t = std::uniform_real_distribution<float>(-0.5f, 1.5f)(rng);
+    const glm::vec2 p = a + t * (b - a);
+    return glm::vec2(std::ldexp(std::round(std::ldexp(p.x, GRID_BITS)) + offset(rng), -GRID_BITS),
+                     std::ldexp(std::round(std::ldexp(p.y, GRID_BITS)) + offset(rng), -GRID_BITS));
+  }
+
+  bool on_grid(const glm::vec2& p)
+  {
+    return std::fabs(to_int(p.x)) < (1 << COORD_BITS) && std::fabs(to_int(p.y)) < (1 << COORD_BITS);
+  }
+
+  std::mt19937 rng;
+  std::uniform_int_distribution<int> coord;
+  std::uniform_int_distribution<int> offset;
+};
+
+TEST_F(RobustPredicateTest, OrientNearlyCollinear)
+{
+  // one ulp above the diagonal, where the float determinant rounds to 0
+  const glm::vec2 a(0.5f, std::nextafter(0.5f, 1.0f));
+  const glm::vec2 b(12, 12);
+  const glm::vec2 c(24, 24);
+  ASSERT_EQ(0.0f, geometry::orient2D(a, b, c));
+  ASSERT_EQ(1, geometry::orient2D_sign(a, b, c));
+  ASSERT_EQ(1, geometry::orient2D_sign(b, c, a));
+  ASSERT_EQ(-1, geometry::orient2D_sign(b, a, c));
+  ASSERT_FALSE(geometry::segment_has_point(b, c, a));
+  ASSERT_TRUE(geometry::segment_has_point(b, c, glm::vec2(13, 13)));
+}
+
+TEST_F(RobustPredicateTest, OrientRandomMatchesReference)
+{
+  for (int i = 0; i < 100000; ++i) {
+    const glm::vec2 a = random_point();
+    const glm::vec2 b = random_point();
+    const glm::vec2 c = random_point();
+    ASSERT_EQ(ref_orient2D(a, b, c), geometry::orient2D_sign(a, b, c));
+  }
+}
+
+TEST_F(RobustPredicateTest, OrientNearCollinearMatchesReference)
+{
+  int zeros = 0;
+  for (int i = 0; i < 100000; ++i) {
+    const glm::vec2 a = random_point();
+    const glm::vec2 b = random_point();
+    const glm::vec2 c = near_collinear(a, b);
+    if (!on_grid(c)) continue;
+    const int ref = ref_orient2D(a, b, c);
+    zeros += (ref == 0);
+    ASSERT_EQ(ref, geometry::orient2D_sign(a, b, c));
+    ASSERT_EQ(ref, geometry::orient2D_sign(b, c, a));
+    ASSERT_EQ(ref, -geometry::orient2D_sign(b, a, c));
+  }
+  ASSERT_LT(0, zeros);
+}
+
+TEST_F(RobustPredicateTest, CrossMatchesOrient)
+{
+  for (int i = 0; i < 100000; ++i) {
+    const glm::vec2 o = random_point();
+    const glm::vec2 p = random_point();
+    const glm::vec2 q = near_collinear(o, p);
+    if (!on_grid(q)) continue;
+    // with integer grid steps, p - o is exact
+    ASSERT_EQ(ref_orient2D(o, p, q), geometry::cross2D_sign(p - o, o, q));
+  }
+}
+
+TEST_F(RobustPredicateTest, SegmentsNearCollinearMatchReference)
+{
+  glm::vec2 p;
+  for (int i = 0; i < 100000; ++i) {
+    const glm::vec2 a = random_point();
+    const glm::vec2 b = random_point();
+    const glm::vec2 c = near_collinear(a, b);
+    const glm::vec2 d = (i % 2 ? near_collinear(a, b) : random_point());
+    if (!on_grid(c) || !on_grid(d)) continue;
+    ASSERT_EQ(ref_intersect_seg_seg(a, b, c, d), geometry::intersect_seg_seg(a, b, c, d, p));
+    ASSERT_EQ(ref_intersect_seg_seg(c, d, a, b), geometry::intersect_seg_seg(c, d, a, b, p));
+  }
+}
+
+TEST_F(RobustPredicateTest, RayThroughSharedVertexHitsBothWalls)
+{
+  // two walls meeting at (1, 1) and a ray aimed exactly at the corner
+  const glm::vec2 corner(1, 1);
+  const glm::vec2 o(0.25f, 0.5f);
+  const glm::vec2 r(0.75f, 0.5f);
+  glm::vec2 p;
+  ASSERT_TRUE(geometry::intersect_ray_seg(o, r, glm::vec2(1, 0), corner, p));
+  ASSERT_TRUE(geometry::intersect_ray_seg(o, r, corner, glm::vec2(0, 1), p));
+}
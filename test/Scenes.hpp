@@ -0,0 +1,84 @@
+#pragma once
+#include "ParticleSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Particle scenes shared by the tests and the benchmarks, built through
+// add_particle() and add_constraint() so that they fit any system with the
+// interface of ParticleSystem, and a way to compare where they end up.
+namespace scenes
+{
+  // the two linked squares of assets/particles.txt, without the random jitter
+  template <typename System>
+  void make_squares(System& ps)
+  {
+    const float d = 0.14142f;
+    for (const auto& p : { glm::vec2(0.5f, 0.5f), glm::vec2(0.4f, 0.5f), glm::vec2(0.4f, 0.4f), glm::vec2(0.5f, 0.4f),
+                           glm::vec2(0.3f, 0.5f), glm::vec2(0.2f, 0.5f), glm::vec2(0.2f, 0.4f), glm::vec2(0.3f, 0.4f) }) {
+      ps.add_particle(p);
+    }
+    for (int k = 0; k < 8; k += 4) {
+      ps.add_constraint(Constraint(k + 0, k + 1, 0.1f));
+      ps.add_constraint(Constraint(k + 1, k + 2, 0.1f));
+      ps.add_constraint(Constraint(k + 2, k + 3, 0.1f));
+      ps.add_constraint(Constraint(k + 3, k + 0, 0.1f));
+      ps.add_constraint(Constraint(k + 0, k + 2, d));
+      ps.add_constraint(Constraint(k + 1, k + 3, d));
+    }
+    ps.add_constraint(Constraint(0, 4, 0.2f));
+  }
+
+  // three particles from a pinned one, the last link soft
+  template <typename System>
+  void make_pendulum(System& ps)
+  {
+    ps.add_particle({ 0, 0 }, 0.0f);
+    ps.add_particle({ 0.3f, 0 });
+    ps.add_particle({ 0.6f, 0 });
+    ps.add_constraint(Constraint(0, 1, 0.3f));
+    ps.add_constraint(Constraint(1, 2, 0.3f, 1e-4f));
+  }
+
+  // n x n grid of 0.1 spacing from the origin, numbered in a shuffled order
+  // as a mesh exported without any care for locality would be; a cloth
+  // hanging from its top row when pinned
+  template <typename System>
+  void make_shuffled_cloth(System& ps, int n, bool pinned = true)
+  {
+    std::vector<int> ids(n * n);
+    for (int i = 0; i < n * n; ++i) ids[i] = i;
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+    std::vector<glm::vec2> positions(n * n);
+    std::vector<float> inv_masses(n * n, 1.0f);
+    for (int i = 0; i < n * n; ++i) positions[ids[i]] = glm::vec2(0.1f * (i % n), 0.1f * (i / n));
+    if (pinned) {
+      for (int x = 0; x < n; ++x) inv_masses[ids[(n - 1) * n + x]] = 0.0f;
+    }
+    for (int i = 0; i < n * n; ++i) ps.add_particle(positions[i], inv_masses[i]);
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        if (x + 1 < n) ps.add_constraint(Constraint(ids[y * n + x], ids[y * n + x + 1], 0.1f));
+        if (y + 1 < n) ps.add_constraint(Constraint(ids[y * n + x], ids[(y + 1) * n + x], 0.1f));
+      }
+    }
+  }
+
+  // largest difference of a coordinate between two sets of positions,
+  // infinite when they are not the same size or one is NaN
+  inline float max_difference(const std::vector<glm::vec2>& a, const std::vector<glm::vec2>& b)
+  {
+    const float infinity = std::numeric_limits<float>::infinity();
+    if (a.size() != b.size()) return infinity;
+    float difference = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      for (int axis = 0; axis < 2; ++axis) {
+        const float d = std::abs(a[i][axis] - b[i][axis]);
+        if (!(d <= difference)) difference = (d == d ? d : infinity);
+      }
+    }
+    return difference;
+  }
+}
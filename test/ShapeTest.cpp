@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "Shape.hpp"
+#include "EglContext.hpp"
+#include <cmath>
+#include <memory>
+
+class ShapeTest : public ::testing::Test
+{
+public:
+  static void SetUpTestCase() { s_gl.reset(new EglContext()); }
+  static void TearDownTestCase() { s_gl.reset(); }
+  static bool has_context() { return s_gl->has_context(); }
+
+  static std::vector<glm::vec2> unit_square()
+  {
+    return { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+  }
+
+  // center, then n + 1 rim vertices on the unit circle, the last one on the first
+  static std::vector<glm::vec2> closed_fan(int n)
+  {
+    std::vector<glm::vec2> vertices(1, glm::vec2(0, 0));
+    for (int i = 0; i <= n; ++i) {
+      const float angle = 6.2831853f * (i % n) / n;
+      vertices.push_back(glm::vec2(std::cos(angle), std::sin(angle)));
+    }
+    return vertices;
+  }
+
+  static std::unique_ptr<EglContext> s_gl;
+};
+
+std::unique_ptr<EglContext> ShapeTest::s_gl;
+
+TEST_F(ShapeTest, ShapesWithoutPiecesDoNotCollide)
+{
+  if (!has_context()) return;
+
+  Shape square(GL_LINE_LOOP, unit_square());
+  Shape lines(GL_LINES, std::vector<glm::vec2>{ { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } });
+  Shape points(GL_POINTS, unit_square());
+  Shape bowtie(GL_LINE_LOOP, std::vector<glm::vec2>{ { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } });
+  ASSERT_EQ(1u, square.nb_convex_pieces());
+  glm::vec2 mtv;
+  for (const Shape* other : { &lines, &points, &bowtie }) {
+    ASSERT_EQ(0u, other->nb_convex_pieces());
+    ASSERT_FALSE(square.collide_shape(*other, mtv));
+    ASSERT_FALSE(other->collide_shape(square, mtv));
+  }
+}
+
+TEST_F(ShapeTest, FansAndTrianglesHavePieces)
+{
+  if (!has_context()) return;
+
+  // a closed fan is its rim, a single convex piece
+  Shape circle(GL_TRIANGLE_FAN, closed_fan(8));
+  ASSERT_EQ(1u, circle.nb_convex_pieces());
+  // an open one goes through its center
+  std::vector<glm::vec2> quarter = closed_fan(8);
+  quarter.resize(4);
+  Shape pie(GL_TRIANGLE_FAN, quarter);
+  ASSERT_EQ(1u, pie.nb_convex_pieces());
+  // a fan that is not simple falls back to its triangles, degenerate ones left out
+  Shape folded(GL_TRIANGLE_FAN, std::vector<glm::vec2>{ { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, 1 } });
+  ASSERT_EQ(2u, folded.nb_convex_pieces());
+  // clockwise triangles too
+  Shape triangles(GL_TRIANGLES, std::vector<glm::vec2>{ { 0, 0 }, { 1, 0 }, { 0, 1 }, { 2, 0 }, { 2, 1 }, { 3, 0 } });
+  ASSERT_EQ(2u, triangles.nb_convex_pieces());
+
+  Shape probe(GL_LINE_LOOP, unit_square());
+  probe.set_position(0.9f, -0.5f);
+  glm::vec2 mtv;
+  ASSERT_TRUE(probe.collide_shape(circle, mtv));
+  ASSERT_NEAR(0.1f, mtv.x, 1e-5f);
+  ASSERT_NEAR(0.0f, mtv.y, 1e-5f);
+  probe.set_position(1.4f, 0.5f);
+  ASSERT_TRUE(probe.collide_shape(triangles, mtv));
+  ASSERT_FALSE(probe.collide_shape(circle, mtv));
+}
+
+TEST_F(ShapeTest, TrianglesMergeIntoConvexPieces)
+{
+  if (!has_context()) return;
+
+  // a ribbon, all of its vertices on its outline
+  std::vector<glm::vec2> ribbon;
+  for (int i = 0; i < 10; ++i) {
+    ribbon.push_back(glm::vec2(0.5f * i, 0));
+    ribbon.push_back(glm::vec2(0.5f * i, 1));
+  }
+  Shape strip(GL_TRIANGLE_STRIP, ribbon);
+  ASSERT_EQ(1u, strip.nb_convex_pieces());
+  // an L of three unit squares, two triangles each
+  std::vector<glm::vec2> vertices;
+  for (const auto& corner : { glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(0, 1) }) {
+    for (const auto& v : { glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1), glm::vec2(0, 0), glm::vec2(1, 1), glm::vec2(0, 1) }) {
+      vertices.push_back(corner + v);
+    }
+  }
+  Shape l_shape(GL_TRIANGLES, vertices);
+  ASSERT_EQ(2u, l_shape.nb_convex_pieces());
+
+  // the notch of the L stays empty
+  Shape probe(GL_LINE_LOOP, unit_square());
+  probe.set_scale(0.2f, 0.2f);
+  probe.set_position(1.4f, 1.4f);
+  glm::vec2 mtv;
+  ASSERT_FALSE(probe.collide_shape(l_shape, mtv));
+  probe.set_position(1.9f, 0.4f);
+  ASSERT_TRUE(probe.collide_shape(l_shape, mtv));
+  ASSERT_TRUE(probe.collide_shape(strip, mtv));
+}
+
+TEST_F(ShapeTest, DeepestPairGivesTheTranslation)
+{
+  if (!has_context()) return;
+
+  // a wall on each side of the unit square, 0.2 deep on the left and 0.05
+  // on the right, as two pieces of one shape
+  Shape walls(GL_TRIANGLES, std::vector<glm::vec2>{
+    { 0.2f, -5 }, { 0.2f, 5 }, { -20, -5 },
+    { 0.95f, -5 }, { 20, -5 }, { 0.95f, 5 }
+  });
+  Shape square(GL_LINE_LOOP, unit_square());
+  glm::vec2 mtv;
+  ASSERT_TRUE(square.collide_shape(walls, mtv));
+  ASSERT_NEAR(0.2f, mtv.x, 1e-5f);
+  ASSERT_NEAR(0.0f, mtv.y, 1e-5f);
+  ASSERT_TRUE(walls.collide_shape(square, mtv));
+  ASSERT_NEAR(-0.2f, mtv.x, 1e-5f);
+
+  // the same square, mirrored
+  square.set_scale(-1, 1);
+  square.set_position(1, 0);
+  ASSERT_TRUE(square.collide_shape(walls, mtv));
+  ASSERT_NEAR(0.2f, mtv.x, 1e-5f);
+  ASSERT_NEAR(0.0f, mtv.y, 1e-5f);
+}
+
+TEST_F(ShapeTest, SeparatedShapesDoNotCollide)
+{
+  if (!has_context()) return;
+
+  Shape square(GL_LINE_LOOP, unit_square());
+  // bounds apart
+  Shape far(GL_LINE_LOOP, unit_square());
+  far.set_position(3, 0);
+  // bounds overlapping, but the hypotenuse separates
+  Shape corner(GL_TRIANGLES, std::vector<glm::vec2>{ { 1.9f, 0.5f }, { 1.9f, 1.5f }, { 0.9f, 1.5f } });
+
+  geometry::SatCache cache;
+  glm::vec2 mtv;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_FALSE(square.collide_shape(far, mtv, &cache));
+    ASSERT_FALSE(square.collide_shape(corner, mtv, &cache));
+  }
+  // only the pair whose bounds overlap was tested
+  ASSERT_EQ(1u, cache.size());
+
+  corner.translate(-0.5f, -0.5f);
+  ASSERT_TRUE(square.collide_shape(corner, mtv, &cache));
+}
+
+TEST_F(ShapeTest, UpdateRedecomposes)
+{
+  if (!has_context()) return;
+
+  Shape shape(GL_LINE_LOOP, unit_square());
+  ASSERT_EQ(1u, shape.nb_convex_pieces());
+  shape.update(std::vector<glm::vec2>{ { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } });
+  ASSERT_EQ(0u, shape.nb_convex_pieces());
+  shape.update(std::vector<glm::vec2>{ { 0, 0 }, { 2, 0 }, { 2, 2 }, { 1, 1 }, { 0, 2 } });
+  ASSERT_EQ(2u, shape.nb_convex_pieces());
+
+  Shape square(GL_LINE_LOOP, unit_square());
+  square.set_scale(0.2f, 0.2f);
+  square.set_position(0.9f, 1.3f);
+  glm::vec2 mtv;
+  // in the notch
+  ASSERT_FALSE(square.collide_shape(shape, mtv));
+  square.set_position(0.5f, 0.5f);
+  ASSERT_TRUE(square.collide_shape(shape, mtv));
+}
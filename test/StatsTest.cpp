@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "Stats.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+  std::string test_page_name(const char* test)
+  {
+    return stats::page_name() + "." + test;
+  }
+}
+
+TEST(StatsTest, BucketsAreBoundedByTheLimits)
+{
+  ASSERT_EQ(0, stats::bucket(0.0f));
+  ASSERT_EQ(0, stats::bucket(0.99f));
+  ASSERT_EQ(1, stats::bucket(1.0f));
+  ASSERT_EQ(4, stats::bucket(16.0f));
+  ASSERT_EQ(5, stats::bucket(16.7f));
+  ASSERT_EQ(stats::NB_BUCKETS - 1, stats::bucket(1000.0f));
+}
+
+TEST(StatsTest, WriterStartsWithAnEmptyPage)
+{
+  stats::Writer writer(test_page_name("empty"));
+  stats::Snapshot snapshot;
+  ASSERT_TRUE(stats::read(writer.page(), snapshot));
+  ASSERT_EQ(stats::MAGIC, snapshot.magic);
+  ASSERT_EQ(0u, snapshot.frame);
+  ASSERT_EQ(0u, snapshot.frame_histogram[0]);
+
+  writer.begin().frame = 12;
+  writer.end();
+  ASSERT_TRUE(stats::read(writer.page(), snapshot));
+  ASSERT_EQ(12u, snapshot.frame);
+}
+
+TEST(StatsTest, ReadFailsWhileWriting)
+{
+  stats::Writer writer(test_page_name("writing"));
+  writer.begin();
+  stats::Snapshot snapshot;
+  ASSERT_FALSE(stats::read(writer.page(), snapshot, 10));
+  writer.end();
+  ASSERT_TRUE(stats::read(writer.page(), snapshot, 10));
+}
+
+TEST(StatsTest, ReaderMapsTheSharedPage)
+{
+  const std::string name = test_page_name("shared");
+  {
+    stats::Writer writer(name);
+    if (!writer.is_shared()) {
+      std::cout << "[  SKIPPED ] no POSIX shared memory" << std::endl;
+      return;
+    }
+    stats::Reader reader(name);
+
+    stats::Snapshot& data = writer.begin();
+    data.nb_particles = 42;
+    data.step_ms = 1.5f;
+    ++data.step_histogram[stats::bucket(1.5f)];
+    writer.end();
+
+    stats::Snapshot snapshot;
+    ASSERT_TRUE(reader.read(snapshot));
+    ASSERT_EQ(42u, snapshot.nb_particles);
+    ASSERT_EQ(1.5f, snapshot.step_ms);
+    ASSERT_EQ(1u, snapshot.step_histogram[1]);
+  }
+  // the writer removes its page
+  ASSERT_THROW(stats::Reader reader(name), std::runtime_error);
+}
+
+TEST(StatsTest, SnapshotsAreConsistent)
+{
+  stats::Writer writer(test_page_name("consistent"));
+  std::atomic<bool> done(false);
+  std::thread thread([&] () {
+    for (uint64_t i = 1; !done; ++i) {
+      stats::Snapshot& data = writer.begin();
+      data.nb_particles = i;
+      data.nb_constraints = i;
+      data.frame = i;
+      writer.end();
+    }
+  });
+
+  int reads = 0;
+  for (int i = 0; i < 10000; ++i) {
+    stats::Snapshot snapshot;
+    if (!stats::read(writer.page(), snapshot)) continue;
+    ASSERT_EQ(snapshot.frame, snapshot.nb_particles);
+    ASSERT_EQ(snapshot.frame, snapshot.nb_constraints);
+    ++reads;
+  }
+  done = true;
+  thread.join();
+  ASSERT_LT(0, reads);
+}
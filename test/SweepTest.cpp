@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "Sweep.hpp"
+#include <random>
+
+namespace {
+  std::vector<geometry::intersection2> brute_force(const std::vector<geometry::segment2>& segments)
+  {
+    std::vector<geometry::intersection2> out;
+    glm::vec2 p;
+    for (size_t i = 0; i < segments.size(); ++i) {
+      for (size_t j = i + 1; j < segments.size(); ++j) {
+        if (geometry::intersect_seg_seg(segments[i].first, segments[i].second,
+                                        segments[j].first, segments[j].second, p)) {
+          out.push_back({ (int)i, (int)j, p });
+        }
+      }
+    }
+    return out;
+  }
+
+  void ExpectSame(const std::vector<geometry::intersection2>& expected,
+                  const std::vector<geometry::intersection2>& actual)
+  {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(expected[i].first, actual[i].first);
+      ASSERT_EQ(expected[i].second, actual[i].second);
+      ASSERT_EQ(expected[i].point, actual[i].point);
+    }
+  }
+}
+
+class SweepTest : public ::testing::Test
+{
+public:
+  SweepTest()
+    : rng(7)
+  {}
+
+  void TestSweep()
+  {
+    const auto expected = brute_force(segments);
+    ExpectSame(expected, geometry::intersect_all(segments));
+    ThreadPool pool(4);
+    ExpectSame(expected, geometry::intersect_all(segments, pool, 4));
+  }
+
+  float random(float min, float max)
+  {
+    return std::uniform_real_distribution<float>(min, max)(rng);
+  }
+
+  int random(int min, int max)
+  {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+  }
+
+  std::mt19937 rng;
+  std::vector<geometry::segment2> segments;
+};
+
+TEST_F(SweepTest, Empty)
+{
+  TestSweep();
+}
+
+TEST_F(SweepTest, Cross)
+{
+  segments.push_back({ { 0, 0 }, { 10, 10 } });
+  segments.push_back({ { 0, 10 }, { 10, 0 } });
+  segments.push_back({ { 20, 0 }, { 20, 0 } });
+  TestSweep();
+}
+
+TEST_F(SweepTest, RandomSegments)
+{
+  for (int i = 0; i < 500; ++i) {
+    const glm::vec2 a(random(0.0f, 100.0f), random(0.0f, 100.0f));
+    segments.push_back({ a, a + glm::vec2(random(-20.0f, 20.0f), random(-20.0f, 20.0f)) });
+  }
+  TestSweep();
+}
+
+TEST_F(SweepTest, StarThroughOnePoint)
+{
+  // every segment goes through the origin, some start or end there
+  for (int i = 0; i < 20; ++i) {
+    const glm::vec2 d((float)random(-8, 8), (float)random(-8, 8));
+    segments.push_back({ -d, (i % 3 ? d : glm::vec2(0, 0)) });
+  }
+  TestSweep();
+}
+
+TEST_F(SweepTest, GridWalls)
+{
+  // closed rooms, T-junctions, vertical and collinear walls on a grid
+  for (int i = 0; i < 300; ++i) {
+    const glm::vec2 a((float)random(0, 30), (float)random(0, 30));
+    const glm::vec2 b((float)random(0, 30), (float)random(0, 30));
+    segments.push_back({ a, glm::vec2(a.x, b.y) });
+    segments.push_back({ glm::vec2(a.x, b.y), b });
+    if (i % 4 == 0) segments.push_back({ a, b });
+  }
+  TestSweep();
+}
+
+TEST_F(SweepTest, PolygonLoops)
+{
+  for (int k = 0; k < 40; ++k) {
+    const glm::vec2 center(random(0.0f, 50.0f), random(0.0f, 50.0f));
+    const int n = random(3, 12);
+    std::vector<glm::vec2> vertices;
+    for (int i = 0; i < n; ++i) {
+      const float angle = 6.2831853f * i / n;
+      const float radius = random(1.0f, 8.0f);
+      vertices.push_back(center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+    }
+    for (int i = 0; i < n; ++i) segments.push_back({ vertices[i], vertices[(i + 1) % n] });
+  }
+  TestSweep();
+}
+
+TEST_F(SweepTest, CrossingsCloserThanFloats)
+{
+  // the crossings of the first segment with the others are less than a float
+  // apart, they must still be swept in their exact order
+  segments.push_back({ { 0.500000775f, 9.48467459e-07f }, { 8.02128e-07f, 0.875001013f } });
+  segments.push_back({ { 0.250000536f, 0.750000715f }, { 0.875000834f, 0.125000849f } });
+  segments.push_back({ { 0.625000715f, 0.750000715f }, { 0.500000715f, 7.28060627e-07f } });
+  TestSweep();
+}
+
+TEST_F(SweepTest, NearlyDegenerateAgainstBruteForce)
+{
+  // endpoints close to a coarse grid, so that many crossings nearly coincide,
+  // or coincide exactly when moved by a few steps of a finer grid
+  for (int trial = 0; trial < 300; ++trial) {
+    auto near_grid = [&]() {
+      if (trial % 2) return std::floor(random(0.0f, 8.0f)) / 8 + random(0.0f, 1e-6f);
+      return std::floor(random(0.0f, 4.0f)) / 4 + 1e-7f * random(0, 4);
+    };
+    segments.clear();
+    for (int i = random(10, 60); i > 0; --i) {
+      const glm::vec2 a(near_grid(), near_grid());
+      segments.push_back({ a, glm::vec2(near_grid(), near_grid()) });
+    }
+    TestSweep();
+    if (HasFatalFailure()) return;
+  }
+}
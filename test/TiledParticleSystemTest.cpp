@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "TiledParticleSystem.hpp"
+#include "Scenes.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+class TiledParticleSystemTest : public ::testing::Test
+{
+public:
+  // n x n cloth of 0.1 spacing from (-1, -1), hanging from its top row
+  static void make_cloth(TiledParticleSystem& tps, int n)
+  {
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) tps.add_particle({ -1.0f + 0.1f * x, -1.0f + 0.1f * y }, y == n - 1 ? 0.0f : 1.0f);
+    }
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        if (x + 1 < n) tps.add_constraint(Constraint(y * n + x, y * n + x + 1, 0.1f));
+        if (y + 1 < n) tps.add_constraint(Constraint(y * n + x, (y + 1) * n + x, 0.1f));
+      }
+    }
+  }
+};
+
+TEST_F(TiledParticleSystemTest, SingleTileMatchesParticleSystem)
+{
+  for (int i = 0; i < 2; ++i) {
+    ParticleSystem ps({ -1, -1 }, { 1, 1 });
+    ps.set_sleep_threshold(-1.0f, 1);
+    if (i) scenes::make_pendulum(ps);
+    else scenes::make_squares(ps);
+    ps.set_gravity({ 0.5f, -4.81f });
+
+    TiledParticleSystem tps({ -1, -1 }, { 1, 1 }, { 2, 2 });
+    tps.add_particles(ps);
+    tps.set_gravity(ps.gravity());
+    ASSERT_EQ(1u, tps.nb_tiles());
+    ASSERT_EQ(ps.constraints().size(), tps.nb_constraints());
+
+    for (int step = 0; step < 20; ++step) {
+      ps.step();
+      tps.step();
+    }
+    ASSERT_GE(1e-4f, scenes::max_difference(ps.particles(), tps.particles()));
+  }
+}
+
+TEST_F(TiledParticleSystemTest, ParticlesMigrateToTheirTile)
+{
+  // free particles don't care about tiles
+  TiledParticleSystem tiled({ -1, -1 }, { 1, 1 }, { 0.25f, 0.25f });
+  TiledParticleSystem single({ -1, -1 }, { 1, 1 }, { 2, 2 });
+  for (int i = 0; i < 100; ++i) {
+    const glm::vec2 p(-0.95f + 0.019f * i, 0.9f - 0.005f * i);
+    tiled.add_particle(p);
+    single.add_particle(p);
+  }
+  tiled.set_gravity({ 3.0f, -4.81f });
+  single.set_gravity({ 3.0f, -4.81f });
+  ASSERT_EQ(64u, tiled.nb_tiles());
+
+  size_t nb_migrations = 0;
+  for (int step = 0; step < 200; ++step) {
+    tiled.step();
+    single.step();
+    nb_migrations += tiled.nb_migrations();
+  }
+  ASSERT_LT(100u, nb_migrations);
+  ASSERT_EQ(single.particles(), tiled.particles());
+  for (int i = 0; i < 100; ++i) {
+    const glm::vec2 p = tiled.particle(i);
+    const int x = std::min(7, (int)std::floor((p.x + 1.0f) / 0.25f));
+    const int y = std::min(7, (int)std::floor((p.y + 1.0f) / 0.25f));
+    ASSERT_EQ(y * 8 + x, tiled.tile_of(i)) << i;
+  }
+}
+
+TEST_F(TiledParticleSystemTest, ConstraintsHoldAcrossTiles)
+{
+  // a chain hanging down through a column of tiles
+  TiledParticleSystem tps({ -1, -1 }, { 1, 1 }, { 0.2f, 0.2f });
+  const int n = 12;
+  for (int i = 0; i < n; ++i) tps.add_particle({ 0.0f, 0.9f - 0.05f * i }, i == 0 ? 0.0f : 1.0f);
+  for (int i = 0; i + 1 < n; ++i) tps.add_constraint(Constraint(i, i + 1, 0.05f));
+  // the ends of a constraint across tiles only meet at the exchanges
+  tps.set_solver_iterations(40);
+
+  for (int step = 0; step < 200; ++step) tps.step();
+  ASSERT_LT(0u, tps.nb_ghosts());
+  ASSERT_EQ(glm::vec2(0.0f, 0.9f), tps.particle(0));
+  for (int i = 0; i + 1 < n; ++i) {
+    ASSERT_NEAR(0.05f, glm::length(tps.particle(i + 1) - tps.particle(i)), 5e-4f) << i;
+  }
+}
+
+TEST_F(TiledParticleSystemTest, TilesConvergeToOneTile)
+{
+  TiledParticleSystem tiled({ -1, -2 }, { 1, 1 }, { 0.3f, 0.3f });
+  TiledParticleSystem single({ -1, -2 }, { 1, 1 }, { 3, 3 });
+  make_cloth(tiled, 16);
+  make_cloth(single, 16);
+  ASSERT_EQ(70u, tiled.nb_tiles());
+  ASSERT_EQ(1u, single.nb_tiles());
+  tiled.set_solver_iterations(20);
+  single.set_solver_iterations(20);
+  for (int step = 0; step < 100; ++step) {
+    tiled.step();
+    single.step();
+  }
+  ASSERT_LT(0u, tiled.nb_ghosts());
+  ASSERT_EQ(0u, single.nb_ghosts());
+  ASSERT_GE(1e-3f, scenes::max_difference(single.particles(), tiled.particles()));
+}
+
+TEST_F(TiledParticleSystemTest, ParallelMatchesSerial)
+{
+  ThreadPool serial(1), parallel(4);
+  TiledParticleSystem serial_tps({ -1, -2 }, { 1, 1 }, { 0.2f, 0.2f }, serial);
+  TiledParticleSystem parallel_tps({ -1, -2 }, { 1, 1 }, { 0.2f, 0.2f }, parallel);
+  make_cloth(serial_tps, 20);
+  make_cloth(parallel_tps, 20);
+  for (int step = 0; step < 100; ++step) {
+    serial_tps.step();
+    parallel_tps.step();
+  }
+  ASSERT_EQ(serial_tps.particles(), parallel_tps.particles());
+}
+
+TEST_F(TiledParticleSystemTest, RejectsOtherConstraints)
+{
+  ParticleSystem ps({ -1, -1 }, { 1, 1 });
+  scenes::make_pendulum(ps);
+  ps.add_constraint(RopeConstraint(0, 2, 0.0f, 1.0f));
+  TiledParticleSystem tps({ -1, -1 }, { 1, 1 }, { 0.5f, 0.5f });
+  ASSERT_THROW(tps.add_particles(ps), std::runtime_error);
+  ASSERT_THROW(tps.add_constraint(Constraint(0, 5, 0.1f)), std::runtime_error);
+}
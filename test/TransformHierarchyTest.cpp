@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include "TransformHierarchy.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <stdexcept>
+
+namespace {
+  // the local matrix as shapes used to build it
+  glm::mat4 local_mat4(TransformHierarchy& h, int node)
+  {
+    glm::mat4 m;
+    const glm::vec2 t = h.origin(node) + h.position(node);
+    m = glm::translate(m, glm::vec3(t.x, t.y, 0.0f));
+    m = glm::rotate(m, h.rotation(node), glm::vec3(0.0f, 0.0f, 1.0f));
+    m = glm::scale(m, glm::vec3(h.scale(node).x, h.scale(node).y, 1.0f));
+    return m;
+  }
+
+  glm::mat4 world_mat4(TransformHierarchy& h, int node)
+  {
+    const int parent = h.parent(node);
+    return (parent < 0 ? glm::mat4() : world_mat4(h, parent)) * local_mat4(h, node);
+  }
+}
+
+TEST(TransformHierarchyTest, RootsMatchTheMat4Composition)
+{
+  TransformHierarchy h;
+  const int node = h.add();
+  h.set_origin(node, glm::vec2(0.5f, 0.0f));
+  h.set_position(node, glm::vec2(1.0f, 2.0f));
+  h.set_rotation(node, 0.3f);
+  h.set_scale(node, glm::vec2(2.0f, -1.0f));
+
+  const glm::mat4 expected = world_mat4(h, node);
+  const glm::mat4 actual = to_mat4(h.world(node));
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) ASSERT_NEAR(expected[i][j], actual[i][j], 1e-6f) << i << j;
+  }
+}
+
+TEST(TransformHierarchyTest, ChildrenMoveWithTheirParent)
+{
+  TransformHierarchy h;
+  const int arm = h.add();
+  const int hand = h.add(arm);
+  h.set_position(arm, glm::vec2(1.0f, 0.0f));
+  h.set_rotation(arm, 1.5707964f);
+  h.set_position(hand, glm::vec2(1.0f, 0.0f));
+
+  const glm::vec2 p = apply(h.world(hand), glm::vec2(0.0f, 0.0f));
+  ASSERT_NEAR(1.0f, p.x, 1e-6f);
+  ASSERT_NEAR(1.0f, p.y, 1e-6f);
+
+  h.set_position(arm, glm::vec2(2.0f, 0.0f));
+  ASSERT_NEAR(2.0f, apply(h.world(hand), glm::vec2(0.0f, 0.0f)).x, 1e-6f);
+}
+
+TEST(TransformHierarchyTest, DirtyFlagsFlowDown)
+{
+  TransformHierarchy h;
+  const int root = h.add();
+  const int child = h.add(root);
+  const int grandchild = h.add(child);
+  const int other = h.add();
+  h.update();
+  const uint32_t g0 = h.generation(grandchild), o0 = h.generation(other);
+
+  h.set_position(root, glm::vec2(1.0f, 0.0f));
+  h.update();
+  ASSERT_NE(g0, h.generation(grandchild));
+  ASSERT_EQ(o0, h.generation(other));
+
+  // setting the same value changes nothing
+  const uint32_t g1 = h.generation(grandchild);
+  h.set_position(root, glm::vec2(1.0f, 0.0f));
+  h.set_rotation(child, 0.0f);
+  ASSERT_EQ(g1, h.generation(grandchild));
+}
+
+TEST(TransformHierarchyTest, ReparentingKeepsParentsFirst)
+{
+  TransformHierarchy h;
+  const int child = h.add();
+  const int parent = h.add();
+  h.set_position(child, glm::vec2(0.0f, 1.0f));
+  h.set_position(parent, glm::vec2(3.0f, 0.0f));
+  h.set_parent(child, parent);
+  ASSERT_EQ(parent, h.parent(child));
+  ASSERT_NEAR(3.0f, h.world(child).tx, 1e-6f);
+  ASSERT_NEAR(1.0f, h.world(child).ty, 1e-6f);
+
+  ASSERT_THROW(h.set_parent(parent, child), std::runtime_error);
+  ASSERT_THROW(h.set_parent(parent, parent), std::runtime_error);
+  h.set_parent(child, -1);
+  ASSERT_NEAR(0.0f, h.world(child).tx, 1e-6f);
+}
+
+TEST(TransformHierarchyTest, RemovedNodesHandTheirChildrenUp)
+{
+  TransformHierarchy h;
+  const int root = h.add();
+  const int middle = h.add(root);
+  const int leaf = h.add(middle);
+  h.set_position(root, glm::vec2(1.0f, 0.0f));
+  h.set_position(middle, glm::vec2(10.0f, 0.0f));
+  h.set_position(leaf, glm::vec2(100.0f, 0.0f));
+  ASSERT_NEAR(111.0f, h.world(leaf).tx, 1e-4f);
+
+  h.remove(middle);
+  ASSERT_EQ(2u, h.nb_nodes());
+  ASSERT_EQ(root, h.parent(leaf));
+  ASSERT_NEAR(101.0f, h.world(leaf).tx, 1e-4f);
+  ASSERT_THROW(h.world(middle), std::runtime_error);
+
+  // ids are reused
+  ASSERT_EQ(middle, h.add(leaf));
+  ASSERT_NEAR(101.0f, h.world(middle).tx, 1e-4f);
+}
+
+TEST(TransformHierarchyTest, RandomTreesMatchTheMat4Composition)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  TransformHierarchy h;
+  std::vector<int> nodes;
+  for (int i = 0; i < 500; ++i) {
+    // parents picked among the existing nodes, then shuffled around
+    const int parent = (nodes.empty() || i % 7 == 0 ? -1 : nodes[rng() % nodes.size()]);
+    const int node = h.add(parent);
+    h.set_position(node, glm::vec2(value(rng), value(rng)));
+    h.set_rotation(node, value(rng));
+    h.set_scale(node, glm::vec2(1.0f + 0.1f * value(rng), 1.0f + 0.1f * value(rng)));
+    nodes.push_back(node);
+  }
+  for (int i = 0; i < 50; ++i) {
+    const int node = nodes[rng() % nodes.size()];
+    const int parent = (i % 10 ? nodes[rng() % nodes.size()] : -1);
+    try {
+      h.set_parent(node, parent);
+    } catch (const std::runtime_error&) {}
+  }
+  for (int frame = 0; frame < 6; ++frame) {
+    h.set_rotation(nodes[frame], 0.5f * frame);
+    // nodes removed from the middle of the trees, and added back
+    for (int k = 0; k < 20; ++k) {
+      const size_t i = rng() % nodes.size();
+      h.remove(nodes[i]);
+      nodes.erase(nodes.begin() + i);
+    }
+    for (int k = 0; k < 10; ++k) {
+      const int node = h.add(k % 3 ? nodes[rng() % nodes.size()] : -1);
+      h.set_position(node, glm::vec2(value(rng), value(rng)));
+      nodes.push_back(node);
+    }
+    h.update();
+    for (const int node : nodes) {
+      const glm::mat4 expected = world_mat4(h, node);
+      const affine2 actual = h.world(node);
+      ASSERT_NEAR(expected[3][0], actual.tx, 1e-3f) << node;
+      ASSERT_NEAR(expected[3][1], actual.ty, 1e-3f) << node;
+      ASSERT_NEAR(expected[0][0], actual.a, 1e-3f) << node;
+      ASSERT_NEAR(expected[1][0], actual.c, 1e-3f) << node;
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "Vertex.hpp"
+#include <cmath>
+#include <limits>
+
+using namespace vertex;
+
+TEST(VertexTest, LayoutsArePacked)
+{
+  typedef layout<float2> position;
+  typedef layout<float2, float3, float2> textured;
+  typedef layout<half2, ubyte4n> compact;
+  typedef layout<short2n, half2, ubyte4n> quantized;
+  ASSERT_EQ(8u, sizeof(position));
+  ASSERT_EQ(28u, sizeof(textured));
+  ASSERT_EQ(8u, sizeof(compact));
+  ASSERT_EQ(12u, sizeof(quantized));
+
+  ASSERT_EQ(0u, (element<0, textured>::offset));
+  ASSERT_EQ(8u, (element<1, textured>::offset));
+  ASSERT_EQ(20u, (element<2, textured>::offset));
+  ASSERT_EQ(4u, (element<1, compact>::offset));
+  ASSERT_EQ(8u, (element<2, quantized>::offset));
+  ASSERT_EQ(3u, quantized::count);
+}
+
+TEST(VertexTest, AttributesRoundTrip)
+{
+  layout<short2n, half2, ubyte4n> v;
+  set_position(v, { 0.25f, -1.0f });
+  get<1>(v).set(0, 1.5f);
+  get<1>(v).set(1, -0.1f);
+  for (int i = 0; i < 4; ++i) get<2>(v).set(i, i / 3.0f);
+
+  ASSERT_NEAR(0.25f, position(v).x, 1.0f / 32767);
+  ASSERT_EQ(-1.0f, position(v).y);
+  ASSERT_EQ(1.5f, get<1>(v).get(0));
+  ASSERT_NEAR(-0.1f, get<1>(v).get(1), 1e-4f);
+  ASSERT_EQ(0, get<2>(v).value[0]);
+  ASSERT_EQ(85, get<2>(v).value[1]);
+  ASSERT_EQ(255, get<2>(v).value[3]);
+
+  // out of range values saturate
+  set_position(v, { 2.0f, -3.0f });
+  ASSERT_EQ(glm::vec2(1.0f, -1.0f), position(v));
+}
+
+TEST(VertexTest, HalfFloats)
+{
+  ASSERT_EQ(0x0000, float_to_half(0.0f));
+  ASSERT_EQ(0x8000, float_to_half(-0.0f));
+  ASSERT_EQ(0x3c00, float_to_half(1.0f));
+  ASSERT_EQ(0xc000, float_to_half(-2.0f));
+  ASSERT_EQ(0x7bff, float_to_half(65504.0f));
+  ASSERT_EQ(0x7c00, float_to_half(1e6f));
+  ASSERT_EQ(0xfc00, float_to_half(-std::numeric_limits<float>::infinity()));
+  ASSERT_EQ(0x0001, float_to_half(std::ldexp(1.0f, -24)));
+  ASSERT_EQ(0x0000, float_to_half(std::ldexp(1.0f, -26)));
+  // ties go to even
+  ASSERT_EQ(0x3c00, float_to_half(1.0f + std::ldexp(1.0f, -11)));
+  ASSERT_EQ(0x3c02, float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)));
+  ASSERT_TRUE(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+
+  // every finite half survives a round trip through float
+  for (uint32_t h = 0; h < 0x10000; ++h) {
+    if ((h & 0x7c00) == 0x7c00) continue;
+    ASSERT_EQ(h, float_to_half(half_to_float((uint16_t)h)));
+  }
+  ASSERT_EQ(std::ldexp(1.0f, -24), half_to_float(0x0001));
+  ASSERT_EQ(65504.0f, half_to_float(0x7bff));
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "WorldBatch.hpp"
+#include "Scenes.hpp"
+
+class WorldBatchTest : public ::testing::Test
+{
+};
+
+TEST_F(WorldBatchTest, WorldsMatchTheirParticleSystem)
+{
+  // reference systems, one per set of parameters
+  std::vector<ParticleSystem> systems;
+  for (int i = 0; i < 6; ++i) {
+    systems.push_back(ParticleSystem({ -1, -1 }, { 1, 1 }));
+    ParticleSystem& ps = systems.back();
+    ps.set_sleep_threshold(-1.0f, 1);
+    if (i % 2) scenes::make_pendulum(ps);
+    else scenes::make_squares(ps);
+    ps.set_gravity({ 0.5f * i, -4.81f });
+    ps.set_timestep(0.005f + 0.001f * i);
+  }
+
+  WorldBatch batch;
+  for (const auto& ps : systems) batch.add_world(ps);
+  ASSERT_EQ(6u, batch.nb_worlds());
+  ASSERT_EQ(2u, batch.nb_groups());
+
+  for (int step = 0; step < 20; ++step) {
+    batch.step();
+    for (auto& ps : systems) ps.step();
+  }
+  for (int i = 0; i < 6; ++i) ASSERT_GE(1e-4f, scenes::max_difference(systems[i].particles(), batch.particles(i))) << i;
+}
+
+TEST_F(WorldBatchTest, ParametersApplyPerWorld)
+{
+  ParticleSystem ps({ -1, -1 }, { 1, 1 });
+  scenes::make_pendulum(ps);
+  WorldBatch batch;
+  const int still = batch.add_world(ps);
+  const int falling = batch.add_world(ps);
+  batch.set_gravity(still, { 0, 0 });
+  batch.set_rest_length(falling, 0, 0.4f);
+  for (int step = 0; step < 500; ++step) batch.step();
+
+  ASSERT_EQ(ps.particles()[2], batch.particles(still)[2]);
+  ASSERT_NEAR(0.4f, glm::length(batch.particles(falling)[1]), 0.01f);
+  ASSERT_GT(0.0f, batch.particles(falling)[2].y);
+}
+
+TEST_F(WorldBatchTest, AddingWorldsKeepsState)
+{
+  ParticleSystem ps({ -1, -1 }, { 1, 1 });
+  scenes::make_squares(ps);
+  WorldBatch batch;
+  batch.add_world(ps);
+  for (int step = 0; step < 50; ++step) batch.step();
+  const std::vector<glm::vec2> moved = batch.particles(0);
+  batch.add_world(ps);
+  ASSERT_EQ(moved, batch.particles(0));
+  ASSERT_EQ(ps.particles(), batch.particles(1));
+
+  // and the first world keeps its velocity
+  WorldBatch single;
+  single.add_world(ps);
+  for (int step = 0; step < 60; ++step) single.step();
+  for (int step = 0; step < 10; ++step) batch.step();
+  ASSERT_EQ(single.particles(0), batch.particles(0));
+}
+
+TEST_F(WorldBatchTest, ParallelMatchesSerial)
+{
+  ThreadPool serial(1), parallel(4);
+  WorldBatch serial_batch(serial), parallel_batch(parallel);
+  for (int i = 0; i < 2000; ++i) {
+    ParticleSystem ps({ -1, -1 }, { 1, 1 });
+    if (i % 3) scenes::make_squares(ps);
+    else scenes::make_pendulum(ps);
+    ps.set_gravity({ 0.001f * i, -4.81f });
+    serial_batch.add_world(ps);
+    parallel_batch.add_world(ps);
+  }
+  for (int step = 0; step < 100; ++step) {
+    serial_batch.step();
+    parallel_batch.step();
+  }
+  for (int i = 0; i < 2000; ++i) ASSERT_EQ(serial_batch.particles(i), parallel_batch.particles(i));
+}
+
+TEST_F(WorldBatchTest, RejectsOtherConstraints)
+{
+  ParticleSystem ps({ -1, -1 }, { 1, 1 });
+  scenes::make_pendulum(ps);
+  ps.add_constraint(RopeConstraint(0, 2, 0.0f, 1.0f));
+  WorldBatch batch;
+  ASSERT_THROW(batch.add_world(ps), std::runtime_error);
+}